@@ -0,0 +1,120 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "pipe.h"
+#include "util.h"
+
+// --- //
+
+/* Games for agents in other processes and other languages to play,
+ * driven by the binary protocol in pipe.h: over stdin and stdout, or
+ * over a socket with -u, one connection after another. Each connection
+ * gets games of its own.
+ */
+
+// --- //
+
+/* Open a listening socket at `where`, as isPort() reads it */
+int listenOn(const char* where) {
+        struct sockaddr_un un = { .sun_family = AF_UNIX };
+        struct sockaddr_in in = { .sin_family = AF_INET };
+        int one = 1;
+        int fd = -1;
+
+        if(isPort(where)) {
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                check(fd >= 0, "Couldn't create socket.");
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                in.sin_port = htons(atoi(where));
+                in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                check(bind(fd, (struct sockaddr*)&in, sizeof(in)) == 0,
+                      "Couldn't bind to port %s.", where);
+        } else {
+                check(strlen(where) < sizeof(un.sun_path), "Path too long.");
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                check(fd >= 0, "Couldn't create socket.");
+                strcpy(un.sun_path, where);
+                unlink(where);  // Left over from a crash, most likely.
+                check(bind(fd, (struct sockaddr*)&un, sizeof(un)) == 0,
+                      "Couldn't bind to %s.", where);
+        }
+
+        check(listen(fd, 1) == 0, "Couldn't listen.");
+
+        return fd;
+ error:
+        if(fd >= 0) { close(fd); }
+        return -1;
+}
+
+/* Serve one agent to the end. Yields 0 if it went wrong */
+int serve(int in, int out) {
+        pipe_t* p = pipeOpen(in, out);
+        double start = now();
+        int ok;
+
+        check(p, "Couldn't serve the agent.");
+        ok = pipeServe(p);
+        log_info("%lu messages and %lu game-steps in %.1fs, over %lu reads "
+                 "and %lu writes.", p->messages, p->steps, now() - start,
+                 p->reads, p->writes);
+        pipeClose(p);
+
+        return ok;
+ error:
+        return 0;
+}
+
+int main(int argc, char** argv) {
+        char* where = NULL;
+        int listenFd = -1;
+        int fd, opt, ok;
+
+        while((opt = getopt(argc, argv, "u:")) != -1) {
+                switch(opt) {
+                case 'u':
+                        where = optarg;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-u socket|port]\n",
+                                argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        // An agent that hangs up is an error to handle, not a signal.
+        signal(SIGPIPE, SIG_IGN);
+        check(logStart(), "Couldn't start logging.");
+
+        if(!where) {
+                ok = serve(STDIN_FILENO, STDOUT_FILENO);
+                logStop();
+                return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        listenFd = listenOn(where);
+        check(listenFd >= 0, "Couldn't listen at %s", where);
+        log_info("Waiting for agents at %s.", where);
+
+        while((fd = accept(listenFd, NULL, NULL)) >= 0) {
+                serve(fd, fd);
+                close(fd);
+        }
+
+        log_err("Couldn't accept agents.");
+        close(listenFd);
+        logStop();
+
+        return EXIT_FAILURE;
+ error:
+        logStop();
+        return EXIT_FAILURE;
+}
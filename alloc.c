@@ -0,0 +1,50 @@
+#include <stdlib.h>
+
+#include "metrics.h"
+
+// --- //
+
+/* Counts our own heap traffic. Linked with -Wl,--wrap for each of
+ * these (see the Makefile), so calls from our objects land here first
+ * and calls inside libraries don't.
+ */
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+void __real_free(void* p);
+
+// --- //
+
+void* __wrap_malloc(size_t size) {
+        metricAdd(Allocations, 1);
+        return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+        metricAdd(Allocations, 1);
+        return __real_calloc(count, size);
+}
+
+/* Only a fresh block counts. Resizing one is neither */
+void* __wrap_realloc(void* p, size_t size) {
+        if(!p) {
+                metricAdd(Allocations, 1);
+        }
+
+        return __real_realloc(p, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+        metricAdd(Allocations, 1);
+        return __real_aligned_alloc(alignment, size);
+}
+
+void __wrap_free(void* p) {
+        if(p) {
+                metricAdd(Frees, 1);
+        }
+
+        __real_free(p);
+}
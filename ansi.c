@@ -0,0 +1,334 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ansi.h"
+#include "input.h"
+#include "logger.h"
+
+// --- //
+
+/* Board cell x,y sits at this screen row and column. Each cell is two
+ * columns wide, so it comes out about square.
+ */
+#define CELL_ROW(y) (1 + BOARD_HEIGHT - (y))
+#define CELL_COL(s, x) ((s)->left + 2 + 2 * (x))
+#define STATUS_ROW  (BOARD_HEIGHT + 3)
+#define BLOCK       8  // Added to a Fruit for the Block's own cells
+
+/* How each Fruit looks on the Board, and in the Block */
+const char* boardLooks[6] = {
+        "\033[0;2m",             // None
+        "\033[0;45m",            // Grape
+        "\033[0;41m",            // Apple
+        "\033[0;30;43m",         // Banana
+        "\033[0;30;42m",         // Pear
+        "\033[0;30;48;5;208m",   // Orange
+};
+
+const char* blockLooks[6] = {
+        "\033[0m",
+        "\033[0;1;37;45m",
+        "\033[0;1;37;41m",
+        "\033[0;1;30;43m",
+        "\033[0;1;30;42m",
+        "\033[0;1;30;48;5;208m",
+};
+
+// --- //
+
+/* Send everything gathered so far, in one go if the tty allows */
+int screenFlush(screen_t* s) {
+        size_t done = 0;
+        ssize_t n;
+
+        while(done < s->used) {
+                n = write(s->out, s->buf + done, s->used - done);
+
+                if(n < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                check(n > 0, "Couldn't write to the terminal.");
+                done += n;
+        }
+
+        s->bytes += s->used;
+        s->used = 0;
+
+        return 1;
+ error:
+        s->used = 0;
+        return 0;
+}
+
+/* Gather some output, flushing first if it wouldn't fit */
+void screenPut(screen_t* s, const char* fmt, ...) {
+        va_list args;
+        int n;
+
+        if(SCREEN_BUFFER - s->used < 64) {
+                screenFlush(s);
+        }
+
+        va_start(args, fmt);
+        n = vsnprintf(s->buf + s->used, SCREEN_BUFFER - s->used, fmt, args);
+        va_end(args);
+
+        if(n > 0) {
+                s->used += (size_t)n < SCREEN_BUFFER - s->used ?
+                        (size_t)n : SCREEN_BUFFER - s->used - 1;
+        }
+}
+
+/* Put the cursor at `row`,`col`, unless it's already there */
+void screenMove(screen_t* s, int row, int col) {
+        if(s->row != row || s->col != col) {
+                screenPut(s, "\033[%d;%dH", row, col);
+                s->row = row;
+                s->col = col;
+        }
+}
+
+/* Switch to a look, unless it's already on */
+void screenLook(screen_t* s, int look, const char* sgr) {
+        if(s->colour != look) {
+                screenPut(s, "%s", sgr);
+                s->colour = look;
+        }
+}
+
+/* Draw one Board cell as `v`: a Fruit, plus BLOCK for the Block's */
+void screenCell(screen_t* s, int x, int y, uint8_t v) {
+        int fruit = (v & (BLOCK - 1)) % 6;
+
+        screenMove(s, CELL_ROW(y), CELL_COL(s, x));
+
+        if(v & BLOCK) {
+                screenLook(s, v, blockLooks[fruit]);
+                screenPut(s, "[]");
+        } else {
+                screenLook(s, v, boardLooks[fruit]);
+                screenPut(s, fruit == None ? " ." : "  ");
+        }
+
+        s->col += 2;
+}
+
+/* The walls and floor, which never change */
+void screenFrame(screen_t* s) {
+        int x,y;
+
+        // A screen beside another leaves the rest of the terminal be.
+        screenPut(s, s->left ? "\033[0m" : "\033[0m\033[H\033[2J");
+        s->colour = -1;
+
+        for(y = 0; y < BOARD_HEIGHT; y++) {
+                screenPut(s, "\033[%d;%dH|\033[%d;%dH|", CELL_ROW(y),
+                          s->left + 1, CELL_ROW(y), CELL_COL(s, BOARD_WIDTH));
+        }
+
+        screenPut(s, "\033[%d;%dH+", CELL_ROW(-1), s->left + 1);
+
+        for(x = 0; x < BOARD_WIDTH; x++) {
+                screenPut(s, "--");
+        }
+
+        screenPut(s, "+");
+        s->row = s->col = -1;
+}
+
+/* Take over the terminal on `in` and `out`: raw keys, no cursor, a
+ * clear screen. Either may be something other than a tty.
+ */
+screen_t* screenCreate(int in, int out) {
+        screen_t* s = calloc(1, sizeof(screen_t));
+        struct termios raw;
+
+        check_mem(s);
+        s->in = in;
+        s->out = out;
+        s->statusRow = STATUS_ROW;
+
+        if(isatty(in) && tcgetattr(in, &s->saved) == 0) {
+                // Every key as it's pressed, unechoed. Ctrl-C is a key too.
+                raw = s->saved;
+                raw.c_iflag &= ~(ICRNL | IXON | ISTRIP | BRKINT);
+                raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+                raw.c_cc[VMIN] = 1;
+                raw.c_cc[VTIME] = 0;
+                check(tcsetattr(in, TCSAFLUSH, &raw) == 0,
+                      "Couldn't put the terminal in raw mode.");
+                s->raw = true;
+        }
+
+        screenPut(s, "\033[?25l");
+        screenClear(s);
+
+        return s;
+ error:
+        free(s);
+        return NULL;
+}
+
+/* Another Board, drawn to the right of the one on `s`. It takes no
+ * keys, and is destroyed before `s`.
+ */
+screen_t* screenBeside(screen_t* s) {
+        screen_t* b = calloc(1, sizeof(screen_t));
+
+        check_mem(b);
+        b->in = -1;
+        b->out = s->out;
+        b->left = s->left + PANE_COLUMNS;
+        b->statusRow = s->statusRow + 1;
+        b->shared = s->shared = true;
+        screenClear(b);
+
+        return b;
+ error:
+        return NULL;
+}
+
+/* Forget what's shown, so the next Frame is drawn in full */
+void screenClear(screen_t* s) {
+        memset(s->shown, UNDRAWN, sizeof(s->shown));
+        s->status[0] = '\0';
+        screenFrame(s);
+}
+
+/* Bring the terminal up to date with `f`. Yields 0 if it couldn't be
+ * written to.
+ */
+int screenDraw(screen_t* s, frame_t* f) {
+        uint8_t want[BOARD_CELLS];
+        char status[sizeof(s->status)];
+        int i,x,y;
+
+        // Whoever drew last left the cursor and colours who knows where.
+        if(s->shared) {
+                s->row = s->col = -1;
+                s->colour = -1;
+        }
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                want[i] = f->board[i] % 6;
+        }
+
+        for(i = 0; i < 4; i++) {
+                x = f->cells[2*i];
+                y = f->cells[2*i + 1];
+
+                if(x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT) {
+                        want[x + y * BOARD_WIDTH] = f->fs[i] % 6 + BLOCK;
+                }
+        }
+
+        // Top to bottom, left to right, so neighbours need no moves.
+        for(y = BOARD_HEIGHT - 1; y >= 0; y--) {
+                for(x = 0; x < BOARD_WIDTH; x++) {
+                        i = x + y * BOARD_WIDTH;
+
+                        if(want[i] != s->shown[i]) {
+                                screenCell(s, x, y, want[i]);
+                                s->shown[i] = want[i];
+                        }
+                }
+        }
+
+        snprintf(status, sizeof(status), "tick %lu  chain %d%s%s", f->tick,
+                 f->chain, f->running ? "" : "  (paused)",
+                 f->over ? "  GAME OVER" : "");
+
+        if(strcmp(status, s->status)) {
+                screenMove(s, s->statusRow, s->left + 1);
+                screenPut(s, "\033[0m%s\033[K", status);
+                strcpy(s->status, status);
+                s->row = s->col = -1;
+                s->colour = -1;
+        }
+
+        return s->used ? screenFlush(s) : 1;
+}
+
+/* Read the keys waiting on `in`, as Actions or KEY_QUIT and
+ * KEY_REDRAW, into `keys` (room for MAX_KEYS). Blocks until there's at
+ * least a byte, so poll first. Yields how many, or -1 once `in` closes.
+ */
+int screenKeys(screen_t* s, int* keys) {
+        unsigned char buf[MAX_KEYS + sizeof(s->pending)];
+        size_t len = s->waiting;
+        size_t i = 0;
+        ssize_t got;
+        int n = 0;
+
+        memcpy(buf, s->pending, s->waiting);
+        s->waiting = 0;
+        got = read(s->in, buf + len, MAX_KEYS);
+
+        if(got == 0) {
+                return -1;
+        } else if(got > 0) {
+                len += got;
+        }
+
+        while(i < len && n < MAX_KEYS) {
+                if(buf[i] == '\033' && (i + 1 == len || i + 2 == len) &&
+                   len - i < sizeof(s->pending) && got > 0) {
+                        // The rest of an arrow key is still on its way.
+                        s->waiting = len - i;
+                        memcpy(s->pending, buf + i, s->waiting);
+                        break;
+                } else if(buf[i] == '\033' && i + 2 < len &&
+                          (buf[i+1] == '[' || buf[i+1] == 'O')) {
+                        switch(buf[i+2]) {
+                        case 'A': keys[n++] = Rotate; break;
+                        case 'B': keys[n++] = MoveDown; break;
+                        case 'C': keys[n++] = MoveRight; break;
+                        case 'D': keys[n++] = MoveLeft; break;
+                        default: break;
+                        }
+
+                        i += 3;
+                        continue;
+                }
+
+                switch(buf[i]) {
+                case 'h': case 'a': keys[n++] = MoveLeft; break;
+                case 'l': case 'd': keys[n++] = MoveRight; break;
+                case 'j': case 's': keys[n++] = MoveDown; break;
+                case 'k': case 'w': keys[n++] = Rotate; break;
+                case ' ': keys[n++] = Shuffle; break;
+                case 'p': keys[n++] = Pause; break;
+                case 'r': keys[n++] = Restart; break;
+                case 'q': case 3: keys[n++] = KEY_QUIT; break;  // 3 is ^C
+                case 12: keys[n++] = KEY_REDRAW; break;         // ^L
+                default: break;
+                }
+
+                i++;
+        }
+
+        return n;
+}
+
+/* Give the terminal back as it was, and deallocate */
+void screenDestroy(screen_t* s) {
+        if(s && s->left) {
+                screenFlush(s);
+                free(s);
+        } else if(s) {
+                screenPut(s, "\033[0m\033[?25h\033[%d;1H\r\n",
+                          s->statusRow + (s->shared ? 1 : 0));
+                screenFlush(s);
+
+                if(s->raw) {
+                        tcsetattr(s->in, TCSAFLUSH, &s->saved);
+                }
+
+                free(s);
+        }
+}
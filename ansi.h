@@ -0,0 +1,75 @@
+#ifndef __ansi_h__
+#define __ansi_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <termios.h>
+
+#include "game.h"
+
+// --- //
+
+#define SCREEN_BUFFER 16384 // Bytes gathered per write()
+#define MAX_KEYS      64    // Most keys one read yields
+#define UNDRAWN       0xff  // A cell we don't know the look of
+#define PANE_COLUMNS  40    // Between a Board and one beside it
+
+// Keys that aren't Actions.
+#define KEY_QUIT   -1
+#define KEY_REDRAW -2
+
+/* A terminal that Frames are drawn on with ANSI escapes. It remembers
+ * what every cell shows, so a Frame costs only the cells that changed,
+ * sent with cursor addressing in a single write().
+ */
+typedef struct screen_t {
+        int in;                     // -1 for a screen beside another
+        int out;
+        int left;                   // Columns before the Board
+        int statusRow;
+        bool shared;                // Another screen draws here too
+        bool raw;                   // Did we change the tty's mode?
+        struct termios saved;       // ...from this
+        uint8_t shown[BOARD_CELLS]; // Fruit, plus 8 for the Block's
+        char status[80];            // The status line as drawn
+        int colour;                 // Last look sent, -1 if unknown
+        int row;                    // Where the cursor is, 1-based
+        int col;
+        unsigned char pending[8];   // A key sequence cut short by a read
+        size_t waiting;
+        size_t used;
+        char buf[SCREEN_BUFFER];
+        unsigned long bytes;        // Sent so far
+} screen_t;
+
+// --- //
+
+/* Take over the terminal on `in` and `out`: raw keys, no cursor, a
+ * clear screen. Either may be something other than a tty.
+ */
+screen_t* screenCreate(int in, int out);
+
+/* Another Board, drawn to the right of the one on `s`. It takes no
+ * keys, and is destroyed before `s`.
+ */
+screen_t* screenBeside(screen_t* s);
+
+/* Forget what's shown, so the next Frame is drawn in full */
+void screenClear(screen_t* s);
+
+/* Bring the terminal up to date with `f`. Yields 0 if it couldn't be
+ * written to.
+ */
+int screenDraw(screen_t* s, frame_t* f);
+
+/* Read the keys waiting on `in`, as Actions or KEY_QUIT and
+ * KEY_REDRAW, into `keys` (room for MAX_KEYS). Blocks until there's at
+ * least a byte, so poll first. Yields how many, or -1 once `in` closes.
+ */
+int screenKeys(screen_t* s, int* keys);
+
+/* Give the terminal back as it was, and deallocate */
+void screenDestroy(screen_t* s);
+
+#endif
@@ -0,0 +1,133 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "batch.h"
+#include "logger.h"
+
+// --- //
+
+_Static_assert(sizeof(Fruit) == sizeof(int32_t), "Fruits are 32-bit.");
+_Static_assert(FETRIS_WIDTH == BOARD_WIDTH &&
+               FETRIS_HEIGHT == BOARD_HEIGHT, "Boards match.");
+_Static_assert(FETRIS_PREVIEW == PREVIEW, "Previews match.");
+_Static_assert((int)FETRIS_LEFT == (int)MoveLeft &&
+               (int)FETRIS_RESTART == (int)Restart &&
+               FETRIS_NOTHING == NO_ACTION, "Actions match.");
+
+struct fetris_t {
+        batch_t* batch;
+        pthread_mutex_t lock;
+};
+
+// --- //
+
+/* The FETRIS_API_VERSION the library was built with */
+int fetrisVersion(void) {
+        return FETRIS_API_VERSION;
+}
+
+/* Create `n` games. Game i is seeded with `seed + i`. Yields NULL on
+ * failure.
+ */
+fetris_t* fetrisCreate(size_t n, uint64_t seed) {
+        fetris_t* env = calloc(1, sizeof(fetris_t));
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+        check_mem(env);
+
+        env->batch = batchCreate(n, seed, cores > 0 ? cores : 1);
+        check(env->batch, "Couldn't create %lu games.", (unsigned long)n);
+        pthread_mutex_init(&env->lock, NULL);
+
+        return env;
+ error:
+        free(env);
+        return NULL;
+}
+
+/* Start games over. With `which`, only games where it's nonzero */
+void fetrisReset(fetris_t* env, const uint8_t* which) {
+        size_t i;
+
+        pthread_mutex_lock(&env->lock);
+
+        for(i = 0; i < env->batch->count; i++) {
+                if(!which || which[i]) {
+                        batchReset(env->batch, i);
+                }
+        }
+
+        pthread_mutex_unlock(&env->lock);
+}
+
+/* Advance every game one step. Games that end start over */
+void fetrisStep(fetris_t* env, const uint8_t* actions,
+                float* rewards, uint8_t* dones) {
+        pthread_mutex_lock(&env->lock);
+        batchPlay(env->batch, actions, rewards, dones);
+        pthread_mutex_unlock(&env->lock);
+}
+
+/* Where each game's state lives */
+void fetrisObserve(fetris_t* env, fetris_obs_t* obs) {
+        batch_t* b = env->batch;
+
+        // The arrays never move, but a step may be writing them.
+        pthread_mutex_lock(&env->lock);
+
+        obs->count = b->count;
+        obs->rows = b->rows;
+        obs->fruits = (const int32_t*)b->fruits;
+        obs->piece = b->piece;
+        obs->rotation = b->rotation;
+        obs->x = b->x;
+        obs->y = b->y;
+        obs->pieceFruits = (const int32_t*)b->pieceFruits;
+        obs->tick = b->tick;
+        obs->lines = b->lines;
+        obs->matches = b->matches;
+        obs->pieces = b->pieces;
+        obs->chain = b->chain;
+
+        pthread_mutex_unlock(&env->lock);
+}
+
+/* The grid cells of game `i`'s piece, as x,y pairs */
+void fetrisPieceCells(fetris_t* env, size_t i, int cells[8]) {
+        pthread_mutex_lock(&env->lock);
+        batchCells(env->batch, i, cells);
+        pthread_mutex_unlock(&env->lock);
+}
+
+/* The next FETRIS_PREVIEW pieces game `i` will get, soonest first, and
+ * their Fruits, 4 to a piece
+ */
+void fetrisPreview(fetris_t* env, size_t i, uint8_t pieces[FETRIS_PREVIEW],
+                   int32_t fruits[FETRIS_PREVIEW * 4]) {
+        block_t next;
+        int n,k;
+
+        pthread_mutex_lock(&env->lock);
+
+        for(n = 0; n < FETRIS_PREVIEW; n++) {
+                next = queuePeek(&env->batch->queue[i], n);
+                pieces[n] = next.piece;
+
+                for(k = 0; k < 4; k++) {
+                        fruits[4*n + k] = next.fs[k];
+                }
+        }
+
+        pthread_mutex_unlock(&env->lock);
+}
+
+/* Deallocate */
+void fetrisDestroy(fetris_t* env) {
+        if(env) {
+                batchDestroy(env->batch);
+                pthread_mutex_destroy(&env->lock);
+                free(env);
+        }
+}
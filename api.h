@@ -0,0 +1,103 @@
+#ifndef __fetris_api_h__
+#define __fetris_api_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// --- //
+
+/* libfetris: many games of Fetris, stepped together, for programs that
+ * play it. This header is all a caller needs; it stands alone.
+ *
+ * Calls on one environment are serialized by its own lock, so it may be
+ * shared between threads. Separate environments never contend.
+ */
+
+#define FETRIS_API_VERSION 3
+
+#define FETRIS_WIDTH  10
+#define FETRIS_HEIGHT 20
+#define FETRIS_PREVIEW 5  // Upcoming pieces each game shows
+
+#if defined(__GNUC__)
+#define FETRIS_API __attribute__((visibility("default")))
+#else
+#define FETRIS_API
+#endif
+
+/* One per game, per step */
+enum {
+        FETRIS_LEFT, FETRIS_RIGHT, FETRIS_DOWN, FETRIS_ROTATE,
+        FETRIS_SHUFFLE, FETRIS_PAUSE, FETRIS_RESTART,
+        FETRIS_NOTHING = 0xff
+};
+
+typedef struct fetris_t fetris_t;
+
+/* Pointers straight into the environment's own arrays, one entry per
+ * game unless noted. Read-only, and only valid until the next call
+ * that changes the games.
+ */
+typedef struct fetris_obs_t {
+        size_t count;
+        const uint16_t* rows;        // count * FETRIS_HEIGHT. Bit x: occupied
+        const int32_t* fruits;       // count * FETRIS_WIDTH * FETRIS_HEIGHT.
+                                     // 0 is empty, then 1 to 5.
+        const uint8_t* piece;        // 0 to 6: L, S, Z, O, I, T, J
+        const uint8_t* rotation;
+        const int8_t* x;             // Grid position of the piece's centre
+        const int8_t* y;
+        const int32_t* pieceFruits;  // count * 4
+        const uint32_t* tick;
+        const uint32_t* lines;
+        const uint32_t* matches;
+        const uint32_t* pieces;
+        const uint8_t* chain;        // Clearing steps the last lock set off
+} fetris_obs_t;
+
+// --- //
+
+/* The FETRIS_API_VERSION the library was built with */
+FETRIS_API int fetrisVersion(void);
+
+/* Create `n` games. Game i is seeded with `seed + i`. Yields NULL on
+ * failure.
+ */
+FETRIS_API fetris_t* fetrisCreate(size_t n, uint64_t seed);
+
+/* Start games over. With `which`, only games where it's nonzero */
+FETRIS_API void fetrisReset(fetris_t* env, const uint8_t* which);
+
+/* Advance every game one step. `actions` holds one per game (or is NULL
+ * for FETRIS_NOTHING everywhere). For each game, `rewards` gets the
+ * lines and Fruit matches it cleared and `dones` whether it ended.
+ * Games that end start over, ready for the next step.
+ */
+FETRIS_API void fetrisStep(fetris_t* env, const uint8_t* actions,
+                           float* rewards, uint8_t* dones);
+
+/* Where each game's state lives */
+FETRIS_API void fetrisObserve(fetris_t* env, fetris_obs_t* obs);
+
+/* The grid cells of game `i`'s piece, as x,y pairs */
+FETRIS_API void fetrisPieceCells(fetris_t* env, size_t i, int cells[8]);
+
+/* The next FETRIS_PREVIEW pieces game `i` will get, soonest first, and
+ * their Fruits, 4 to a piece
+ */
+FETRIS_API void fetrisPreview(fetris_t* env, size_t i,
+                              uint8_t pieces[FETRIS_PREVIEW],
+                              int32_t fruits[FETRIS_PREVIEW * 4]);
+
+/* Deallocate */
+FETRIS_API void fetrisDestroy(fetris_t* env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "cascade.h"
+#include "logger.h"
+#include "metrics.h"
+
+// --- //
+
+/* A zeroed, cache-line aligned array */
+void* column(size_t count, size_t size) {
+        size_t bytes = (count * size + 63) & ~(size_t)63;
+        void* p = aligned_alloc(64, bytes);
+
+        if(p) {
+                memset(p, 0, bytes);
+        }
+
+        return p;
+}
+
+/* Is this grid spot taken? As occupied(), but from the row masks */
+bool solid(uint16_t* rows, int x, int y) {
+        if(x < 0 || x >= BOARD_WIDTH || y < 0) {
+                return true;
+        } else if(y >= BOARD_HEIGHT) {
+                return false;
+        }
+
+        return (rows[y] >> x) & 1;
+}
+
+/* Would game `i`'s piece in rotation `r` hit something if it moved by
+ * (dx,dy)?
+ */
+bool blocked(batch_t* b, size_t i, int r, int dx, int dy) {
+        uint16_t* rows = b->rows + i * BOARD_HEIGHT;
+        const int8_t* shape = pieceShapes[b->piece[i]][r];
+        int x = b->x[i] + dx;
+        int y = b->y[i] + dy;
+        int k;
+
+        for(k = 0; k < 8; k += 2) {
+                if(solid(rows, x + shape[k], y + shape[k+1])) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/* Rebuild game `i`'s row masks from its Fruits */
+void batchRows(batch_t* b, size_t i) {
+        uint16_t* rows = b->rows + i * BOARD_HEIGHT;
+        Fruit* fruits = b->fruits + i * BOARD_CELLS;
+        uint16_t mask;
+        int x,y;
+
+        for(y = 0; y < BOARD_HEIGHT; y++) {
+                mask = 0;
+
+                for(x = 0; x < BOARD_WIDTH; x++) {
+                        mask |= (fruits[x + y * BOARD_WIDTH] != None) << x;
+                }
+
+                rows[y] = mask;
+        }
+}
+
+/* Give game `i` its next piece, as gameTick() would */
+void batchSpawn(batch_t* b, size_t i) {
+        block_t next = queueNext(&b->queue[i], &b->rng[i]);
+        int k;
+
+        b->piece[i] = next.piece;
+        b->rotation[i] = next.curr;
+        b->x[i] = next.x;
+        b->y[i] = next.y;
+
+        for(k = 0; k < 4; k++) {
+                b->pieceFruits[4*i + k] = next.fs[k];
+        }
+}
+
+/* Start game `i` over, as gameReset() would */
+void batchReset(batch_t* b, size_t i) {
+        memset(b->rows + i * BOARD_HEIGHT, 0, BOARD_HEIGHT * sizeof(uint16_t));
+        memset(b->fruits + i * BOARD_CELLS, 0, BOARD_CELLS * sizeof(Fruit));
+        queueClear(&b->queue[i]);
+        batchSpawn(b, i);
+
+        b->tick[i] = 0;
+        b->lines[i] = 0;
+        b->matches[i] = 0;
+        b->pieces[i] = 0;
+        b->chain[i] = 0;
+        b->gravity[i] = 0;
+        b->running[i] = true;
+        b->over[i] = false;
+}
+
+/* The grid-space cells of game `i`'s piece, as blockCells() gives */
+void batchCells(batch_t* b, size_t i, int* cells) {
+        const int8_t* shape = pieceShapes[b->piece[i]][b->rotation[i]];
+        int k;
+
+        for(k = 0; k < 8; k += 2) {
+                cells[k]   = b->x[i] + shape[k];
+                cells[k+1] = b->y[i] + shape[k+1];
+        }
+}
+
+/* Apply one Action to game `i`, as gameAct() would */
+void batchAct(batch_t* b, size_t i, Action a) {
+        Fruit* fs = b->pieceFruits + 4*i;
+        const int8_t* kick;
+        Fruit d;
+        int p = b->piece[i];
+        int r,k;
+
+        switch(a) {
+        case Pause:
+                b->running[i] = !b->running[i];
+                return;
+        case Restart:
+                if(!b->over[i]) {
+                        metricAdd(OverRestart, 1);
+                }
+                batchReset(b, i);
+                return;
+        default:
+                break;
+        }
+
+        if(!b->running[i] || b->over[i]) {
+                return;
+        }
+
+        switch(a) {
+        case MoveLeft:
+                if(!blocked(b, i, b->rotation[i], -1, 0)) {
+                        b->x[i] -= 1;
+                }
+                break;
+        case MoveRight:
+                if(!blocked(b, i, b->rotation[i], 1, 0)) {
+                        b->x[i] += 1;
+                }
+                break;
+        case MoveDown:
+                if(!blocked(b, i, b->rotation[i], 0, -1)) {
+                        b->y[i] -= 1;
+                }
+                break;
+        case Rotate:
+                if(b->y[i] >= BOARD_HEIGHT - 1) {
+                        break;
+                }
+
+                r = (b->rotation[i] + 1) % pieceRotations[p];
+
+                for(k = 0; k < pieceKickCounts[p][b->rotation[i]]; k++) {
+                        kick = pieceKicks[p][b->rotation[i]][k];
+
+                        if(!blocked(b, i, r, kick[0], kick[1])) {
+                                b->rotation[i] = r;
+                                b->x[i] += kick[0];
+                                b->y[i] += kick[1];
+                                break;
+                        }
+                }
+                break;
+        case Shuffle:
+                d = fs[3];
+                fs[3] = fs[2];
+                fs[2] = fs[1];
+                fs[1] = fs[0];
+                fs[0] = d;
+                break;
+        default:
+                break;
+        }
+}
+
+/* Lock game `i`'s piece into its Board and clear what that allows */
+void batchLock(batch_t* b, size_t i) {
+        Fruit* fruits = b->fruits + i * BOARD_CELLS;
+        cascade_t c;
+        int cells[8];
+        int k,n = 0;
+
+        batchCells(b, i, cells);
+
+        // Any cells still above the Board are lost.
+        for(k = 0; k < 4; k++) {
+                if(cells[2*k + 1] < BOARD_HEIGHT) {
+                        fruits[cells[2*k] + BOARD_WIDTH * cells[2*k + 1]] =
+                                b->pieceFruits[4*i + k];
+                        cells[2*n] = cells[2*k];
+                        cells[2*n + 1] = cells[2*k + 1];
+                        n++;
+                }
+        }
+
+        c = cascadeResolve(fruits, cells, n);
+        b->lines[i] += c.lines;
+        b->matches[i] += c.matches;
+        b->chain[i] = c.chain;
+        b->pieces[i]++;
+        metricAdd(LinesCleared, c.lines);
+        metricAdd(FruitMatches, c.matches);
+        metricAdd(PiecesLocked, 1);
+        batchRows(b, i);
+        batchSpawn(b, i);
+}
+
+/* Advance game `i` one tick, as gameTick() would */
+void batchTick(batch_t* b, size_t i) {
+        if(!b->running[i] || b->over[i]) {
+                return;
+        }
+
+        b->tick[i]++;
+
+        if(!blocked(b, i, b->rotation[i], 0, -1)) {
+                if(++b->gravity[i] >= GRAVITY_TICKS) {
+                        b->gravity[i] = 0;
+                        b->y[i] -= 1;
+                }
+        } else if(b->y[i] == BOARD_HEIGHT - 1) {
+                b->over[i] = true;
+                metricAdd(OverTopOut, 1);
+        } else {
+                batchLock(b, i);
+        }
+}
+
+/* Step one contiguous range of games */
+void batchSweep(batch_t* b, batch_range_t* r) {
+        const uint8_t* actions = b->actions;
+        uint32_t before;
+        size_t i;
+
+        for(i = r->first; i < r->last; i++) {
+                before = b->lines[i] + b->matches[i];
+
+                if(actions && actions[i] != NO_ACTION) {
+                        batchAct(b, i, actions[i]);
+                }
+
+                batchTick(b, i);
+
+                // A Restart Action zeroes the counts. That's no penalty.
+                if(b->rewards) {
+                        b->rewards[i] = b->lines[i] + b->matches[i] >= before ?
+                                b->lines[i] + b->matches[i] - before : 0;
+                }
+
+                if(b->dones) {
+                        b->dones[i] = b->over[i];
+
+                        if(b->over[i]) {
+                                batchReset(b, i);
+                        }
+                }
+        }
+
+        // Once per sweep, to keep the per-game loop lean.
+        metricAdd(Ticks, r->last - r->first);
+}
+
+/* A worker thread. Sweeps its range once per step */
+void* batchWorker(void* arg) {
+        batch_range_t* r = arg;
+        batch_t* b = r->batch;
+
+        // Wait until every worker is hired and the barriers exist.
+        pthread_mutex_lock(&b->gate);
+        pthread_mutex_unlock(&b->gate);
+
+        while(true) {
+                pthread_barrier_wait(&b->start);
+
+                if(b->quit) {
+                        break;
+                }
+
+                batchSweep(b, r);
+                pthread_barrier_wait(&b->done);
+        }
+
+        metricsLeave();
+        logLeave();
+
+        return NULL;
+}
+
+/* Split the games into contiguous ranges, one per worker. Ranges are
+ * whole cache lines of the byte arrays, so workers never share one.
+ */
+void batchSplit(batch_t* b) {
+        size_t share = (b->count + b->workers - 1) / b->workers;
+        size_t first = 0;
+        int w;
+
+        share = (share + 63) & ~(size_t)63;
+
+        for(w = 0; w < b->workers; w++) {
+                b->ranges[w].first = first < b->count ? first : b->count;
+                first += share;
+                b->ranges[w].last = first < b->count ? first : b->count;
+        }
+}
+
+/* Create `count` games, the i'th seeded with `seed + i`, stepped by
+ * `workers` threads including the caller's.
+ */
+batch_t* batchCreate(size_t count, uint64_t seed, int workers) {
+        batch_t* b = calloc(1, sizeof(batch_t));
+        size_t i;
+        int w;
+
+        check_mem(b);
+        check(count > 0, "A batch needs games.");
+
+        b->count = count;
+        b->rows = column(count * BOARD_HEIGHT, sizeof(uint16_t));
+        b->fruits = column(count * BOARD_CELLS, sizeof(Fruit));
+        b->piece = column(count, sizeof(uint8_t));
+        b->rotation = column(count, sizeof(uint8_t));
+        b->x = column(count, sizeof(int8_t));
+        b->y = column(count, sizeof(int8_t));
+        b->pieceFruits = column(count * 4, sizeof(Fruit));
+        b->queue = column(count, sizeof(queue_t));
+        b->rng = column(count, sizeof(rng_t));
+        b->tick = column(count, sizeof(uint32_t));
+        b->lines = column(count, sizeof(uint32_t));
+        b->matches = column(count, sizeof(uint32_t));
+        b->pieces = column(count, sizeof(uint32_t));
+        b->chain = column(count, sizeof(uint8_t));
+        b->gravity = column(count, sizeof(uint8_t));
+        b->running = column(count, sizeof(uint8_t));
+        b->over = column(count, sizeof(uint8_t));
+        check_mem(b->rows && b->fruits && b->piece && b->rotation &&
+                  b->x && b->y && b->pieceFruits && b->queue && b->rng &&
+                  b->tick && b->lines && b->matches && b->pieces &&
+                  b->chain && b->gravity && b->running && b->over);
+
+        for(i = 0; i < count; i++) {
+                rngSeed(&b->rng[i], seed + i);
+                batchReset(b, i);
+        }
+
+        // No point in a worker with less than a cache line of games.
+        if(workers > MAX_WORKERS) { workers = MAX_WORKERS; }
+        if(workers > (int)((count + 63) / 64)) { workers = (count + 63) / 64; }
+        if(workers < 1) { workers = 1; }
+
+        // Whoever we manage to hire, the barriers are sized to match.
+        pthread_mutex_init(&b->gate, NULL);
+        pthread_mutex_lock(&b->gate);
+
+        for(w = 0; w < MAX_WORKERS; w++) {
+                b->ranges[w].batch = b;
+        }
+
+        for(w = 1; w < workers; w++) {
+                if(pthread_create(&b->threads[w], NULL, batchWorker,
+                                  &b->ranges[w]) != 0) {
+                        log_err("Only started %d workers.", w);
+                        break;
+                }
+        }
+
+        b->workers = w;
+        batchSplit(b);
+        pthread_barrier_init(&b->start, NULL, b->workers);
+        pthread_barrier_init(&b->done, NULL, b->workers);
+        pthread_mutex_unlock(&b->gate);
+
+        return b;
+ error:
+        batchDestroy(b);
+        return NULL;
+}
+
+/* Advance every game one step: its Action, if any, then a tick.
+ * `actions` holds one per game, or is NULL for none at all.
+ */
+void batchStep(batch_t* b, const uint8_t* actions) {
+        batchPlay(b, actions, NULL, NULL);
+}
+
+/* As batchStep(), but also report each game's reward, the lines and
+ * Fruit matches it cleared, and whether it ended. With `dones`, games
+ * that end start over straight away. Either may be NULL.
+ */
+void batchPlay(batch_t* b, const uint8_t* actions, float* rewards,
+               uint8_t* dones) {
+        b->actions = actions;
+        b->rewards = rewards;
+        b->dones = dones;
+
+        if(b->workers > 1) {
+                pthread_barrier_wait(&b->start);
+        }
+
+        batchSweep(b, &b->ranges[0]);
+
+        if(b->workers > 1) {
+                pthread_barrier_wait(&b->done);
+        }
+}
+
+/* Copy game `i` into a game_t, for rendering or saving */
+int batchExport(batch_t* b, size_t i, game_t* g) {
+        check(poseBlock(pieceNames[b->piece[i]], b->rotation[i], b->x[i],
+                        b->y[i], b->pieceFruits + 4*i, &g->block),
+              "Couldn't pose game %lu's piece.", (unsigned long)i);
+
+        memcpy(g->board, b->fruits + i * BOARD_CELLS, sizeof(g->board));
+        g->next = b->queue[i];
+        g->rng = b->rng[i];
+        g->tick = b->tick[i];
+        g->lines = b->lines[i];
+        g->matches = b->matches[i];
+        g->pieces = b->pieces[i];
+        g->chain = b->chain[i];
+        g->gravity = b->gravity[i];
+        g->running = b->running[i];
+        g->over = b->over[i];
+        g->boardSerial++;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Stop the workers and deallocate */
+void batchDestroy(batch_t* b) {
+        int w;
+
+        if(b) {
+                if(b->workers > 0) {
+                        b->quit = true;
+
+                        if(b->workers > 1) {
+                                pthread_barrier_wait(&b->start);
+                        }
+
+                        for(w = 1; w < b->workers; w++) {
+                                pthread_join(b->threads[w], NULL);
+                        }
+
+                        pthread_barrier_destroy(&b->start);
+                        pthread_barrier_destroy(&b->done);
+                        pthread_mutex_destroy(&b->gate);
+                }
+
+                free(b->rows);
+                free(b->fruits);
+                free(b->piece);
+                free(b->rotation);
+                free(b->x);
+                free(b->y);
+                free(b->pieceFruits);
+                free(b->queue);
+                free(b->rng);
+                free(b->tick);
+                free(b->lines);
+                free(b->matches);
+                free(b->pieces);
+                free(b->chain);
+                free(b->gravity);
+                free(b->running);
+                free(b->over);
+                free(b);
+        }
+}
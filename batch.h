@@ -0,0 +1,99 @@
+#ifndef __batch_h__
+#define __batch_h__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// --- //
+
+#define NO_ACTION   0xff  // For games that do nothing this step
+#define MAX_WORKERS 64
+
+/* One worker's share of a batch */
+typedef struct batch_range_t {
+        struct batch_t* batch;
+        size_t first;
+        size_t last;  // One past
+} batch_range_t;
+
+/* Many independent games, stepped in lockstep. Each field is an array
+ * over games, so a sweep touches only what it needs: gravity and
+ * collision read the row masks and the piece's pose, and the Fruits
+ * are only visited when a piece locks.
+ *
+ * Game `i` plays exactly as gameCreate(seed + i) would, given the same
+ * Actions, one per step.
+ */
+typedef struct batch_t {
+        size_t count;
+        // The Board
+        uint16_t* rows;    // count * BOARD_HEIGHT occupancy masks, bit x
+        Fruit* fruits;     // count * BOARD_CELLS
+        // The current piece
+        uint8_t* piece;    // Index into the piece tables
+        uint8_t* rotation;
+        int8_t* x;
+        int8_t* y;
+        Fruit* pieceFruits;  // count * 4, in A, B, C, D order
+        queue_t* queue;      // The pieces after it
+        // Everything else
+        rng_t* rng;
+        uint32_t* tick;
+        uint32_t* lines;
+        uint32_t* matches;
+        uint32_t* pieces;
+        uint8_t* chain;    // Clearing steps the last lock set off
+        uint8_t* gravity;
+        uint8_t* running;
+        uint8_t* over;
+        // Workers each own a contiguous range of games. The caller
+        // is worker 0.
+        int workers;
+        pthread_t threads[MAX_WORKERS];
+        batch_range_t ranges[MAX_WORKERS];
+        pthread_mutex_t gate;    // Held while workers are being hired
+        pthread_barrier_t start;
+        pthread_barrier_t done;
+        // For the step in progress
+        const uint8_t* actions;
+        float* rewards;
+        uint8_t* dones;
+        bool quit;
+} batch_t;
+
+// --- //
+
+/* Create `count` games, the i'th seeded with `seed + i`, stepped by
+ * `workers` threads including the caller's.
+ */
+batch_t* batchCreate(size_t count, uint64_t seed, int workers);
+
+/* Start game `i` over, as gameReset() would */
+void batchReset(batch_t* b, size_t i);
+
+/* Advance every game one step: its Action, if any, then a tick.
+ * `actions` holds one per game, or is NULL for none at all.
+ */
+void batchStep(batch_t* b, const uint8_t* actions);
+
+/* As batchStep(), but also report each game's reward, the lines and
+ * Fruit matches it cleared, and whether it ended. With `dones`, games
+ * that end start over straight away. Either may be NULL.
+ */
+void batchPlay(batch_t* b, const uint8_t* actions, float* rewards,
+               uint8_t* dones);
+
+/* The grid-space cells of game `i`'s piece, as blockCells() gives */
+void batchCells(batch_t* b, size_t i, int* cells);
+
+/* Copy game `i` into a game_t, for rendering or saving */
+int batchExport(batch_t* b, size_t i, game_t* g);
+
+/* Stop the workers and deallocate */
+void batchDestroy(batch_t* b);
+
+#endif
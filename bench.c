@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "logger.h"
+#include "util.h"
+
+// --- //
+
+/* Measures how fast a batch of games steps. Every game gets a random
+ * Action most steps, and finished games start over.
+ */
+
+#define ACTION_SETS 64  // Pre-drawn, so the bench measures only the games
+
+int main(int argc, char** argv) {
+        batch_t* b = NULL;
+        uint8_t* actions = NULL;
+        size_t count = 10000;
+        size_t i;
+        unsigned long steps = 0;
+        unsigned long lines = 0;
+        unsigned long restarts = 0;
+        double seconds = 5;
+        double start, t;
+        int workers = sysconf(_SC_NPROCESSORS_ONLN);
+        int opt, k;
+        rng_t r;
+
+        while((opt = getopt(argc, argv, "n:w:t:")) != -1) {
+                switch(opt) {
+                case 'n':
+                        count = strtoul(optarg, NULL, 10);
+                        break;
+                case 'w':
+                        workers = atoi(optarg);
+                        break;
+                case 't':
+                        seconds = atof(optarg);
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-n games] [-w workers] "
+                                "[-t seconds]\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        b = batchCreate(count, 1, workers);
+        check(b, "Couldn't create %lu games.", (unsigned long)count);
+
+        actions = malloc(ACTION_SETS * count);
+        check_mem(actions);
+        rngSeed(&r, 1);
+
+        // Mostly sideways moves and turns, and some idle steps.
+        for(i = 0; i < ACTION_SETS * count; i++) {
+                k = rngBelow(&r, 8);
+                actions[i] = k < 5 ? k : NO_ACTION;
+        }
+
+        log_info("Stepping %lu games on %d workers for %.0fs.",
+                 (unsigned long)count, b->workers, seconds);
+        start = now();
+
+        do {
+                for(k = 0; k < ACTION_SETS; k++) {
+                        batchStep(b, actions + k * count);
+                }
+
+                steps += ACTION_SETS;
+
+                for(i = 0; i < count; i++) {
+                        if(b->over[i]) {
+                                lines += b->lines[i];
+                                batchReset(b, i);
+                                restarts++;
+                        }
+                }
+
+                t = now() - start;
+        } while(t < seconds);
+
+        log_info("%.1fM game-steps/s (%.0f steps/s, %lu games over, "
+                 "%lu lines)", steps * count / t / 1e6, steps / t,
+                 restarts, lines);
+
+        free(actions);
+        batchDestroy(b);
+
+        return EXIT_SUCCESS;
+ error:
+        free(actions);
+        batchDestroy(b);
+        return EXIT_FAILURE;
+}
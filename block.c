@@ -1,26 +1,14 @@
-#include <stdlib.h>
-
 #include "block.h"
-#include "cog/dbg.h"
+#include "logger.h"
 
 // --- //
 
-/* All coordinates for all blocks in "Block Space".
- * Values come in pairs that represent the positions of cell
- * A, B, and D in that order. C is always at (0,0) in Block Space,
- * so we need not list it here.
- */
-int iBlock[2][6] = {{ -2,0, -1,0, 1,0  },
-                    { 0,-2, 0,-1, 0,1  }};
-int sBlock[2][6] = {{ -1,-1, 0,-1, 1,0 },
-                    { 1,-1, 1,0, 0,1   }};
-int zBlock[2][6] = {{ 1,-1, 0,-1, -1,0 },
-                    { -1,-1, -1,0, 0,1 }};
-int lBlock[4][6] = {{ -1,-1, -1,0, 1,0 },
-                    { 1,-1, 0,-1, 0,1  },
-                    { 1,1, 1,0, -1,0   },
-                    { -1,1, 0,1, 0,-1  }};
-int oBlock[1][6] = {{ -1,0, -1,-1, 0,-1 }};
+// The piece tables. Generated; see pieces.txt.
+#include "pieces.h"
+
+_Static_assert(PIECES <= 16, "Queue slots hold a 4-bit piece id.");
+_Static_assert(PREVIEW + PIECES <= QUEUE_SIZE,
+               "A bag must fit behind the preview.");
 
 // Fruit Colours
 GLfloat black[]  = { 0.0, 0.0, 0.0 };
@@ -32,123 +20,35 @@ GLfloat orange[] = { 1.0, 0.5, 0.0 };
 
 // --- //
 
-/* Create a I block in the default position */
-block_t* newI() {
-        block_t* b = malloc(sizeof(block_t));
-        check_mem(b);
-
-        Fruit* fs = randFruits();
-        check(fs, "Failed to generate Fruits.");
-        
-        b->coords = &iBlock[0][0];
-        b->variations = 2;
-        b->curr = 0;
-        b->x = 5;
-        b->y = 19;
-        b->fs = fs;
-        b->name = 'I';
-
-        return b;
- error:
-        return NULL;
-}
-
-/* Create a S block in the default position */
-block_t* newS() {
-        block_t* b = malloc(sizeof(block_t));
-        check_mem(b);
-
-        Fruit* fs = randFruits();
-        check(fs, "Failed to generate Fruits.");
-
-        b->coords = &sBlock[0][0];
-        b->variations = 2;
-        b->curr = 0;
-        b->x = 5;
-        b->y = 19;
-        b->fs = fs;
-        b->name = 'S';
-
-        return b;
- error:
-        return NULL;
-}
-
-/* Create a Z block in the default position */
-block_t* newZ() {
-        block_t* b = malloc(sizeof(block_t));
-        check_mem(b);
-
-        Fruit* fs = randFruits();
-        check(fs, "Failed to generate Fruits.");
-
-        b->coords = &zBlock[0][0];
-        b->variations = 2;
-        b->curr = 0;
-        b->x = 5;
-        b->y = 19;
-        b->fs = fs;
-        b->name = 'Z';
+/* A Block of the given piece in its spawn position */
+block_t spawnBlock(int piece, Fruit* fs) {
+        block_t b = { piece, 0, pieceSpawns[piece][0], pieceSpawns[piece][1],
+                      { fs[0], fs[1], fs[2], fs[3] } };
 
         return b;
- error:
-        return NULL;
 }
 
-/* Create a L block in the default position */
-block_t* newL() {
-        block_t* b = malloc(sizeof(block_t));
-        check_mem(b);
-
-        Fruit* fs = randFruits();
-        check(fs, "Failed to generate Fruits.");
-
-        b->coords = &lBlock[0][0];
-        b->variations = 4;
-        b->curr = 0;
-        b->x = 5;
-        b->y = 19;
-        b->fs = fs;
-        b->name = 'L';
-
-        return b;
- error:
-        return NULL;
-}
-
-/* Create a O block (a square) in the default position */
-block_t* newO() {
-        block_t* b = malloc(sizeof(block_t));
-        check_mem(b);
-
-        Fruit* fs = randFruits();
-        check(fs, "Failed to generate Fruits.");
+/* The id of the piece with this name, or -1 */
+int pieceNamed(char name) {
+        int p;
 
-        b->coords = &oBlock[0][0];
-        b->variations = 1;
-        b->curr = 0;
-        b->x = 5;
-        b->y = 19;
-        b->fs = fs;
-        b->name = 'O';
+        for(p = 0; p < PIECES; p++) {
+                if(pieceNames[p] == name) {
+                        return p;
+                }
+        }
 
-        return b;
- error:
-        return NULL;
+        return -1;
 }
 
 /* Generate four random Fruits */
-Fruit* randFruits() {
+void randFruits(rng_t* r, Fruit* fs) {
         int i;
-        Fruit* fs = malloc(sizeof(Fruit) * 4);
-        check_mem(fs);
 
-        // There are five Fruit types available, so we mod5.
+        // There are five Fruit types available.
         for(i = 0; i < 4; i++) {
-                fs[i] = (rand() % 5) + 1;
+                fs[i] = rngBelow(r, 5) + 1;
         }
- error:
-        return fs;
 }
 
 /* Get the colour of a Fruit. Cannot fail */
@@ -178,130 +78,107 @@ GLfloat* fruitColour(Fruit f) {
         return colour;
 }
 
-/* Generate a random Block */
-block_t* randBlock() {
-        block_t* b = NULL;
-        int choice = rand() % 5;
+/* Rebuild a Block from its pose */
+int poseBlock(char name, int curr, int x, int y, Fruit* fs, block_t* b) {
+        int p = pieceNamed(name);
 
-        switch(choice) {
-        case 0:
-                b = newL();
-                break;
-        case 1:
-                b = newS();
-                break;
-        case 2:
-                b = newZ();
-                break;
-        case 3:
-                b = newO();
-                break;
-        default:
-                b = newI();
-        }
+        check(p >= 0, "No such Block: %c", name);
+        check(curr >= 0 && curr < pieceRotations[p],
+              "No such rotation: %d", curr);
 
-        check(b, "Failed to randomly generate a Block.");
+        *b = spawnBlock(p, fs);
+        b->curr = curr;
+        b->x = x;
+        b->y = y;
 
-        return b;
+        return 1;
  error:
-        return NULL;
+        return 0;
 }
 
-/* Rotate a Block to its next configuration */
-block_t* rotateBlock(block_t* b) {
-        check(b, "Null Block given.");
+/* Rotate a Block to its next configuration, in place */
+void rotateBlock(block_t* b) {
+        b->curr = (b->curr + 1) % pieceRotations[b->piece];
+}
 
-        b->curr = (b->curr + 1) % b->variations;
+/* Fill `cells` with the 8 grid-space coordinates the Block occupies */
+void blockCells(block_t* b, int* cells) {
+        const int8_t* shape = pieceShapes[b->piece][b->curr];
+        int k;
 
-        switch(b->name) {
-        case 'I':
-                b->coords = &iBlock[b->curr][0];
-                break;
-        case 'S':
-                b->coords = &sBlock[b->curr][0];
-                break;
-        case 'Z':
-                b->coords = &zBlock[b->curr][0];
-                break;
-        case 'O':
-                // O block doesn't rotate.
-                break;
-        default:
-                b->coords = &lBlock[b->curr][0];
+        for(k = 0; k < 8; k += 2) {
+                cells[k]   = b->x + shape[k];
+                cells[k+1] = b->y + shape[k+1];
         }
-
-        return b;
- error:
-        return NULL;
-}
-
-/* Yield a list of grid-space coordinates occupied by the Block */
-int* blockCells(block_t* b) {
-        int* cells = NULL;
-
-        check(b, "Null Block given.");
-
-        cells = malloc(sizeof(int) * 8);
-        check_mem(cells);
-        
-        cells[0] = b->x + b->coords[0]; cells[1] = b->y + b->coords[1];
-        cells[2] = b->x + b->coords[2]; cells[3] = b->y + b->coords[3];
-        cells[4] = b->x;                cells[5] = b->y;
-        cells[6] = b->x + b->coords[4]; cells[7] = b->y + b->coords[5];
-        
-        return cells;
- error:
-        return NULL;
 }
 
 /* Shuffle the order of the fruits */
-block_t* shuffleFruit(block_t* b) {
-        check(b, "Null Block given.");
-
+void shuffleFruit(block_t* b) {
         Fruit d = b->fs[3];
+
         b->fs[3] = b->fs[2];
         b->fs[2] = b->fs[1];
         b->fs[1] = b->fs[0];
         b->fs[0] = d;
+}
 
-        return b;
- error:
-        return NULL;
+/* Empty a queue */
+void queueClear(queue_t* q) {
+        q->head = 0;
+        q->count = 0;
 }
 
-/* Copy a Block */
-block_t* copyBlock(block_t* b) {
-        block_t* newB = NULL;
-        int i;
+/* Add one whole bag to the back of a queue */
+void queueDeal(queue_t* q, rng_t* r) {
+        uint8_t bag[PIECES];
+        Fruit fs[4];
+        int i,j,k;
 
-        check(b, "Null Block given.");
+        for(i = 0; i < PIECES; i++) {
+                bag[i] = i;
+        }
 
-        newB = malloc(sizeof(block_t));
-        check_mem(newB);
+        // Fisher-Yates.
+        for(i = PIECES - 1; i > 0; i--) {
+                j = rngBelow(r, i + 1);
+                k = bag[i];
+                bag[i] = bag[j];
+                bag[j] = k;
+        }
 
-        newB->coords = b->coords;
-        newB->variations = b->variations;
-        newB->curr = b->curr;
-        newB->x = b->x;
-        newB->y = b->y;
-        newB->fs = malloc(sizeof(Fruit) * 4);
-        check_mem(newB->fs);
-        
-        for(i = 0; i < 4; i++) {
-                newB->fs[i] = b->fs[i];
+        for(i = 0; i < PIECES; i++) {
+                randFruits(r, fs);
+                q->slots[(q->head + q->count++) % QUEUE_SIZE] = bag[i] |
+                        fs[0] << 4 | fs[1] << 7 | fs[2] << 10 | fs[3] << 13;
         }
+}
 
-        newB->name = b->name;
+/* The `n`th upcoming Block, from 0, in its spawn position */
+block_t queuePeek(queue_t* q, int n) {
+        uint16_t s = q->slots[(q->head + n) % QUEUE_SIZE];
+        Fruit fs[4];
+        int k;
 
-        return newB;
- error:
-        return NULL;
+        for(k = 0; k < 4; k++) {
+                fs[k] = (s >> (4 + 3*k)) & 7;
+        }
+
+        return spawnBlock(s & 15, fs);
 }
 
-/* Deallocate a Block */
-void destroyBlock(block_t* b) {
-        if(b) {
-                free(b->fs);
-                free(b);
+/* Take the next Block off a queue, dealing another bag first if the
+ * preview would run short.
+ */
+block_t queueNext(queue_t* q, rng_t* r) {
+        block_t b;
+
+        if(q->count <= PREVIEW) {
+                queueDeal(q, r);
         }
+
+        b = queuePeek(q, 0);
+        q->head = (q->head + 1) % QUEUE_SIZE;
+        q->count--;
+
+        return b;
 }
@@ -2,62 +2,84 @@
 #define __block_h__
 
 #include <GL/glew.h>
+#include <stdint.h>
+
+#include "rng.h"
 
 typedef enum { None, Grape, Apple, Banana, Pear, Orange } Fruit;
 
+// Counts in pieces.txt. mkpieces checks them.
+#define PIECES        7
+#define MAX_ROTATIONS 4
+#define MAX_KICKS     5
+
+#define PREVIEW    5   // Upcoming pieces a player can see
+#define QUEUE_SIZE 16  // Room for the preview and a whole bag more
+
+/* The piece tables, baked from pieces.txt and indexed by piece id */
+extern const char pieceNames[PIECES + 1];
+extern const uint8_t pieceRotations[PIECES];
+extern const int8_t pieceSpawns[PIECES][2];
+extern const int8_t pieceShapes[PIECES][MAX_ROTATIONS][8];  // A, B, C, D
+extern const uint8_t pieceKickCounts[PIECES][MAX_ROTATIONS];
+extern const int8_t pieceKicks[PIECES][MAX_ROTATIONS][MAX_KICKS][2];
+
+/* Blocks are plain values. Copy them freely; there's nothing to free */
 typedef struct block_t {
-        // Block Shape/Rotation
-        int* coords;     // Set of all "Block Space" coordinates
-        int variations;  // How many "images" does this block have?
-        int curr;        // Which variation are we on?
+        int piece;  // Index into the piece tables
+        int curr;   // Which rotation are we on?
         // Block's grid coordinates (coord of C block)
         int x;
         int y;
         // Block Colours
-        Fruit* fs;
-        // Which Block is it?
-        char name;
+        Fruit fs[4];
 } block_t;
 
-// --- //
+/* Upcoming pieces, dealt a bag at a time: every piece once, shuffled,
+ * with their Fruits. Each slot packs a piece id in its low 4 bits, then
+ * 3 bits for each Fruit.
+ */
+typedef struct queue_t {
+        uint16_t slots[QUEUE_SIZE];
+        uint8_t head;
+        uint8_t count;
+} queue_t;
 
-/* Create a I block in the default position */
-block_t* newI();
-
-/* Create a S block in the default position */
-block_t* newS();
-
-/* Create a Z block in the default position */
-block_t* newZ();
+// --- //
 
-/* Create a L block in the default position */
-block_t* newL();
+/* A Block of the given piece in its spawn position */
+block_t spawnBlock(int piece, Fruit* fs);
 
-/* Create a O block (a square) in the default position */
-block_t* newO();
+/* The id of the piece with this name, or -1 */
+int pieceNamed(char name);
 
 /* Generate four random Fruits */
-Fruit* randFruits();
+void randFruits(rng_t* r, Fruit* fs);
 
 /* Get the colour of a Fruit. Cannot fail */
 GLfloat* fruitColour(Fruit f);
 
-/* Generate a random Block */
-block_t* randBlock();
+/* Rebuild a Block from its pose */
+int poseBlock(char name, int curr, int x, int y, Fruit* fs, block_t* b);
 
-/* Rotate a Block to its next configuration */
-block_t* rotateBlock(block_t* b);
+/* Rotate a Block to its next configuration, in place */
+void rotateBlock(block_t* b);
 
-/* Yield a list of grid-space coordinates occupied by the Block */
-int* blockCells(block_t* b);
+/* Fill `cells` with the 8 grid-space coordinates the Block occupies */
+void blockCells(block_t* b, int* cells);
 
 /* Shuffle the order of the fruits */
-block_t* shuffleFruit(block_t* b);
+void shuffleFruit(block_t* b);
+
+/* Empty a queue */
+void queueClear(queue_t* q);
 
-/* Copy a Block */
-block_t* copyBlock(block_t* b);
+/* Take the next Block off a queue, dealing another bag first if the
+ * preview would run short.
+ */
+block_t queueNext(queue_t* q, rng_t* r);
 
-/* Deallocate a Block */
-void destroyBlock(block_t* b);
+/* The `n`th upcoming Block, from 0, in its spawn position */
+block_t queuePeek(queue_t* q, int n);
 
 #endif
@@ -0,0 +1,367 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "logger.h"
+
+// --- //
+
+#define CAPTURE_WAIT   1000000000  // Nanoseconds a readback may still take
+#define CAPTURE_PERIOD 10          // Milliseconds the writer sleeps
+#define CAPTURE_BUFFER (1 << 20)   // Bytes stdio gathers per write()
+
+// --- //
+
+/* Let the writer know there's a frame */
+void captureWake(capture_t* c) {
+        uint64_t one = 1;
+        ssize_t n = write(c->wakeFd, &one, sizeof(one));
+
+        (void)n;
+}
+
+/* Copy out the readback in PBO `k`, once the GPU is done with it */
+void captureCollect(capture_t* c, int k) {
+        const void* pixels;
+        int slot;
+
+        // CAPTURE_PBOS frames later, as its PBO comes round again,
+        // this has almost surely landed.
+        glClientWaitSync(c->fences[k], GL_SYNC_FLUSH_COMMANDS_BIT,
+                         CAPTURE_WAIT);
+        glDeleteSync(c->fences[k]);
+        c->fences[k] = NULL;
+
+        if(!ringPop(c->free, &slot)) {
+                c->dropped++;
+                return;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, c->pbos[k]);
+        pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, c->frameBytes,
+                                  GL_MAP_READ_BIT);
+
+        if(pixels) {
+                memcpy(c->slots[slot], pixels, c->frameBytes);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                c->stamps[slot] = c->drawn[k];
+                ringPush(c->full, &slot);
+                captureWake(c);
+        } else {
+                ringPush(c->free, &slot);
+                c->dropped++;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/* Convert a frame to 4:4:4 Y'CbCr (BT.601, studio range), top row
+ * first, as Y4M wants it
+ */
+void captureToYUV(capture_t* c, const uint8_t* rgb) {
+        size_t plane = (size_t)c->width * c->height;
+        uint8_t* y = c->yuv;
+        uint8_t* u = y + plane;
+        uint8_t* v = u + plane;
+        const uint8_t* p;
+        int r,g,b,row,col;
+
+        for(row = c->height - 1; row >= 0; row--) {
+                p = rgb + (size_t)row * c->width * 3;
+
+                for(col = 0; col < c->width; col++, p += 3) {
+                        r = p[0];
+                        g = p[1];
+                        b = p[2];
+                        *y++ = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+                        *u++ = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+                        *v++ = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+                }
+        }
+}
+
+/* Write the held frame once more */
+int captureRepeat(capture_t* c) {
+        check(fputs("FRAME\n", c->video) >= 0 &&
+              fwrite(c->yuv, 3 * (size_t)c->width * c->height, 1,
+                     c->video) == 1,
+              "Couldn't write a frame.");
+        c->written++;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Write a frame as its own PPM image */
+int captureImage(capture_t* c, const uint8_t* rgb) {
+        char name[4096];
+        FILE* f = NULL;
+        int row;
+
+        snprintf(name, sizeof(name), c->pattern, (int)c->written);
+        f = fopen(name, "wb");
+        check(f, "Couldn't create %s", name);
+        fprintf(f, "P6\n%d %d\n255\n", c->width, c->height);
+
+        for(row = c->height - 1; row >= 0; row--) {
+                check(fwrite(rgb + (size_t)row * c->width * 3,
+                             3 * c->width, 1, f) == 1,
+                      "Couldn't write %s", name);
+        }
+
+        check(fclose(f) == 0, "Couldn't write %s", name);
+        c->written++;
+
+        return 1;
+ error:
+        if(f) { fclose(f); }
+        return 0;
+}
+
+/* Write out a slot. Video runs at a steady CAPTURE_RATE but the window
+ * only draws when something changes, so each frame is held and repeated
+ * until the next one's time comes.
+ */
+int captureWrite(capture_t* c, int slot) {
+        unsigned long due;
+
+        if(!c->video) {
+                return captureImage(c, c->slots[slot]);
+        }
+
+        if(!c->held) {
+                c->start = c->stamps[slot];
+        }
+
+        due = (unsigned long)((c->stamps[slot] - c->start) * CAPTURE_RATE);
+
+        while(c->held && c->written < due) {
+                check(captureRepeat(c), "Couldn't write the video.");
+        }
+
+        captureToYUV(c, c->slots[slot]);
+        c->held = true;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Write out frames as they come, until told to quit */
+void* captureLoop(void* arg) {
+        capture_t* c = arg;
+        struct pollfd p = { c->wakeFd, POLLIN, 0 };
+        uint64_t pokes;
+        bool quit, ok = true;
+        ssize_t n;
+        int slot;
+
+        do {
+                // Everything pushed before quit was set gets written.
+                quit = atomic_load(&c->quit);
+
+                while(ringPop(c->full, &slot)) {
+                        ok = ok && captureWrite(c, slot);
+                        ringPush(c->free, &slot);
+                }
+
+                if(!quit) {
+                        poll(&p, 1, CAPTURE_PERIOD);
+                        n = read(c->wakeFd, &pokes, sizeof(pokes));
+                        (void)n;
+                }
+        } while(!quit);
+
+        // The last frame stands for at least one.
+        if(ok && c->held) {
+                ok = captureRepeat(c);
+        }
+
+        if(!ok) {
+                log_err("Capture stopped early.");
+        }
+
+        logLeave();
+
+        return NULL;
+}
+
+/* Is `path` safe to hand snprintf() with a frame number? It must hold
+ * exactly one %d, with any flags, width and precision, and may hold %%.
+ */
+bool numberedPath(const char* path) {
+        int conversions = 0;
+        const char* at;
+
+        for(at = strchr(path, '%'); at; at = strchr(at + 1, '%')) {
+                if(at[1] == '%') {
+                        at++;
+                        continue;
+                }
+
+                at += strspn(at + 1, "-+ 0") + 1;
+                at += strspn(at, "0123456789");
+
+                if(*at == '.') {
+                        at += strspn(at + 1, "0123456789") + 1;
+                }
+
+                if(*at != 'd') {
+                        return false;
+                }
+
+                conversions++;
+        }
+
+        return conversions == 1;
+}
+
+/* Capture `width`x`height` frames to `path`: Y4M video, or numbered PPM
+ * images if `path` has a printf-style %d in it. Needs a current GL
+ * context. Yields NULL on failure.
+ */
+capture_t* captureStart(const char* path, int width, int height) {
+        capture_t* c = calloc(1, sizeof(capture_t));
+        bool threaded = false;
+        int i;
+
+        check_mem(c);
+        c->width = width;
+        c->height = height;
+        c->frameBytes = 3 * (size_t)width * height;
+        c->wakeFd = -1;
+        atomic_init(&c->quit, false);
+
+        if(strchr(path, '%')) {
+                check(numberedPath(path), "%s needs exactly one %%d, and "
+                      "no other %% but %%%%.", path);
+                c->pattern = path;
+        } else {
+                c->video = fopen(path, "wb");
+                check(c->video, "Couldn't create %s", path);
+                setvbuf(c->video, NULL, _IOFBF, CAPTURE_BUFFER);
+                check(fprintf(c->video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 "
+                              "C444\n", width, height, CAPTURE_RATE) > 0,
+                      "Couldn't write to %s", path);
+                c->yuv = malloc(c->frameBytes);
+                check_mem(c->yuv);
+        }
+
+        c->full = ringCreate(sizeof(int), CAPTURE_SLOTS);
+        c->free = ringCreate(sizeof(int), CAPTURE_SLOTS);
+        check(c->full && c->free, "Couldn't create capture rings.");
+
+        for(i = 0; i < CAPTURE_SLOTS; i++) {
+                c->slots[i] = malloc(c->frameBytes);
+                check_mem(c->slots[i]);
+                ringPush(c->free, &i);
+        }
+
+        // Rows of RGB, packed tight.
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGenBuffers(CAPTURE_PBOS, c->pbos);
+
+        for(i = 0; i < CAPTURE_PBOS; i++) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, c->pbos[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, c->frameBytes, NULL,
+                             GL_STREAM_READ);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        c->wakeFd = eventfd(0, EFD_NONBLOCK);
+        check(c->wakeFd >= 0, "Couldn't create eventfd.");
+        check(pthread_create(&c->thread, NULL, captureLoop, c) == 0,
+              "Couldn't start the capture writer.");
+        threaded = true;
+
+        log_info("Capturing %dx%d to %s.", width, height, path);
+
+        return c;
+ error:
+        if(c && !threaded) {
+                if(c->wakeFd >= 0) {
+                        close(c->wakeFd);
+                        c->wakeFd = -1;
+                }
+
+                captureStop(c);
+        }
+
+        return NULL;
+}
+
+/* Start reading back the frame just drawn, and pass on the one from
+ * CAPTURE_PBOS frames ago. Call after drawing and before swapping.
+ * Never waits on the GPU or the disk: if the writer is behind, the
+ * frame is dropped and counted.
+ */
+void captureFrame(capture_t* c, double drawn) {
+        int k = c->issued % CAPTURE_PBOS;
+
+        if(c->fences[k]) {
+                captureCollect(c, k);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, c->pbos[k]);
+        glReadPixels(0, 0, c->width, c->height, GL_RGB, GL_UNSIGNED_BYTE,
+                     (GLvoid*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        c->fences[k] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        c->drawn[k] = drawn;
+        c->issued++;
+}
+
+/* Pass on the frames still being read back, let the writer finish, and
+ * deallocate. Needs the same GL context.
+ */
+void captureStop(capture_t* c) {
+        unsigned long i;
+        int k;
+
+        if(!c) {
+                return;
+        }
+
+        // Oldest first, so the frames stay in order.
+        for(i = c->issued; i < c->issued + CAPTURE_PBOS; i++) {
+                k = i % CAPTURE_PBOS;
+
+                if(c->fences[k]) {
+                        captureCollect(c, k);
+                }
+        }
+
+        if(c->wakeFd >= 0) {
+                atomic_store(&c->quit, true);
+                captureWake(c);
+                pthread_join(c->thread, NULL);
+                close(c->wakeFd);
+        }
+
+        if(c->issued) {
+                log_info("Captured %lu frames: %lu written, %lu dropped.",
+                         c->issued, c->written, c->dropped);
+        }
+
+        glDeleteBuffers(CAPTURE_PBOS, c->pbos);
+
+        for(k = 0; k < CAPTURE_SLOTS; k++) {
+                free(c->slots[k]);
+        }
+
+        ringDestroy(c->full);
+        ringDestroy(c->free);
+
+        if(c->video) {
+                fclose(c->video);
+        }
+
+        free(c->yuv);
+        free(c);
+}
@@ -0,0 +1,70 @@
+#ifndef __capture_h__
+#define __capture_h__
+
+#include <GL/glew.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ring.h"
+
+// --- //
+
+#define CAPTURE_PBOS  3   // Readbacks in flight between the GPU and us
+#define CAPTURE_SLOTS 8   // Frames waiting for the writer
+#define CAPTURE_RATE  60  // Frames per second of Y4M video
+
+/* Frames being read back from the GPU and written to disk. Reads go
+ * through a ring of pixel buffer objects, and are only mapped
+ * CAPTURE_PBOS frames later, when they're long finished, so the render
+ * thread never waits on glReadPixels(). Converting and writing happen
+ * on a thread of their own.
+ */
+typedef struct capture_t {
+        int width;
+        int height;
+        size_t frameBytes;           // RGB, bottom row first, as GL has it
+        GLuint pbos[CAPTURE_PBOS];
+        GLsync fences[CAPTURE_PBOS]; // Signalled once a readback is done
+        double drawn[CAPTURE_PBOS];  // ...and when its frame was drawn
+        unsigned long issued;        // Readbacks started
+        unsigned long dropped;       // Frames the writer had no room for
+        uint8_t* slots[CAPTURE_SLOTS];
+        double stamps[CAPTURE_SLOTS];
+        ring_t* full;                // Slots for the writer
+        ring_t* free;                // ...and back again
+        // The writer's own.
+        pthread_t thread;
+        int wakeFd;
+        atomic_bool quit;
+        FILE* video;                 // NULL when writing images
+        const char* pattern;         // ...named like this, with a %d
+        unsigned long written;       // Frames or images so far
+        double start;                // When the first frame was drawn
+        uint8_t* yuv;                // The latest frame, ready to repeat
+        bool held;
+} capture_t;
+
+// --- //
+
+/* Capture `width`x`height` frames to `path`: Y4M video, or numbered PPM
+ * images if `path` has a printf-style %d in it. Any other conversion
+ * is refused. Needs a current GL context. Yields NULL on failure.
+ */
+capture_t* captureStart(const char* path, int width, int height);
+
+/* Start reading back the frame just drawn, and pass on the one from
+ * CAPTURE_PBOS frames ago. Call after drawing and before swapping.
+ * Never waits on the GPU or the disk: if the writer is behind, the
+ * frame is dropped and counted.
+ */
+void captureFrame(capture_t* c, double drawn);
+
+/* Pass on the frames still being read back, let the writer finish, and
+ * deallocate. Needs the same GL context.
+ */
+void captureStop(capture_t* c);
+
+#endif
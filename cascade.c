@@ -0,0 +1,244 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cascade.h"
+
+// --- //
+
+// What a step has found out about a cell.
+#define GONE  1  // Cleared this step
+#define H_RUN 2  // Already counted as part of a row's run
+#define V_RUN 4  // ...or a column's
+
+_Static_assert(BOARD_HEIGHT <= 32, "Checked rows fit in a mask.");
+
+/* Cells still to look at, each listed once */
+typedef struct worklist_t {
+        uint8_t cells[BOARD_CELLS];
+        int count;
+        bool listed[BOARD_CELLS];
+} worklist_t;
+
+/* One step of a cascade. Only the touched cells' flags are ever set,
+ * so only they need clearing afterwards.
+ */
+typedef struct step_t {
+        uint8_t flags[BOARD_CELLS];
+        uint8_t touched[BOARD_CELLS];
+        int count;
+        uint32_t rows;            // Rows already checked for being full
+        int low[BOARD_WIDTH];     // Lowest cleared cell in each column
+} step_t;
+
+// --- //
+
+/* Look at cell `i` next step, if it isn't already listed */
+void worklistAdd(worklist_t* w, int i) {
+        if(!w->listed[i]) {
+                w->listed[i] = true;
+                w->cells[w->count++] = i;
+        }
+}
+
+/* Empty a list, for reuse */
+void worklistClear(worklist_t* w) {
+        int k;
+
+        for(k = 0; k < w->count; k++) {
+                w->listed[w->cells[k]] = false;
+        }
+
+        w->count = 0;
+}
+
+/* Note something about cell `i` this step */
+void stepMark(step_t* s, int i, uint8_t flag) {
+        if(!s->flags[i]) {
+                s->touched[s->count++] = i;
+        }
+
+        s->flags[i] |= flag;
+}
+
+/* Clear row `y` if it's full. Yields whether it was */
+bool stepRow(step_t* s, Fruit* board, int y) {
+        int x;
+
+        if(s->rows & (1u << y)) {
+                return false;
+        }
+
+        s->rows |= 1u << y;
+
+        for(x = 0; x < BOARD_WIDTH; x++) {
+                if(board[x + y * BOARD_WIDTH] == None) {
+                        return false;
+                }
+        }
+
+        for(x = 0; x < BOARD_WIDTH; x++) {
+                stepMark(s, x + y * BOARD_WIDTH, GONE);
+        }
+
+        return true;
+}
+
+/* Clear the run of matching Fruits through `x`,`y` going `dx`,`dy`, if
+ * it's 3 or longer and not already counted. Yields whether it was.
+ */
+bool stepRun(step_t* s, Fruit* board, int x, int y, int dx, int dy,
+             uint8_t flag) {
+        Fruit f = board[x + y * BOARD_WIDTH];
+        int x0 = x, y0 = y, length = 1;
+        int i;
+
+        // Back up to where the run starts...
+        while(x0 - dx >= 0 && y0 - dy >= 0 &&
+              board[(x0 - dx) + (y0 - dy) * BOARD_WIDTH] == f) {
+                x0 -= dx;
+                y0 -= dy;
+        }
+
+        if(s->flags[x0 + y0 * BOARD_WIDTH] & flag) {
+                return false;
+        }
+
+        // ...then see how far it goes.
+        while(x0 + length * dx < BOARD_WIDTH &&
+              y0 + length * dy < BOARD_HEIGHT &&
+              board[(x0 + length * dx) + (y0 + length * dy) * BOARD_WIDTH]
+              == f) {
+                length++;
+        }
+
+        if(length < 3) {
+                return false;
+        }
+
+        for(i = 0; i < length; i++) {
+                stepMark(s, (x0 + i * dx) + (y0 + i * dy) * BOARD_WIDTH,
+                         GONE | flag);
+        }
+
+        return true;
+}
+
+/* Let column `x` fall into the gap starting at `from`. Every cell that
+ * moves is listed in `moved`.
+ */
+void dropColumn(Fruit* board, int x, int from, worklist_t* moved) {
+        int to = from;
+        int y;
+
+        for(y = from; y < BOARD_HEIGHT; y++) {
+                if(board[x + y * BOARD_WIDTH] != None) {
+                        if(y != to) {
+                                board[x + to * BOARD_WIDTH] =
+                                        board[x + y * BOARD_WIDTH];
+                                board[x + y * BOARD_WIDTH] = None;
+                                worklistAdd(moved, x + to * BOARD_WIDTH);
+                        }
+
+                        to++;
+                }
+        }
+}
+
+/* Clear every full row and Fruit run, let what's left fall straight
+ * down, and repeat until nothing more clears. Only the `n` cells given
+ * as x,y pairs are looked at first, and after that only cells that
+ * fell, so each step costs what moved rather than the whole Board.
+ */
+cascade_t cascadeResolve(Fruit* board, const int* cells, int n) {
+        cascade_t c = { 0, 0, 0 };
+        worklist_t lists[2];
+        worklist_t* now = &lists[0];
+        worklist_t* next = &lists[1];
+        worklist_t* swap;
+        step_t s;
+        int i,k,x,y;
+        bool cleared;
+
+        memset(lists, 0, sizeof(lists));
+        memset(&s, 0, sizeof(s));
+
+        for(k = 0; k < n; k++) {
+                x = cells[2*k];
+                y = cells[2*k + 1];
+
+                if(x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT) {
+                        worklistAdd(now, x + y * BOARD_WIDTH);
+                }
+        }
+
+        // Any new row or run must pass through a cell that just landed.
+        while(now->count > 0) {
+                cleared = false;
+
+                for(k = 0; k < now->count; k++) {
+                        i = now->cells[k];
+                        x = i % BOARD_WIDTH;
+                        y = i / BOARD_WIDTH;
+
+                        if(board[i] == None) {
+                                continue;
+                        }
+
+                        if(stepRow(&s, board, y)) {
+                                c.lines++;
+                                cleared = true;
+                        }
+
+                        if(stepRun(&s, board, x, y, 1, 0, H_RUN)) {
+                                c.matches++;
+                                cleared = true;
+                        }
+
+                        if(stepRun(&s, board, x, y, 0, 1, V_RUN)) {
+                                c.matches++;
+                                cleared = true;
+                        }
+                }
+
+                worklistClear(now);
+
+                if(!cleared) {
+                        break;
+                }
+
+                c.chain++;
+
+                for(x = 0; x < BOARD_WIDTH; x++) {
+                        s.low[x] = BOARD_HEIGHT;
+                }
+
+                for(k = 0; k < s.count; k++) {
+                        i = s.touched[k];
+
+                        if(s.flags[i] & GONE) {
+                                board[i] = None;
+                                x = i % BOARD_WIDTH;
+                                y = i / BOARD_WIDTH;
+                                s.low[x] = y < s.low[x] ? y : s.low[x];
+                        }
+
+                        s.flags[i] = 0;
+                }
+
+                s.count = 0;
+                s.rows = 0;
+
+                for(x = 0; x < BOARD_WIDTH; x++) {
+                        if(s.low[x] < BOARD_HEIGHT) {
+                                dropColumn(board, x, s.low[x], next);
+                        }
+                }
+
+                swap = now;
+                now = next;
+                next = swap;
+        }
+
+        return c;
+}
@@ -0,0 +1,24 @@
+#ifndef __cascade_h__
+#define __cascade_h__
+
+#include "game.h"
+
+// --- //
+
+/* What settling a Board cleared */
+typedef struct cascade_t {
+        int lines;    // Full rows
+        int matches;  // Runs of 3 or more matching Fruits
+        int chain;    // Steps that cleared anything. 0 if none did
+} cascade_t;
+
+// --- //
+
+/* Clear every full row and Fruit run, let what's left fall straight
+ * down, and repeat until nothing more clears. Only the `n` cells given
+ * as x,y pairs are looked at first, and after that only cells that
+ * fell, so each step costs what moved rather than the whole Board.
+ */
+cascade_t cascadeResolve(Fruit* board, const int* cells, int n);
+
+#endif
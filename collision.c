@@ -1,12 +1,14 @@
 #include "block.h"
 #include "collision.h"
-#include "cog/dbg.h"
+#include "logger.h"
 
 // --- //
 
 /* Is the given Block colliding with the world? */
 Collision isColliding(block_t* b, Fruit* fs) {
-        int* cells = blockCells(b);
+        int cells[8];
+
+        blockCells(b, cells);
 
         if(collidingDown(cells, fs)) {
                 return Bottom;
@@ -21,13 +23,25 @@ Collision isColliding(block_t* b, Fruit* fs) {
         }
 }
 
+/* Is this grid spot taken? The walls and floor always are, and the
+ * open sky above the Board never is.
+ */
+bool occupied(int x, int y, Fruit* fs) {
+        if(x < 0 || x > 9 || y < 0) {
+                return true;
+        } else if(y > 19) {
+                return false;
+        }
+
+        return fs[x + y * 10] != None;
+}
+
 /* In which direction is the Block colliding? */
 bool collidingLeft(int* cells, Fruit* fs) {
         int i;
 
         for(i = 0; i < 8; i+=2) {
-                if(cells[i] == 0 ||
-                   fs[cells[i] - 1 + cells[i+1] * 10] != None) {
+                if(occupied(cells[i] - 1, cells[i+1], fs)) {
                         return true;
                 }
         }
@@ -39,8 +53,7 @@ bool collidingRight(int* cells, Fruit* fs) {
         int i;
 
         for(i = 0; i < 8; i+=2) {
-                if(cells[i] == 9 ||
-                   fs[cells[i] + 1 + cells[i+1] * 10] != None) {
+                if(occupied(cells[i] + 1, cells[i+1], fs)) {
                         return true;
                 }
         }
@@ -52,8 +65,20 @@ bool collidingDown(int* cells, Fruit* fs) {
         int i;
 
         for(i = 0; i < 8; i+=2) {
-                if(cells[i+1] == 0 ||
-                   fs[cells[i] + (cells[i+1] - 1) * 10] != None) {
+                if(occupied(cells[i], cells[i+1] - 1, fs)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/* Does any cell sit where something already is? */
+bool overlapping(int* cells, Fruit* fs) {
+        int i;
+
+        for(i = 0; i < 8; i+=2) {
+                if(occupied(cells[i], cells[i+1], fs)) {
                         return true;
                 }
         }
@@ -12,9 +12,15 @@ typedef enum { Clear, Left, Right, Bottom } Collision;
 /* Is the given Block colliding with the world? */
 Collision isColliding(block_t* b, Fruit* fs);
 
+/* Is this grid spot taken? */
+bool occupied(int x, int y, Fruit* fs);
+
 /* In which direction is the Block colliding? */
 bool collidingLeft(int*  cells, Fruit* fs);
 bool collidingRight(int* cells, Fruit* fs);
 bool collidingDown(int*  cells, Fruit* fs);
 
+/* Does any cell sit where something already is? */
+bool overlapping(int* cells, Fruit* fs);
+
 #endif
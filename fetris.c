@@ -4,406 +4,465 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
-#include "collision.h"
 #include "block.h"
-#include "cog/camera/camera.h"
-#include "cog/dbg.h"
-#include "cog/shaders/shaders.h"
+#include "capture.h"
+#include "game.h"
+#include "hud.h"
+#include "input.h"
+#include "logger.h"
+#include "mat.h"
+#include "metrics.h"
+#include "program.h"
+#include "rng.h"
+#include "sim.h"
+#include "snapshot.h"
 #include "util.h"
 
 // --- //
 
-GLfloat* blockToCoords();
-void initBoard();
-void clearBoard();
-void newBlock();
-void refreshBlock();
-int refreshBoard();
+/* A packed vertex. Corner coordinates in Grid Space, and which
+ * Palette colour to paint it. The shader does the rest.
+ */
+typedef struct vertex_t {
+        GLubyte x;
+        GLubyte y;
+        GLubyte z;
+        GLubyte colour;
+} vertex_t;
+
+/* One Cell to draw, as an instance of the Cell mesh: where it sits in
+ * Grid Space, which Board it's on, and its Palette colour.
+ */
+typedef struct instance_t {
+        GLubyte x;
+        GLubyte y;
+        GLubyte board;
+        GLubyte colour;
+} instance_t;
 
 // --- //
 
-#define BOARD_CELLS 200
-// 6 floats per vertex, 3 vertices per triangle, 12 triangles per Cell
-#define CELL_FLOATS 6 * 3 * 12
-#define TOTAL_FLOATS BOARD_CELLS * CELL_FLOATS
+// 3 vertices per triangle, 12 triangles per Cell
+#define CELL_VERTS 3 * 12
+#define GRID_VERTS 128
+
+// Palette entries past the Fruits.
+#define GRID_COLOUR  6
+#define PALETTE_SIZE 8
+
+// World Space layout of the Grid, handed to the shader.
+#define CELL_SIZE 33.0f
+#define GAME_SCALE (2.0f / 450)
+
+// Where the upcoming pieces stack up, beside the Board.
+#define PREVIEW_X   13
+#define PREVIEW_TOP 18
+
+// Versus mode. MAX_BOARDS is also the size of the shader's `boards`.
+#define MAX_BOARDS   16
+#define PANEL_WIDTH  560  // World Space room for a Board and its preview
+#define PANEL_HEIGHT 720
+#define PANEL_CELLS  (BOARD_CELLS + 4 * (1 + PREVIEW))  // Most one can draw
+#define MAX_WINDOW_W 1600 // Bigger layouts are shrunk to fit
+#define MAX_WINDOW_H 1000
+#define RIVAL_PERIOD 0.25 // Seconds between a rival's moves
+
+// How the Camera turns: radians per pixel, and how far up or down.
+#define PAN_SPEED (TAU / 7200)
+#define MAX_PITCH (TAU / 4 * 0.99f)
+
+// Longest the window sleeps without news. The sim wakes it sooner.
+#define IDLE_TIMEOUT 1.0
+
+// Seconds between refreshes of the performance overlay.
+#define PERF_PERIOD 0.25
+
+// Which HUD lines say what.
+#define PERF_LINE  0
+#define GAME_LINE  (HUD_LINES - 2)
+#define STATE_LINE (HUD_LINES - 1)
+
+/* One Board on screen, and the Cells it last handed the GPU. The
+ * settled ones (Board and preview) come first, the Block's last.
+ */
+typedef struct panel_t {
+        sim_t* sim;                 // Where the game actually happens
+        game_t* game;
+        unsigned long boardSerial;  // Which Board `cells` holds
+        int settled;
+        int count;
+        instance_t cells[PANEL_CELLS];
+} panel_t;
 
-bool gameOver = false;
-bool running  = true;
 bool keys[1024];
-GLuint wWidth  = 400;
-GLuint wHeight = 720;
+bool cameraMoved = false;  // Does the view need redrawing?
+GLuint wWidth  = PANEL_WIDTH;
+GLuint wHeight = PANEL_HEIGHT;
 
 // Buffer Objects
-GLuint gVAO;
+GLuint gVAO;  // Grid lines, one instance per Board
 GLuint gVBO;
-GLuint bVAO;
-GLuint bVBO;
-GLuint fVAO;
-GLuint fVBO;
+GLuint bVBO;  // ...and which Board each instance is
+GLuint cVAO;  // The Cell mesh, one instance per filled Cell
+GLuint cVBO;
+GLuint iVBO;  // ...and the instances themselves
 
 // Timing Info
-GLfloat deltaTime = 0.0f;
-GLfloat lastFrame = 0.0f;
-GLfloat keyDelta  = 0.0f;
-GLfloat lastKey   = 0.0f;
-
-camera_t* camera;
-matrix_t* view;
-block_t*  block;   // The Tetris block.
-Fruit board[BOARD_CELLS];  // The Board, represented as Fruits.
+latency_t latency;
+
+// Text over the game, and whether to show how it's running.
+hud_t* hud;
+bool perfShown = false;
+
+/* Which corner of a Cell each of its 36 vertices sits on.
+ * Two triangles per face: Back, Front, Left, Right, Top, Bottom.
+ */
+const GLubyte cellCorners[CELL_VERTS][3] = {
+        {0,0,0}, {0,1,0}, {1,0,0},  {0,1,0}, {1,0,0}, {1,1,0},
+        {0,0,1}, {0,1,1}, {1,0,1},  {0,1,1}, {1,0,1}, {1,1,1},
+        {0,0,0}, {0,1,0}, {0,1,1},  {0,0,0}, {0,1,1}, {0,0,1},
+        {1,1,0}, {1,0,0}, {1,1,1},  {1,1,1}, {1,0,1}, {1,0,0},
+        {0,1,1}, {1,1,1}, {1,1,0},  {0,1,1}, {0,1,0}, {1,1,0},
+        {0,0,1}, {1,0,1}, {1,0,0},  {0,0,1}, {0,0,0}, {1,0,0}
+};
+
+// Every Board's filled Cells, back to back. Reused for every upload.
+instance_t instances[MAX_BOARDS * PANEL_CELLS];
+GLsizei instanceCount = 0;
+
+// The Boards, and how they're laid out. The first is the player's.
+panel_t panels[MAX_BOARDS];
+int boards = 1;
+int columns = 1;
+int rows = 1;
+
+// The Camera. Its matrix is rebuilt only when it moves.
+vec3_t camPos;
+vec3_t camDir;
+vec3_t camUp;
+float camYaw;    // Radians
+float camPitch;
+double lastX;    // Where the mouse last was
+double lastY;
+bool panning = false;  // ...if it was anywhere yet
+mat4_t proj;
+mat4_t cameraMatrix;   // proj * view, as the shader wants it
+GLint cameraLoc;
 
 // --- //
 
-/* Move Camera with WASD */
-/* DEPRECIATED
-void moveCamera() {
-        cogcMove(camera,
-                 deltaTime,
-                 keys[GLFW_KEY_W],
-                 keys[GLFW_KEY_S],
-                 keys[GLFW_KEY_A],
-                 keys[GLFW_KEY_D]);
+/* Rebuild the Camera's matrix. Only done when it moves */
+void updateCamera() {
+        mat4_t view;
+
+        m4LookAt(camPos, v3Add(camPos, camDir), camUp, &view);
+        m4Multiply(&proj, &view, &cameraMatrix);
+        cameraMoved = true;
 }
-*/
 
 /* Init/Reset the Camera */
 void resetCamera() {
-        matrix_t* camPos = coglV3(0,0,4);
-        matrix_t* camDir = coglV3(0,0,-1);
-        matrix_t* camUp = coglV3(0,1,0);
-
-        camera = cogcCreate(camPos,camDir,camUp);
+        camPos = vec3(0,0,4);
+        camDir = vec3(0,0,-1);
+        camUp = vec3(0,1,0);
+        camYaw = -TAU / 4;
+        camPitch = 0;
+        panning = false;
+        updateCamera();
 }
 
-/* Clears the board and starts over */
-void resetGame() {
-        initBoard();
-        newBlock();
+/* Turn the Camera as the mouse moves */
+void panCamera(double xpos, double ypos) {
+        // The first position only tells us where the mouse starts.
+        if(panning) {
+                camYaw += (xpos - lastX) * PAN_SPEED;
+                camPitch += (lastY - ypos) * PAN_SPEED;
+                camPitch = fmaxf(-MAX_PITCH, fminf(MAX_PITCH, camPitch));
+
+                camDir = vec3(cosf(camYaw) * cosf(camPitch),
+                              sinf(camPitch),
+                              sinf(camYaw) * cosf(camPitch));
+                updateCamera();
+        }
+
+        lastX = xpos;
+        lastY = ypos;
+        panning = true;
 }
 
-void newBlock() {
-        block = randBlock();
-        refreshBlock();
+/* Add a Cell to a panel, unless it's empty or off the Board */
+void panelAdd(panel_t* p, int b, int x, int y, Fruit f) {
+        if(f != None && x >= 0 && y >= 0) {
+                p->cells[p->count++] = (instance_t){ x, y, b, f };
+        }
 }
 
-void refreshBlock() {
-        GLfloat* coords = blockToCoords();
-        
-        glBindVertexArray(bVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, bVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 
-                        CELL_FLOATS * 4 * sizeof(GLfloat), coords);
-        glBindVertexArray(0);
+/* Bring Board `b`'s Cells up to date with a fresh Frame. The Board and
+ * the upcoming pieces only change when a Block lands, so usually just
+ * the Block's four are redone.
+ */
+void refreshPanel(panel_t* p, int b, frame_t* f) {
+        const int8_t* shape;
+        int i,k,n;
 
-        free(coords);  // Necessary?
-}
+        if(f->boardSerial != p->boardSerial) {
+                p->count = 0;
 
-void key_callback(GLFWwindow* w, int key, int code, int action, int mode) {
-        GLfloat currentTime = glfwGetTime();
-
-        // Update key timing.
-        keyDelta = currentTime - lastKey;
-        lastKey  = currentTime;
-
-        if(action == GLFW_PRESS ||
-           (action == GLFW_REPEAT && keyDelta > 0.01)) {
-                keys[key] = true;
-
-                if(keys[GLFW_KEY_Q]) {
-                        glfwSetWindowShouldClose(w, GL_TRUE);
-                } else if(key == GLFW_KEY_P) {
-                        if(running) {
-                                running = false;
-                        } else {
-                                running = true;
-                        }
-                } else if(key == GLFW_KEY_C) {
-                        resetCamera();
-                } else if(key == GLFW_KEY_R) {
-                        resetGame();
-                } else if(key == GLFW_KEY_LEFT && block->x > 0) {
-                        if(isColliding(block,board) != Left) {
-                                block->x -= 1;
-                                refreshBlock();
-                        }
-                } else if(key == GLFW_KEY_RIGHT && block->x < 9) {
-                        if(isColliding(block,board) != Right) {
-                                block->x += 1;
-                                refreshBlock();
-                        }
-                } else if(key == GLFW_KEY_DOWN && block->y > 0) {
-                        block->y -= 1;
-                        refreshBlock();
-                } else if(key == GLFW_KEY_UP && block->y < 19) {
-                        block_t* copy = copyBlock(block);
-                        copy = rotateBlock(copy);
-                        if(isColliding(copy,board) == Clear) {
-                                block = rotateBlock(block);
-                                destroyBlock(copy);
-                                refreshBlock();
-                        } else {
-                                debug("Flip would collide!");
+                for(i = 0; i < BOARD_CELLS; i++) {
+                        panelAdd(p, b, i % BOARD_WIDTH, i / BOARD_WIDTH,
+                                 f->board[i]);
+                }
+
+                // Soonest on top, beside the Board.
+                for(n = 0; n < PREVIEW; n++) {
+                        shape = pieceShapes[f->next[n]][0];
+
+                        for(k = 0; k < 4; k++) {
+                                panelAdd(p, b, PREVIEW_X + shape[2*k],
+                                         PREVIEW_TOP - 3*n + shape[2*k + 1],
+                                         f->nextFs[n][k]);
                         }
-                } else if(key == GLFW_KEY_SPACE) {
-                        block = shuffleFruit(block);
-                        refreshBlock();
                 }
-        } else if(action == GLFW_RELEASE) {
-                keys[key] = false;
+
+                p->settled = p->count;
+                p->boardSerial = f->boardSerial;
+        }
+
+        // Cells come in A, B, C, D order, as do the Fruits.
+        p->count = p->settled;
+
+        for(i = 0; i < 4; i++) {
+                if(f->cells[2*i + 1] < BOARD_HEIGHT) {
+                        panelAdd(p, b, f->cells[2*i], f->cells[2*i + 1],
+                                 f->fs[i]);
+                }
         }
 }
 
-void mouse_callback(GLFWwindow* w, double xpos, double ypos) {
-        cogcPan(camera,xpos,ypos);
+/* Gather every Board's Cells into one buffer, so a single draw covers
+ * them all. Costs the filled Cells, however many Boards there are.
+ */
+void uploadCells() {
+        int b;
+
+        instanceCount = 0;
+
+        for(b = 0; b < boards; b++) {
+                memcpy(instances + instanceCount, panels[b].cells,
+                       panels[b].count * sizeof(instance_t));
+                instanceCount += panels[b].count;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, iVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0,
+                        instanceCount * sizeof(instance_t), instances);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        metricAdd(UploadBytes, instanceCount * sizeof(instance_t));
 }
 
-GLfloat* gridLocToCoords(int x, int y, Fruit f) {
-        GLfloat* coords = NULL;
-        GLfloat* c      = fruitColour(f);
-        GLuint i;
-        // TODO: This is wrong.
-        GLfloat temp[CELL_FLOATS] = {
-                // Back T1
-                33 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                33 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                // Back T2
-                33 + x*33, 66 + y*33,  0, c[0], c[1], c[2], 
-                66 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                66 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                // Front T1
-                33 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                33 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                // Front T2
-                33 + x*33, 66 + y*33, 33, c[0], c[1], c[2], 
-                66 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                // Left T1
-                33 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                33 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                33 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                // Left T2
-                33 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                33 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                33 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                // Right T1
-                66 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                66 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                // Right T2
-                66 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                // Top T1
-                33 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                // Top T2
-                33 + x*33, 66 + y*33, 33, c[0], c[1], c[2],
-                33 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                66 + x*33, 66 + y*33,  0, c[0], c[1], c[2],
-                // Bottom T1
-                33 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                // Bottom T2
-                33 + x*33, 33 + y*33, 33, c[0], c[1], c[2],
-                33 + x*33, 33 + y*33,  0, c[0], c[1], c[2],
-                66 + x*33, 33 + y*33,  0, c[0], c[1], c[2]
-        };
-
-        check(x > -1 && x < 10 &&
-              y > -1 && x < 20,
-              "Invalid coords given.");
-
-        coords = malloc(sizeof(GLfloat) * CELL_FLOATS);
-        check_mem(coords);
-
-        if(f == None) {
-                // Nullify all the coordinates
-                for(i = 0; i < CELL_FLOATS; i++) {
-                        temp[i] = 0.0;
-                }
+/* Tell OpenGL how to unpack our vertices or instances into `location`.
+ * Expects a bound VAO/VBO.
+ */
+void packedAttribs(GLuint location, GLuint divisor) {
+        glVertexAttribIPointer(location,4,GL_UNSIGNED_BYTE,
+                               sizeof(vertex_t),(GLvoid*)0);
+        glVertexAttribDivisor(location,divisor);
+        glEnableVertexAttribArray(location);
+}
+
+/* Lay the Boards out in a grid, and size the window to fit them */
+void layoutBoards() {
+        float shrink;
+
+        columns = boards <= 4 ? boards : (int)ceil(sqrt(boards));
+        rows = (boards + columns - 1) / columns;
+        shrink = fminf(1, fminf((float)MAX_WINDOW_W / (columns*PANEL_WIDTH),
+                                (float)MAX_WINDOW_H / (rows*PANEL_HEIGHT)));
+        wWidth = columns * PANEL_WIDTH * shrink;
+        wHeight = rows * PANEL_HEIGHT * shrink;
+}
+
+/* Hand the Grid layout and Fruit Palette to the shaders */
+void initUniforms(GLuint program) {
+        GLfloat palette[PALETTE_SIZE * 4] = { 0 };
+        GLfloat offsets[MAX_BOARDS * 3] = { 0 };
+        GLfloat* c;
+        GLuint paletteUBO;
+        GLuint index;
+        int i;
+
+        // std140 pads each vec3 to a vec4.
+        for(i = None; i <= Orange; i++) {
+                c = fruitColour(i);
+                palette[4*i]     = c[0];
+                palette[4*i + 1] = c[1];
+                palette[4*i + 2] = c[2];
+                palette[4*i + 3] = 1.0;
         }
 
-        // Copy values.
-        for(i = 0; i < CELL_FLOATS; i++) {
-                coords[i] = temp[i];
+        for(i = 4 * GRID_COLOUR; i < 4 * GRID_COLOUR + 4; i++) {
+                palette[i] = 1.0;
         }
-        
-        return coords;
- error:
-        return NULL;
+
+        glGenBuffers(1,&paletteUBO);
+        glBindBuffer(GL_UNIFORM_BUFFER,paletteUBO);
+        glBufferData(GL_UNIFORM_BUFFER,sizeof(palette),palette,GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER,0);
+
+        index = glGetUniformBlockIndex(program,"Palette");
+        glUniformBlockBinding(program,index,0);
+        glBindBufferBase(GL_UNIFORM_BUFFER,0,paletteUBO);
+
+        glUseProgram(program);
+        glUniform1f(glGetUniformLocation(program,"cellSize"),CELL_SIZE);
+        glUniform3f(glGetUniformLocation(program,"origin"),
+                    CELL_SIZE,CELL_SIZE,0);
+
+        // Left to right, top to bottom. The whole layout is centred and
+        // scaled to the window, just as a lone Board is.
+        for(i = 0; i < boards; i++) {
+                offsets[3*i]     = (i % columns) * PANEL_WIDTH;
+                offsets[3*i + 1] = (rows - 1 - i / columns) * PANEL_HEIGHT;
+        }
+
+        glUniform3fv(glGetUniformLocation(program,"boards"),boards,offsets);
+        glUniform1f(glGetUniformLocation(program,"scale"),GAME_SCALE / rows);
+        glUniform3f(glGetUniformLocation(program,"offset"),
+                    20 - columns * PANEL_WIDTH / 2,
+                    -rows * PANEL_HEIGHT / 2,0);
+
+        // The projection never changes. The view is folded in later.
+        cameraLoc = glGetUniformLocation(program,"camera");
+        m4Perspective(TAU/8,(float)wWidth/(float)wHeight,0.1f,1000.0f,&proj);
 }
 
-/* Produce locations and colours based on the current global Block */
-GLfloat* blockToCoords() {
-        GLfloat* temp1;
-        GLfloat* temp2;
-        GLfloat* cs = NULL;
-
-        // 4 cells, each has 36 vertices of 6 data points each.
-        //GLfloat* cs = malloc(sizeof(GLfloat) * 4 * 36 * 6);
-        //check_mem(cs);
-
-        // Coords and colours for each cell.
-        GLfloat* a = gridLocToCoords(block->x+block->coords[0],
-                                     block->y+block->coords[1],
-                                     block->fs[0]);
-        GLfloat* b = gridLocToCoords(block->x+block->coords[2],
-                                     block->y+block->coords[3],
-                                     block->fs[1]);
-        GLfloat* c = gridLocToCoords(block->x,
-                                     block->y,
-                                     block->fs[2]);
-        GLfloat* d = gridLocToCoords(block->x+block->coords[4],
-                                     block->y+block->coords[5],
-                                     block->fs[3]);
-
-        check(a && b && c && d, "Couldn't get Cell coordinates.");
-
-         // Construct return value
-        temp1 = append(a, CELL_FLOATS, b, CELL_FLOATS);
-        temp2 = append(c, CELL_FLOATS, d, CELL_FLOATS);
-        cs    = append(temp1, CELL_FLOATS * 2, temp2, CELL_FLOATS * 2);
-        check(cs, "Couldn't construct final list of coords/colours.");
-
-        free(temp1); free(temp2);
-        free(a); free(b); free(c); free(d);
-        
-        return cs;
- error:
-        if(cs) { free(cs); }
-        return NULL;
+/* Put the player's game on the HUD. Only lines that changed are
+ * uploaded again.
+ */
+void hudGame(frame_t* f) {
+        hudLine(hud, GAME_LINE, HudPlain, "PIECES %lu  LINES %lu  MATCHES %lu",
+                f->pieces, f->lines, f->matches);
+
+        if(f->over) {
+                hudLine(hud, STATE_LINE, HudAlert, "GAME OVER");
+        } else {
+                hudLine(hud, STATE_LINE, f->chain > 1 ? HudBright : HudPlain,
+                        "CHAIN %d  NEXT %c%s", f->chain, pieceNames[f->next[0]],
+                        f->running ? "" : "  PAUSED");
+        }
 }
 
-/* Initialize the Block */
-int initBlock() {
-        block = randBlock();
-        check(block, "Failed to initialize first Block.");
-        debug("Got a: %c", block->name);
+/* Refresh the performance overlay: frame time, tick rate, and bytes
+ * sent to the GPU, each averaged since the last refresh. `frameTime` is
+ * the time spent drawing since then, and starts over.
+ */
+void hudPerf(double* frameTime) {
+        static double since = 0;
+        static uint64_t frames, ticks, bytes;
+        static unsigned long draws;
+        static double spent;
+        double t = now();
+        double span = t - since;
+        uint64_t f = metricTotal(Frames);
+        uint64_t k = metricTotal(Ticks);
+        uint64_t u = metricTotal(UploadBytes);
+
+        if(span < PERF_PERIOD) {
+                return;
+        }
 
-        debug("Initializing Block.");
+        if(since) {
+                hudLine(hud, PERF_LINE, HudBright, "FRAME %.2fMS  %.0f FPS",
+                        f > frames ? 1000 * *frameTime / (f - frames) : 0,
+                        (f - frames) / span);
+                hudLine(hud, PERF_LINE + 1, HudBright,
+                        "TICKS %.0f/S  UPLOAD %.1fKB/S  HUD %.1fUS",
+                        (k - ticks) / span, (u - bytes) / span / 1024,
+                        hud->draws > draws ? 1e6 * (hud->spent - spent) /
+                        (hud->draws - draws) : 0);
+        }
 
-        GLfloat* coords = blockToCoords();
-        
-        // Set up VAO/VBO
-        glGenVertexArrays(1,&bVAO);
-        glBindVertexArray(bVAO);
-        glGenBuffers(1,&bVBO);
-        glBindBuffer(GL_ARRAY_BUFFER,bVBO);
-        glBufferData(GL_ARRAY_BUFFER,
-                     CELL_FLOATS * 4 * sizeof(GLfloat),coords,
-                     GL_DYNAMIC_DRAW);
-
-        // Tell OpenGL how to process Block Vertices
-        glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,
-                              6 * sizeof(GLfloat),(GLvoid*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,
-                              6 * sizeof(GLfloat),
-                              (GLvoid*)(3 * sizeof(GLfloat)));
-        glEnableVertexAttribArray(1);
-        glBindVertexArray(0);  // Reset the VAO binding.
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        *frameTime = 0;
+        since = t;
+        frames = f;
+        ticks = k;
+        bytes = u;
+        draws = hud->draws;
+        spent = hud->spent;
+}
 
-        debug("Block initialized.");
+/* Which Action a key performs, if any */
+int keyAction(int key) {
+        switch(key) {
+        case GLFW_KEY_LEFT:  return MoveLeft;
+        case GLFW_KEY_RIGHT: return MoveRight;
+        case GLFW_KEY_DOWN:  return MoveDown;
+        case GLFW_KEY_UP:    return Rotate;
+        case GLFW_KEY_SPACE: return Shuffle;
+        case GLFW_KEY_P:     return Pause;
+        case GLFW_KEY_R:     return Restart;
+        case GLFW_KEY_Z:     return Undo;
+        case GLFW_KEY_Y:     return Redo;
+        default:             return -1;
+        }
+}
 
-        return 1;
- error:
-        return 0;
+void key_callback(GLFWwindow* w, int key, int code, int action, int mode) {
+        int a = keyAction(key);
+
+        // The sim does its own key repeat.
+        if(action == GLFW_REPEAT) {
+                return;
+        }
+
+        if(key >= 0 && key < 1024) {
+                keys[key] = action == GLFW_PRESS;
+        }
+
+        if(a >= 0) {
+                simKey(panels[0].sim, a, action == GLFW_PRESS);
+        } else if(action == GLFW_PRESS && key == GLFW_KEY_Q) {
+                glfwSetWindowShouldClose(w, GL_TRUE);
+        } else if(action == GLFW_PRESS && key == GLFW_KEY_C) {
+                resetCamera();
+        } else if(action == GLFW_PRESS && key == GLFW_KEY_F) {
+                perfShown = !perfShown;
+                hudLine(hud, PERF_LINE, HudBright, "%s", "");
+                hudLine(hud, PERF_LINE + 1, HudBright, "%s", "");
+        }
 }
 
-/* Initialize the Grid */
+void mouse_callback(GLFWwindow* w, double xpos, double ypos) {
+        panCamera(xpos,ypos);
+}
+
+/* Initialize the Grid, drawn once per Board */
 // Insert TRON pun here.
 void initGrid() {
-        GLfloat gridPoints[768];  // Contains colour info as well.
-        int i;
+        vertex_t gridPoints[GRID_VERTS];
+        vertex_t* v = gridPoints;
+        instance_t which[MAX_BOARDS];
+        int i,z;
 
         debug("Initializing Grid.");
 
-        // Back Vertical lines
-	for (i = 0; i < 11; i++) {
-                // Bottom coord
-		gridPoints[12*i]     = 33.0 + (33.0 * i);
-                gridPoints[12*i + 1] = 33.0;
-                gridPoints[12*i + 2] = 0;
-                // Bottom colour
-                gridPoints[12*i + 3] = 1;
-                gridPoints[12*i + 4] = 1;
-                gridPoints[12*i + 5] = 1;
-                // Top coord
-		gridPoints[12*i + 6] = 33.0 + (33.0 * i);
-                gridPoints[12*i + 7] = 693.0;
-                gridPoints[12*i + 8] = 0;
-                // Top colour
-                gridPoints[12*i + 9]  = 1;
-                gridPoints[12*i + 10] = 1;
-                gridPoints[12*i + 11] = 1;
-	}
-
-	// Back Horizontal lines
-	for (i = 0; i < 21; i++) {
-                // Left coord
-		gridPoints[132 + 12*i]     = 33.0;
-                gridPoints[132 + 12*i + 1] = 33.0 + (33.0 * i);
-                gridPoints[132 + 12*i + 2] = 0;
-                // Left colour
-                gridPoints[132 + 12*i + 3] = 1;
-                gridPoints[132 + 12*i + 4] = 1;
-                gridPoints[132 + 12*i + 5] = 1;
-                // Right coord
-		gridPoints[132 + 12*i + 6] = 363.0;
-                gridPoints[132 + 12*i + 7] = 33.0 + (33.0 * i);
-                gridPoints[132 + 12*i + 8] = 0;
-                // Right colour
-                gridPoints[132 + 12*i + 9]  = 1;
-                gridPoints[132 + 12*i + 10] = 1;
-                gridPoints[132 + 12*i + 11] = 1;
-	}
-
-        // Front Vertical lines
-	for (i = 0; i < 11; i++) {
-                // Bottom coord
-		gridPoints[384 + 12*i]     = 33.0 + (33.0 * i);
-                gridPoints[384 + 12*i + 1] = 33.0;
-                gridPoints[384 + 12*i + 2] = 33.0;
-                // Bottom colour
-                gridPoints[384 + 12*i + 3] = 1;
-                gridPoints[384 + 12*i + 4] = 1;
-                gridPoints[384 + 12*i + 5] = 1;
-                // Top coord
-		gridPoints[384 + 12*i + 6] = 33.0 + (33.0 * i);
-                gridPoints[384 + 12*i + 7] = 693.0;
-                gridPoints[384 + 12*i + 8] = 33.0;
-                // Top colour
-                gridPoints[384 + 12*i + 9]  = 1;
-                gridPoints[384 + 12*i + 10] = 1;
-                gridPoints[384 + 12*i + 11] = 1;
-	}
-
-	// Front Horizontal lines
-	for (i = 0; i < 21; i++) {
-                // Left coord
-		gridPoints[516 + 12*i]     = 33.0;
-                gridPoints[516 + 12*i + 1] = 33.0 + (33.0 * i);
-                gridPoints[516 + 12*i + 2] = 33.0;
-                // Left colour
-                gridPoints[516 + 12*i + 3] = 1;
-                gridPoints[516 + 12*i + 4] = 1;
-                gridPoints[516 + 12*i + 5] = 1;
-                // Right coord
-		gridPoints[516 + 12*i + 6] = 363.0;
-                gridPoints[516 + 12*i + 7] = 33.0 + (33.0 * i);
-                gridPoints[516 + 12*i + 8] = 33.0;
-                // Right colour
-                gridPoints[516 + 12*i + 9]  = 1;
-                gridPoints[516 + 12*i + 10] = 1;
-                gridPoints[516 + 12*i + 11] = 1;
-	}
+        // Back lines, then Front lines.
+        for(z = 0; z < 2; z++) {
+                // Vertical lines
+                for(i = 0; i < 11; i++) {
+                        *v++ = (vertex_t){ i,  0, z, GRID_COLOUR };
+                        *v++ = (vertex_t){ i, 20, z, GRID_COLOUR };
+                }
+
+                // Horizontal lines
+                for(i = 0; i < 21; i++) {
+                        *v++ = (vertex_t){  0, i, z, GRID_COLOUR };
+                        *v++ = (vertex_t){ 10, i, z, GRID_COLOUR };
+                }
+        }
 
         // Set up VAO/VBO
         glGenVertexArrays(1,&gVAO);
@@ -414,258 +473,228 @@ void initGrid() {
                      gridPoints,GL_STATIC_DRAW);
 
         // Tell OpenGL how to process Grid Vertices
-        glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,
-                              6 * sizeof(GLfloat),(GLvoid*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,
-                              6 * sizeof(GLfloat),
-                              (GLvoid*)(3 * sizeof(GLfloat)));
-        glEnableVertexAttribArray(1);
+        packedAttribs(0,0);
+
+        // The only thing that differs between Boards is where they are.
+        for(i = 0; i < boards; i++) {
+                which[i] = (instance_t){ 0, 0, i, None };
+        }
+
+        glGenBuffers(1,&bVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, bVBO);
+        glBufferData(GL_ARRAY_BUFFER,boards * sizeof(instance_t),
+                     which,GL_STATIC_DRAW);
+        packedAttribs(1,1);
         glBindVertexArray(0);  // Reset the VAO binding.
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         debug("Grid initialized.");
 }
 
-/* Initialize the game board */
-void initBoard() {
-        debug("Initializing Board.");
+/* Initialize the Cells: one mesh, drawn once per filled Cell */
+void initCells() {
+        vertex_t mesh[CELL_VERTS];
+        int i;
 
-        GLfloat temp[TOTAL_FLOATS];
-        
-        // Set up VAO/VBO
-        glGenVertexArrays(1,&fVAO);
-        glBindVertexArray(fVAO);
-        glGenBuffers(1,&fVBO);
-        glBindBuffer(GL_ARRAY_BUFFER,fVBO);
-        // 200 cells, each has 36 vertices of 6 data points each.
-        glBufferData(GL_ARRAY_BUFFER, 
-                     TOTAL_FLOATS * sizeof(GLfloat),
-                     temp,
-                     GL_DYNAMIC_DRAW);
-        
-        // Tell OpenGL how to process Block Vertices
-        glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,
-                              6 * sizeof(GLfloat),(GLvoid*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,
-                              6 * sizeof(GLfloat),
-                              (GLvoid*)(3 * sizeof(GLfloat)));
-        glEnableVertexAttribArray(1);
-        glBindVertexArray(0);  // Reset the VAO binding.
-        //        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        
-        clearBoard();
+        debug("Initializing Cells.");
 
-        debug("Board initialized.");
-}
+        for(i = 0; i < CELL_VERTS; i++) {
+                mesh[i] = (vertex_t){ cellCorners[i][0], cellCorners[i][1],
+                                      cellCorners[i][2], None };
+        }
 
-/* Move all coloured Cells from the Board */
-void clearBoard() {
-        int i;
+        // Set up VAO/VBOs
+        glGenVertexArrays(1,&cVAO);
+        glBindVertexArray(cVAO);
+        glGenBuffers(1,&cVBO);
+        glBindBuffer(GL_ARRAY_BUFFER,cVBO);
+        glBufferData(GL_ARRAY_BUFFER,sizeof(mesh),mesh,GL_STATIC_DRAW);
+        packedAttribs(0,0);
 
-        for(i = 0; i < BOARD_CELLS; i++) {
-                board[i] = 0;
-        }
+        // Room for every Cell of every Board.
+        glGenBuffers(1,&iVBO);
+        glBindBuffer(GL_ARRAY_BUFFER,iVBO);
+        glBufferData(GL_ARRAY_BUFFER,sizeof(instances),NULL,GL_DYNAMIC_DRAW);
+        packedAttribs(1,1);
 
-        refreshBoard();
+        glBindVertexArray(0);  // Reset the VAO binding.
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        debug("Cells initialized.");
 }
 
-/* Draw all the coloured Board Cells */
-int refreshBoard() {
-        GLuint i,j,k;
-        GLfloat* cellData;
+/* Give a rival's Block a random nudge, and start it over once it tops
+ * out. The player's own game ending is what ends the match.
+ */
+void rivalPlay(panel_t* p, frame_t* f, rng_t* r) {
+        const Action moves[] = { MoveLeft, MoveRight, MoveDown, Rotate,
+                                 Shuffle };
+        Action a = f->over ? Restart : moves[rngBelow(r, 5)];
 
-        debug("Refreshing Board...");
-        
-        GLfloat* coords = malloc(sizeof(GLfloat) * TOTAL_FLOATS);
-        check_mem(coords);
-
-        for(i = 0; i < BOARD_CELLS; i++) {
-                cellData = gridLocToCoords(i % 10, i / 10, board[i]);
-                check(cellData, "Couldn't get coord data for Cell.");
-                
-                for(j = i*CELL_FLOATS, k=0; k < CELL_FLOATS; j++, k++) {
-                        coords[j] = cellData[k];
-                }
-        }
+        simKey(p->sim, a, true);
+        simKey(p->sim, a, false);
+}
 
-        glBindVertexArray(fVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, fVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 
-                        TOTAL_FLOATS * sizeof(GLfloat), coords);
-        glBindVertexArray(0);
+/* Draw into a framebuffer of our own, for a window that's never shown.
+ * Capture reads back from it just the same.
+ */
+int initOffscreen() {
+        GLuint fbo, colour, depth;
+
+        glGenFramebuffers(1,&fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER,fbo);
+
+        glGenRenderbuffers(1,&colour);
+        glBindRenderbuffer(GL_RENDERBUFFER,colour);
+        glRenderbufferStorage(GL_RENDERBUFFER,GL_RGBA8,wWidth,wHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,
+                                  GL_RENDERBUFFER,colour);
+
+        glGenRenderbuffers(1,&depth);
+        glBindRenderbuffer(GL_RENDERBUFFER,depth);
+        glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,
+                              wWidth,wHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER,depth);
+        glBindRenderbuffer(GL_RENDERBUFFER,0);
+
+        // Left bound: everything is drawn here from now on.
+        check(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+              GL_FRAMEBUFFER_COMPLETE, "Offscreen framebuffer incomplete.");
 
-        free(coords);
-        
         return 1;
  error:
-        return 0;        
+        return 0;
 }
 
-/* Removes any solid lines, if it can */
-void lineCheck() {
-        int i,j;
-        bool fullRow = true;
-
-        for(i = 0; i < BOARD_CELLS; i+=10) {
-                fullRow = true;
-
-                // Check for full row
-                for(j = 0; j < 10; j++) {
-                        if(board[i + j] == None) {
-                                fullRow = false;
-                                break;
-                        }
-                }
-
-                if(fullRow) {
-                        debug("Found a full row!");
-                        // Empty the row
-                        for(j = 0; j < 10; j++) {
-                                board[i + j] = None;
-                        }
-
-                        // Drop the other pieces.
-                        // This is evil. C is stupid.
-                        for(i = i + j; i < BOARD_CELLS; i++) {
-                                board[i-10] = board[i];
-                        }
-
-                        break;
-                }
-        }
+/* How to run the game */
+void usage(char* name) {
+        fprintf(stderr, "Usage: %s [-b] [-P] [-d das_ms] [-a arr_ms] "
+                "[-v boards] [-C capture] [-O seconds] [-S socket|port] "
+                "[-s save] [-A archive] [-R replay] [-M metrics] "
+                "[-H port]\n", name);
 }
 
-/* Removes sets of 3 matching Fruits, if it can */
-void fruitCheck() {
-        int i,j,k;
-        Fruit curr;
-        Fruit streakF = None;
-        int streakN;
-
-        // Check columns
-        for(i = 0; i < 10; i++) {
-                streakN = 1;
-
-                for(j = 0; j < 20; j++) {
-                        curr = board[i + j*10];
-
-                        if(curr != None && curr == streakF) {
-                                streakN++;
-
-                                if(streakN == 3) {
-                                        board[i + j*10] = None;
-                                        board[i + (j-1)*10] = None;
-                                        board[i + (j-2)*10] = None;
-
-                                        for(j = j+1; j < 20; j++) {
-                                                board[i+(j-3)*10] = board[i+j*10];
-                                        }
-                                        break;
-                                }
-                        } else {
-                                streakF = curr;
-                                streakN = 1;
-                        }
+int main(int argc, char** argv) {
+        double start = now();
+        double windowUp, glewUp, shadersUp, sceneUp;
+        double das = DEFAULT_DAS;
+        double arr = DEFAULT_ARR;
+        bool busy = false;
+        bool practice = false;
+        char* spectate = NULL;
+        char* savePath = NULL;
+        char* archivePath = NULL;
+        char* replayPath = NULL;
+        char* metricsPath = NULL;
+        char* metricsPort = NULL;
+        char* capturePath = NULL;
+        double offscreen = 0;
+        server_t* server = NULL;
+        capture_t* capture = NULL;
+        FILE* archive = NULL;
+        recorder_t* replay = NULL;
+        history_t* history = NULL;
+        snapshot_t snap;
+        rng_t rivals;
+        uint64_t seed;
+        bool cached;
+        int b,opt;
+
+        while((opt = getopt(argc, argv, "bPd:a:v:C:O:S:s:A:R:M:H:")) != -1) {
+                switch(opt) {
+                case 'v':
+                        boards = atoi(optarg);
+                        break;
+                case 'C':
+                        capturePath = optarg;
+                        break;
+                case 'O':
+                        offscreen = atof(optarg);
+                        break;
+                case 's':
+                        savePath = optarg;
+                        break;
+                case 'A':
+                        archivePath = optarg;
+                        break;
+                case 'R':
+                        replayPath = optarg;
+                        break;
+                case 'M':
+                        metricsPath = optarg;
+                        break;
+                case 'H':
+                        metricsPort = optarg;
+                        break;
+                case 'S':
+                        spectate = optarg;
+                        break;
+                case 'b':
+                        busy = true;
+                        break;
+                case 'P':
+                        practice = true;
+                        break;
+                case 'd':
+                        das = atof(optarg) / 1000;
+                        break;
+                case 'a':
+                        arr = atof(optarg) / 1000;
+                        break;
+                default:
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
                 }
         }
 
-        // Check rows
-        for(j = 0; j < 20; j++) {
-                streakN = 1;
-
-                for(i = 0; i < 10; i++) {
-                        curr = board[i + j*10];
-
-                        if(curr != None && curr == streakF) {
-                                streakN++;
-
-                                if(streakN == 3) {
-                                        board[i + j*10] = None;
-                                        board[i-1 + j*10] = None;
-                                        board[i-2 + j*10] = None;
-
-                                        for(k = j+1; k < 20; k++) {
-                                                board[i-2 + (k-1)*10] = board[i-2 + k*10];
-                                        }
-                                        for(k = j+1; k < 20; k++) {
-                                                board[i-1 + (k-1)*10] = board[i-1 + k*10];
-                                        }
-                                        for(k = j+1; k < 20; k++) {
-                                                board[i + (k-1)*10] = board[i + k*10];
-                                        }
-                                }
-                        } else {
-                                streakF = curr;
-                                streakN = 1;
-                        }
-                }
+        if(boards < 1 || boards > MAX_BOARDS) {
+                fprintf(stderr, "Between 1 and %d boards, please.\n",
+                        MAX_BOARDS);
+                return EXIT_FAILURE;
         }
-}
 
-/* Scrolls the Block naturally down */
-void scrollBlock() {
-        static double lastTime = 0;
-        double currTime = glfwGetTime();
-        int* cells = NULL;
-        int i,j;
-
-        if(!running) {
-                return;
+        // A replay couldn't say where an undo went back to.
+        if(practice && replayPath) {
+                fprintf(stderr, "Practice games can't be recorded.\n");
+                return EXIT_FAILURE;
         }
-        
-        if(isColliding(block, board) != Bottom) {
-                if(currTime - lastTime > 0.5) {
-
-                        lastTime = currTime;
-                        block->y -= 1;
 
-                        GLfloat* coords = blockToCoords();
-        
-                        glBindVertexArray(bVAO);
-                        glBindBuffer(GL_ARRAY_BUFFER, bVBO);
-                        glBufferSubData(GL_ARRAY_BUFFER, 0, 
-                                        CELL_FLOATS * 4 * sizeof(GLfloat),
-                                        coords);
-                        glBindVertexArray(0);
-                }
-        } else if(block->y == 19) {
-                gameOver = true;
-        } else {
-                cells = blockCells(block);
+        // Lines are written by their own thread from here on.
+        check(logStart(), "Couldn't start logging.");
 
-                // Add the Block's cells to the master Board
-                for(i = 0,j=0; i < 8; i+=2,j++) {
-                        board[cells[i] + 10*cells[i+1]] = block->fs[j];
-                }
-
-                lineCheck();
-                fruitCheck();
-                newBlock();
-                refreshBoard();
+        if(metricsPath || metricsPort) {
+                check(metricsStart(metricsPath, metricsPort, METRICS_PERIOD),
+                      "Couldn't export metrics.");
         }
-}
 
-int main(int argc, char** argv) {
         // Initial settings.
         glfwInit();
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
         glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        glfwWindowHint(GLFW_VISIBLE, offscreen ? GL_FALSE : GL_TRUE);
         
         // Make a window.
+        layoutBoards();
         GLFWwindow* w = glfwCreateWindow(wWidth,wHeight,"Fetris",NULL,NULL);
+        check(w, "Couldn't create a window.");
         glfwMakeContextCurrent(w);
+        windowUp = now();
 
         // Fire up GLEW.
         glewExperimental = GL_TRUE;  // For better compatibility.
         glewInit();
+        glewUp = now();
 
         // For the rendering window.
         glViewport(0,0,wWidth,wHeight);
 
+        if(offscreen) {
+                check(initOffscreen(), "Couldn't draw offscreen.");
+        }
+
         // Register callbacks.
         glfwSetKeyCallback(w, key_callback);
         glfwSetInputMode(w,GLFW_CURSOR,GLFW_CURSOR_DISABLED);
@@ -676,87 +705,254 @@ int main(int argc, char** argv) {
 
         // Create Shader Program
         debug("Making shader program.");
-        shaders_t* shaders = cogsShaders("vertex.glsl", "fragment.glsl");
-        GLuint shaderProgram = cogsProgram(shaders);
-        cogsDestroy(shaders);
+        GLuint shaderProgram = loadProgram(&cached);
         check(shaderProgram > 0, "Shaders didn't compile.");
         debug("Shaders good.");
+        initUniforms(shaderProgram);
+        hud = hudCreate(wWidth, wHeight);
+        check(hud, "Couldn't make the HUD.");
+        shadersUp = now();
+
+        if(capturePath) {
+                capture = captureStart(capturePath, wWidth, wHeight);
+                check(capture, "Couldn't capture to %s", capturePath);
+        }
 
-        srand((GLuint)(100000 * glfwGetTime()));
-
-        // Initialize Board, Grid, and first Block
-        initBoard();
+        // Initialize the Grid and Cells
         initGrid();
-        quiet_check(initBlock());
+        initCells();
+
+        // Each game runs on its own thread from here on. Everyone is
+        // dealt the same pieces.
+        seed = (uint64_t)(1e9 * now());
+        rngSeed(&rivals, seed);
+
+        for(b = 0; b < boards; b++) {
+                panels[b].game = gameCreate(seed);
+                check(panels[b].game, "Couldn't create a game.");
+        }
+
+        game_t* game = panels[0].game;
+
+        // Pick up where a crash left off.
+        if(savePath && snapshotLoad(savePath, &snap) && !snap.over &&
+           snapshotRestore(game, &snap)) {
+                log_info("Resumed game at tick %lu.", game->tick);
+        }
+
+        if(archivePath) {
+                archive = archiveCreate(archivePath);
+                check(archive, "Couldn't open %s", archivePath);
+        }
+
+        if(practice) {
+                history = historyCreate(game);
+                check(history, "Couldn't start a practice game.");
+        }
+
+        if(replayPath) {
+                replay = recorderOpen(replayPath, REPLAY_INTERVAL);
+                check(replay, "Couldn't record to %s", replayPath);
+        }
+
+        sim_t* sim = simCreate(game, das, arr);
+        check(sim, "Couldn't create the simulation.");
+        panels[0].sim = sim;
+        sim->notify = busy ? NULL : glfwPostEmptyEvent;
+        sim->savePath = savePath;
+        sim->archive = archive;
+        sim->replay = replay;
+        sim->history = history;
+
+        if(spectate) {
+                server = serverStart(spectate);
+                check(server, "Couldn't start the spectator server.");
+                sim->server = server;
+        }
+
+        check(simStart(sim), "Couldn't start the simulation.");
+
+        for(b = 1; b < boards; b++) {
+                panels[b].sim = simCreate(panels[b].game, das, arr);
+                check(panels[b].sim, "Couldn't create a rival.");
+                panels[b].sim->notify = sim->notify;
+                check(simStart(panels[b].sim), "Couldn't start a rival.");
+        }
 
         // Set initial Camera state
         resetCamera();
+        sceneUp = now();
+
+        log_info("Startup: %.1fms (window %.1fms, GLEW %.1fms, "
+                 "shaders %.1fms %s, scene %.1fms)",
+                 1000 * (sceneUp - start),
+                 1000 * (windowUp - start),
+                 1000 * (glewUp - windowUp),
+                 1000 * (shadersUp - glewUp),
+                 cached ? "cached" : "compiled",
+                 1000 * (sceneUp - shadersUp));
         
-        // Projection Matrix
-        matrix_t* proj = coglMPerspectiveP(tau/8, 
-                                           (float)wWidth/(float)wHeight,
-                                           0.1f,1000.0f);
-
-        GLfloat currentFrame;
+        frame_t* frame;
+        double stamp = 0;
+        double answered = 0;   // The last stamp that made it on screen
+        double drawn;
+        double frameTime = 0;  // Spent drawing, since the overlay's refresh
+        double rivalsDue = now();
+        double until = now() + offscreen;
+        bool bots = boards > 1 || offscreen;
+        bool ended = false;
+        bool fresh;
+        bool dirty = true;
+        bool moved;
         
         debug("Entering Loop.");
         // Render until you shouldn't.
-        while(!glfwWindowShouldClose(w)) {
-                if(gameOver) {
+        while(!glfwWindowShouldClose(w) && (!offscreen || now() < until)) {
+                // Sleep until there's input or the sim has news.
+                if(busy) {
+                        glfwPollEvents();
+                } else if(!dirty) {
+                        glfwWaitEventsTimeout(bots ?
+                                              fmax(0, rivalsDue - now()) :
+                                              perfShown ? PERF_PERIOD :
+                                              IDLE_TIMEOUT);
+                }
+
+                // Only ever draw the latest complete Frames. Offscreen,
+                // nobody's at the keys, so every Board plays itself.
+                moved = false;
+
+                for(b = 0; b < boards; b++) {
+                        frame = simFrame(panels[b].sim, &fresh);
+                        moved |= fresh;
+
+                        if(fresh) {
+                                refreshPanel(&panels[b], b, frame);
+                        }
+
+                        if(b == 0 && fresh) {
+                                hudGame(frame);
+                        }
+
+                        if(b == 0 && !offscreen) {
+                                ended = frame->over;
+                                stamp = fresh ? frame->inputStamp : stamp;
+                        } else if(now() >= rivalsDue) {
+                                rivalPlay(&panels[b], frame, &rivals);
+                        }
+                }
+
+                if(ended) {
                         sleep(1);
                         break;
                 }
 
-                currentFrame = glfwGetTime();
-                deltaTime = currentFrame - lastFrame;
-                lastFrame = currentFrame;
+                if(bots && now() >= rivalsDue) {
+                        rivalsDue = now() + RIVAL_PERIOD;
+                }
 
-                glfwPollEvents();
-                //moveCamera();
-                
-                glClearColor(0.5f,0.5f,0.5f,1.0f);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                if(moved) {
+                        uploadCells();
+                        dirty = true;
+                }
 
-                glUseProgram(shaderProgram);
+                if(perfShown) {
+                        hudPerf(&frameTime);
+                }
+
+                if(hud->dirty) {
+                        dirty = true;
+                }
 
-                // Move the block down.
-                scrollBlock();
-                
-                GLuint viewLoc = glGetUniformLocation(shaderProgram,"view");
-                GLuint projLoc = glGetUniformLocation(shaderProgram,"proj");
+                if(cameraMoved) {
+                        glUseProgram(shaderProgram);
+                        glUniformMatrix4fv(cameraLoc,1,GL_FALSE,
+                                           cameraMatrix.m);
+                        dirty = true;
+                        cameraMoved = false;
+                }
+
+                // Nothing changed, so the last picture still stands.
+                if(!dirty && !busy) {
+                        continue;
+                }
 
-                // Update View Matrix
-                coglMDestroy(view);
-                view = coglM4LookAtP(camera->pos,camera->tar,camera->up);
+                dirty = false;
+                drawn = now();
 
-                // Set transformation Matrices
-                glUniformMatrix4fv(viewLoc,1,GL_FALSE,view->m);
-                glUniformMatrix4fv(projLoc,1,GL_FALSE,proj->m);
+                glClearColor(0.5f,0.5f,0.5f,1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                glUseProgram(shaderProgram);
 
-                // Draw Grid
+                // Draw every Grid, then every Cell: two calls, however
+                // many Boards.
                 glBindVertexArray(gVAO);
-                glDrawArrays(GL_LINES, 0, 128);
-                glBindVertexArray(0);
-                
-                // Draw Block
-                glBindVertexArray(bVAO);
-                glDrawArrays(GL_TRIANGLES,0,36 * 4);
+                glDrawArraysInstanced(GL_LINES, 0, GRID_VERTS, boards);
+                glBindVertexArray(cVAO);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, CELL_VERTS,
+                                      instanceCount);
                 glBindVertexArray(0);
 
-                // Draw Board
-                glBindVertexArray(fVAO);
-                glDrawArrays(GL_TRIANGLES,0,7200);
-                glBindVertexArray(0);
+                // Text goes over everything else.
+                hudDraw(hud);
+
+                // Read back while the GPU is still busy with it.
+                if(capture) {
+                        captureFrame(capture, drawn);
+                }
 
                 // Always comes last.
-                glfwSwapBuffers(w);
+                if(!offscreen) {
+                        glfwSwapBuffers(w);
+                }
+
+                metricAdd(Frames, 1);
+                metricObserve(FrameTime, now() - drawn);
+                frameTime += now() - drawn;
+
+                // The answer to a key press is now on screen. A Frame
+                // published as we took the last may carry its stamp again.
+                if(stamp && stamp != answered) {
+                        latencyRecord(&latency, now() - stamp);
+                        answered = stamp;
+                }
+
+                stamp = 0;
         }
         
         // Clean up.
+        for(b = 0; b < boards; b++) {
+                simStop(panels[b].sim);
+        }
+
+        serverStop(server);
+
+        for(b = 0; b < boards; b++) {
+                gameDestroy(panels[b].game);
+        }
+
+        if(archive) {
+                fclose(archive);
+        }
+
+        recorderClose(replay);
+        historyDestroy(history);
+        captureStop(capture);
+        hudDestroy(hud);
         glfwTerminate();
+
+        if(!ended) {
+                metricAdd(OverQuit, 1);
+        }
+
+        metricsStop();
+        latencyReport(&latency);
         log_info("Thanks for playing!");
+        logStop();
 
         return EXIT_SUCCESS;
  error:
+        logStop();
         return EXIT_FAILURE;
 }
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cascade.h"
+#include "collision.h"
+#include "game.h"
+#include "logger.h"
+#include "metrics.h"
+
+// --- //
+
+/* Create a game with a fresh Board and Block. The same seed and the
+ * same Actions on the same ticks always play out the same way.
+ */
+game_t* gameCreate(uint64_t seed) {
+        game_t* g = malloc(sizeof(game_t));
+        check_mem(g);
+
+        rngSeed(&g->rng, seed);
+        g->boardSerial = 0;
+        check(gameReset(g), "Failed to start a game.");
+
+        return g;
+ error:
+        free(g);
+        return NULL;
+}
+
+/* Clears the board and starts over */
+int gameReset(game_t* g) {
+        int i;
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                g->board[i] = None;
+        }
+
+        queueClear(&g->next);
+        g->block = queueNext(&g->next, &g->rng);
+        debug("Got a: %c", pieceNames[g->block.piece]);
+
+        g->tick = 0;
+        g->boardSerial++;
+        g->lines = 0;
+        g->matches = 0;
+        g->pieces = 0;
+        g->chain = 0;
+        g->gravity = 0;
+        g->running = true;
+        g->over = false;
+
+        return 1;
+}
+
+/* Apply one player Action. Yields whether anything changed */
+bool gameAct(game_t* g, Action a) {
+        block_t* b = &g->block;
+        block_t copy;
+        const int8_t* kick;
+        int cells[8];
+        int k,kicks;
+
+        switch(a) {
+        case Pause:
+                g->running = !g->running;
+                return true;
+        case Restart:
+                if(!g->over) {
+                        metricAdd(OverRestart, 1);
+                }
+                return gameReset(g);
+        default:
+                break;
+        }
+
+        if(!g->running || g->over) {
+                return false;
+        }
+
+        switch(a) {
+        case MoveLeft:
+                // A Block resting on something may still be against a wall.
+                blockCells(b, cells);
+
+                if(!collidingLeft(cells,g->board)) {
+                        b->x -= 1;
+                        return true;
+                }
+                break;
+        case MoveRight:
+                blockCells(b, cells);
+
+                if(!collidingRight(cells,g->board)) {
+                        b->x += 1;
+                        return true;
+                }
+                break;
+        case MoveDown:
+                if(isColliding(b,g->board) != Bottom) {
+                        b->y -= 1;
+                        return true;
+                }
+                break;
+        case Rotate:
+                if(b->y < 19) {
+                        // Turn in place, or else at the first kick that fits.
+                        kicks = pieceKickCounts[b->piece][b->curr];
+
+                        for(k = 0; k < kicks; k++) {
+                                kick = pieceKicks[b->piece][b->curr][k];
+                                copy = *b;
+                                rotateBlock(&copy);
+                                copy.x += kick[0];
+                                copy.y += kick[1];
+                                blockCells(&copy, cells);
+
+                                if(!overlapping(cells,g->board)) {
+                                        *b = copy;
+                                        return true;
+                                }
+                        }
+
+                        debug("Flip would collide!");
+                }
+                break;
+        case Shuffle:
+                shuffleFruit(b);
+                return true;
+        default:
+                break;
+        }
+
+        return false;
+}
+
+/* Advance one tick: gravity, locking, and clearing.
+ * Yields whether anything changed.
+ */
+bool gameTick(game_t* g) {
+        cascade_t c;
+        int cells[8];
+        int i,j,n;
+
+        if(!g->running || g->over) {
+                return false;
+        }
+
+        g->tick++;
+        metricAdd(Ticks, 1);
+
+        if(isColliding(&g->block, g->board) != Bottom) {
+                if(++g->gravity >= GRAVITY_TICKS) {
+                        g->gravity = 0;
+                        g->block.y -= 1;
+                        return true;
+                }
+        } else if(g->block.y == 19) {
+                g->over = true;
+                metricAdd(OverTopOut, 1);
+                return true;
+        } else {
+                blockCells(&g->block, cells);
+
+                // Add the Block's cells to the master Board.
+                // Any still above it are lost.
+                for(i = 0,j=0,n=0; i < 8; i+=2,j++) {
+                        if(cells[i+1] < BOARD_HEIGHT) {
+                                g->board[cells[i] + 10*cells[i+1]] =
+                                        g->block.fs[j];
+                                cells[2*n] = cells[i];
+                                cells[2*n+1] = cells[i+1];
+                                n++;
+                        }
+                }
+
+                // Clear and settle until nothing more goes.
+                c = cascadeResolve(g->board, cells, n);
+                g->lines += c.lines;
+                g->matches += c.matches;
+                g->chain = c.chain;
+                g->pieces++;
+                metricAdd(LinesCleared, c.lines);
+                metricAdd(FruitMatches, c.matches);
+                metricAdd(PiecesLocked, 1);
+                g->block = queueNext(&g->next, &g->rng);
+                g->boardSerial++;
+                return true;
+        }
+
+        return false;
+}
+
+/* Push `rows` rows of garbage up under the stack, solid but for a gap
+ * at column `hole`. Pushing any of the stack past the top, or up into
+ * the falling Block, tops the player out.
+ */
+void gameRaise(game_t* g, int rows, int hole) {
+        int cells[8];
+        bool lost = false;
+        int i,x,y;
+
+        if(rows <= 0) {
+                return;
+        }
+
+        rows = rows < BOARD_HEIGHT ? rows : BOARD_HEIGHT;
+
+        for(i = BOARD_CELLS - rows * BOARD_WIDTH; i < BOARD_CELLS; i++) {
+                lost = lost || g->board[i] != None;
+        }
+
+        memmove(g->board + rows * BOARD_WIDTH, g->board,
+                (BOARD_CELLS - rows * BOARD_WIDTH) * sizeof(Fruit));
+
+        // No two neighbours match, so garbage only goes by clearing rows.
+        for(y = 0; y < rows; y++) {
+                for(x = 0; x < BOARD_WIDTH; x++) {
+                        g->board[x + y * BOARD_WIDTH] = x == hole ? None :
+                                (Fruit)(Grape + (x + y) % 5);
+                }
+        }
+
+        g->boardSerial++;
+        blockCells(&g->block, cells);
+
+        if(!g->over && (lost || overlapping(cells, g->board))) {
+                g->over = true;
+                metricAdd(OverTopOut, 1);
+        }
+}
+
+/* Take a picture of the game */
+void gameFrame(game_t* g, frame_t* f) {
+        block_t next;
+        int i,k;
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                f->board[i] = g->board[i];
+        }
+
+        blockCells(&g->block, f->cells);
+
+        for(i = 0; i < 4; i++) {
+                f->fs[i] = g->block.fs[i];
+        }
+
+        for(i = 0; i < PREVIEW; i++) {
+                next = queuePeek(&g->next, i);
+                f->next[i] = next.piece;
+
+                for(k = 0; k < 4; k++) {
+                        f->nextFs[i][k] = next.fs[k];
+                }
+        }
+
+        f->name = pieceNames[g->block.piece];
+        f->curr = g->block.curr;
+        f->x = g->block.x;
+        f->y = g->block.y;
+        f->tick = g->tick;
+        f->boardSerial = g->boardSerial;
+        f->chain = g->chain;
+        f->lines = g->lines;
+        f->matches = g->matches;
+        f->pieces = g->pieces;
+        f->inputStamp = 0;
+        f->running = g->running;
+        f->over = g->over;
+}
+
+/* Print a Frame as text. Board Fruits are lowercase, the Block's are
+ * uppercase.
+ */
+void frameDump(FILE* out, frame_t* f) {
+        const char* fruits = ".gabpo";
+        char grid[BOARD_CELLS];
+        int i,x,y;
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                grid[i] = fruits[f->board[i] % 6];
+        }
+
+        for(i = 0; i < 4; i++) {
+                x = f->cells[2*i];
+                y = f->cells[2*i + 1];
+
+                if(x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT) {
+                        grid[x + y * BOARD_WIDTH] = fruits[f->fs[i] % 6] - 32;
+                }
+        }
+
+        for(y = BOARD_HEIGHT - 1; y >= 0; y--) {
+                fprintf(out, "|%.*s|\n", BOARD_WIDTH, grid + y * BOARD_WIDTH);
+        }
+
+        fprintf(out, "tick %lu%s%s\n", f->tick,
+                f->running ? "" : " (paused)", f->over ? " GAME OVER" : "");
+}
+
+/* Deallocate a game */
+void gameDestroy(game_t* g) {
+        if(g) {
+                free(g);
+        }
+}
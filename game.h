@@ -0,0 +1,97 @@
+#ifndef __game_h__
+#define __game_h__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "block.h"
+#include "rng.h"
+
+// --- //
+
+#define BOARD_WIDTH  10
+#define BOARD_HEIGHT 20
+#define BOARD_CELLS  200
+
+// The simulation advances in fixed steps.
+#define TICK_RATE     60
+#define GRAVITY_TICKS 30  // The Block falls every half second.
+
+// Undo and Redo are outside the game itself; see history.h.
+typedef enum { MoveLeft, MoveRight, MoveDown, Rotate, Shuffle,
+               Pause, Restart, Undo, Redo } Action;
+
+typedef struct game_t {
+        Fruit board[BOARD_CELLS];  // The Board, represented as Fruits.
+        block_t block;             // The Tetris block.
+        queue_t next;              // ...and the ones after it
+        rng_t rng;                 // Where every Block and Fruit comes from
+        unsigned long tick;        // Steps taken since the last reset
+        unsigned long boardSerial; // Bumped whenever the Board changes
+        unsigned long lines;       // Rows cleared since the last reset
+        unsigned long matches;     // Fruit triples cleared, likewise
+        unsigned long pieces;      // Blocks locked, likewise
+        int chain;                 // Clearing steps the last lock set off
+        int gravity;               // Ticks since the Block last fell
+        bool running;
+        bool over;
+} game_t;
+
+/* A read-only picture of a game, as handed to renderers */
+typedef struct frame_t {
+        Fruit board[BOARD_CELLS];
+        int cells[8];     // Grid-space coords of the Block's cells
+        Fruit fs[4];      // ...and their Fruits
+        int next[PREVIEW];        // Upcoming pieces
+        Fruit nextFs[PREVIEW][4]; // ...and their Fruits
+        char name;        // The Block's pose
+        int curr;
+        int x;
+        int y;
+        unsigned long tick;
+        unsigned long boardSerial;
+        int chain;        // Clearing steps the last lock set off
+        unsigned long lines;    // Since the last reset, as in game_t
+        unsigned long matches;
+        unsigned long pieces;
+        double inputStamp;  // Oldest key press this Frame answers, or 0
+        bool running;
+        bool over;
+} frame_t;
+
+// --- //
+
+/* Create a game with a fresh Board and Block. The same seed and the
+ * same Actions on the same ticks always play out the same way.
+ */
+game_t* gameCreate(uint64_t seed);
+
+/* Clears the board and starts over */
+int gameReset(game_t* g);
+
+/* Apply one player Action. Yields whether anything changed */
+bool gameAct(game_t* g, Action a);
+
+/* Advance one tick: gravity, locking, and clearing.
+ * Yields whether anything changed.
+ */
+bool gameTick(game_t* g);
+
+/* Push `rows` rows of garbage up under the stack, solid but for a gap
+ * at column `hole`. Pushing any of the stack past the top, or up into
+ * the falling Block, ends the game.
+ */
+void gameRaise(game_t* g, int rows, int hole);
+
+/* Take a picture of the game */
+void gameFrame(game_t* g, frame_t* f);
+
+/* Print a Frame as text. Board Fruits are lowercase, the Block's are
+ * uppercase.
+ */
+void frameDump(FILE* out, frame_t* f);
+
+/* Deallocate a game */
+void gameDestroy(game_t* g);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+
+#include "history.h"
+#include "logger.h"
+
+// --- //
+
+#define HISTORY_START 64  // Turns to make room for at first
+
+// --- //
+
+/* Note down a game, with the Board it has */
+void turnTake(turn_t* t, game_t* g, pboard_t* board) {
+        t->board = board;
+        t->block = g->block;
+        t->next = g->next;
+        t->rng = g->rng;
+        t->tick = g->tick;
+        t->lines = g->lines;
+        t->matches = g->matches;
+        t->pieces = g->pieces;
+        t->chain = g->chain;
+        t->gravity = g->gravity;
+}
+
+/* Put a game back the way a turn says */
+void turnRestore(turn_t* t, game_t* g) {
+        pboardRead(t->board, g->board);
+        g->block = t->block;
+        g->next = t->next;
+        g->rng = t->rng;
+        g->tick = t->tick;
+        g->lines = t->lines;
+        g->matches = t->matches;
+        g->pieces = t->pieces;
+        g->chain = t->chain;
+        g->gravity = t->gravity;
+        g->running = true;
+        g->over = false;
+        g->boardSerial++;
+}
+
+/* Start a history at the game as it stands */
+history_t* historyCreate(game_t* g) {
+        history_t* h = calloc(1, sizeof(history_t));
+        pboard_t* board;
+
+        check_mem(h);
+        h->turns = malloc(HISTORY_START * sizeof(turn_t));
+        check_mem(h->turns);
+        h->capacity = HISTORY_START;
+
+        board = pboardCreate(g->board);
+        check(board, "Couldn't create a Board.");
+        turnTake(&h->turns[0], g, board);
+        h->count = 1;
+        h->serial = g->boardSerial;
+
+        return h;
+ error:
+        historyDestroy(h);
+        return NULL;
+}
+
+/* A Block locked or the game restarted: remember the game as it now
+ * stands. Does nothing if it's still on the turn we have.
+ */
+int historyRecord(history_t* h, game_t* g) {
+        turn_t* grown;
+        pboard_t* board;
+
+        if(g->boardSerial == h->serial) {
+                return 1;
+        }
+
+        // Playing on from an undo starts a new future.
+        while(h->count > h->at + 1) {
+                pboardDrop(h->turns[--h->count].board);
+        }
+
+        if(h->count == h->capacity) {
+                grown = realloc(h->turns, 2 * h->capacity * sizeof(turn_t));
+                check_mem(grown);
+                h->turns = grown;
+                h->capacity *= 2;
+        }
+
+        // Only the rows that changed since the last turn are new.
+        board = pboardUpdate(pboardKeep(h->turns[h->at].board), g->board);
+        check(board, "Couldn't record a Board.");
+        turnTake(&h->turns[h->count], g, board);
+        h->at = h->count++;
+        h->serial = g->boardSerial;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Put the game back one turn, to before the last Block locked. Yields
+ * whether there was a turn to go back to.
+ */
+bool historyUndo(history_t* h, game_t* g) {
+        if(h->at == 0) {
+                return false;
+        }
+
+        turnRestore(&h->turns[--h->at], g);
+        h->serial = g->boardSerial;
+        debug("Undone to turn %lu.", (unsigned long)h->at);
+
+        return true;
+}
+
+/* Put the game forward one undone turn, if there is one */
+bool historyRedo(history_t* h, game_t* g) {
+        if(h->at + 1 >= h->count) {
+                return false;
+        }
+
+        turnRestore(&h->turns[++h->at], g);
+        h->serial = g->boardSerial;
+        debug("Redone to turn %lu.", (unsigned long)h->at);
+
+        return true;
+}
+
+/* Deallocate a history */
+void historyDestroy(history_t* h) {
+        size_t i;
+
+        if(h) {
+                for(i = 0; i < h->count; i++) {
+                        pboardDrop(h->turns[i].board);
+                }
+
+                free(h->turns);
+                free(h);
+        }
+}
@@ -0,0 +1,60 @@
+#ifndef __history_h__
+#define __history_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "game.h"
+#include "pboard.h"
+
+// --- //
+
+/* A game as it stood when a Block spawned. The Board shares its rows
+ * with the turns either side, so a turn costs the rows it changed.
+ */
+typedef struct turn_t {
+        pboard_t* board;
+        block_t block;
+        queue_t next;
+        rng_t rng;
+        unsigned long tick;
+        unsigned long lines;
+        unsigned long matches;
+        unsigned long pieces;
+        int chain;
+        int gravity;
+} turn_t;
+
+/* Every turn of a practice game, for unlimited undo and redo. Undoing
+ * and then playing on forgets the turns that were undone.
+ */
+typedef struct history_t {
+        turn_t* turns;
+        size_t count;          // Recorded. Those past `at` can be redone
+        size_t at;             // The turn the game is on
+        size_t capacity;
+        unsigned long serial;  // The game's boardSerial as of `at`
+} history_t;
+
+// --- //
+
+/* Start a history at the game as it stands */
+history_t* historyCreate(game_t* g);
+
+/* A Block locked or the game restarted: remember the game as it now
+ * stands. Does nothing if it's still on the turn we have.
+ */
+int historyRecord(history_t* h, game_t* g);
+
+/* Put the game back one turn, to before the last Block locked. Yields
+ * whether there was a turn to go back to.
+ */
+bool historyUndo(history_t* h, game_t* g);
+
+/* Put the game forward one undone turn, if there is one */
+bool historyRedo(history_t* h, game_t* g);
+
+/* Deallocate a history */
+void historyDestroy(history_t* h);
+
+#endif
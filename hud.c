@@ -0,0 +1,262 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hud.h"
+#include "logger.h"
+#include "metrics.h"
+#include "program.h"
+#include "util.h"
+
+// --- //
+
+// The font: printable ASCII from space to underscore, 5x7 pixels each.
+// Lowercase is drawn as uppercase, and anything else as a '?'.
+#define FIRST_CHAR  ' '
+#define LAST_CHAR   '_'
+#define GLYPH_W     6   // Texels a glyph takes in the atlas, with a gap
+#define GLYPH_H     8
+#define ADVANCE_H   10  // ...and rows a line takes on screen. See the shader.
+#define ATLAS_ROW   16  // Glyphs to a row of the atlas
+#define ATLAS_W     (ATLAS_ROW * GLYPH_W)
+#define ATLAS_H     (4 * GLYPH_H)
+
+/* Each glyph as five columns, left to right. Bit 0 is the top pixel */
+const GLubyte font[LAST_CHAR - FIRST_CHAR + 1][5] = {
+        {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00},  //  !
+        {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},  // "#
+        {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62},  // $%
+        {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00},  // &'
+        {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00},  // ()
+        {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08},  // *+
+        {0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08},  // ,-
+        {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02},  // ./
+        {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00},  // 01
+        {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33},  // 23
+        {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39},  // 45
+        {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07},  // 67
+        {0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E},  // 89
+        {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00},  // :;
+        {0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14},  // <=
+        {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06},  // >?
+        {0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C},  // @A
+        {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},  // BC
+        {0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41},  // DE
+        {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73},  // FG
+        {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00},  // HI
+        {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},  // JK
+        {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F},  // LM
+        {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},  // NO
+        {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E},  // PQ
+        {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32},  // RS
+        {0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F},  // TU
+        {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},  // VW
+        {0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03},  // XY
+        {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41},  // Z[
+        {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F},  // \]
+        {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},  // ^_
+};
+
+/* Each HudColour, as RGBA */
+const GLfloat hudColours[HUD_COLOURS][4] = {
+        { 1.00f, 1.00f, 1.00f, 1.0f },  // Plain
+        { 1.00f, 0.85f, 0.20f, 1.0f },  // Bright
+        { 1.00f, 0.25f, 0.25f, 1.0f },  // Alert
+        { 0.15f, 0.15f, 0.15f, 1.0f },  // Quiet
+};
+
+/* The HUD's shader sources, baked in at build time. See the Makefile. */
+const GLchar hudVertexSource[] =
+#include "hudvertex.glsl.h"
+;
+
+const GLchar hudFragmentSource[] =
+#include "hudfragment.glsl.h"
+;
+
+// --- //
+
+/* Rasterise the font into the atlas texture. Done once */
+GLuint bakeAtlas() {
+        GLubyte texels[ATLAS_H][ATLAS_W] = { { 0 } };
+        GLuint atlas;
+        int c,x,y;
+
+        for(c = 0; c <= LAST_CHAR - FIRST_CHAR; c++) {
+                for(x = 0; x < 5; x++) {
+                        for(y = 0; y < GLYPH_H; y++) {
+                                if(font[c][x] & (1 << y)) {
+                                        texels[(c / ATLAS_ROW) * GLYPH_H + y]
+                                              [(c % ATLAS_ROW) * GLYPH_W + x]
+                                                = 0xFF;
+                                }
+                        }
+                }
+        }
+
+        glGenTextures(1,&atlas);
+        glBindTexture(GL_TEXTURE_2D,atlas);
+        glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+        glTexImage2D(GL_TEXTURE_2D,0,GL_R8,ATLAS_W,ATLAS_H,0,
+                     GL_RED,GL_UNSIGNED_BYTE,texels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,0);
+        glBindTexture(GL_TEXTURE_2D,0);
+
+        return atlas;
+}
+
+/* Which glyph of the atlas draws `c` */
+GLubyte glyphOf(char c) {
+        if(c >= 'a' && c <= 'z') {
+                c += 'A' - 'a';
+        }
+
+        return c >= FIRST_CHAR && c <= LAST_CHAR ? c - FIRST_CHAR :
+                '?' - FIRST_CHAR;
+}
+
+/* A HUD for a `width`x`height` window. Needs a current GL context.
+ * Yields NULL on failure.
+ */
+hud_t* hudCreate(int width, int height) {
+        hud_t* h = calloc(1, sizeof(hud_t));
+        bool cached;
+
+        check_mem(h);
+        h->program = loadProgramFrom(hudVertexSource, hudFragmentSource,
+                                     &cached);
+        check(h->program, "HUD shaders didn't compile.");
+        debug("HUD shaders %s.", cached ? "cached" : "compiled");
+
+        h->columns = width / (HUD_SCALE * GLYPH_W);
+        h->columns = h->columns < HUD_COLUMNS ? h->columns : HUD_COLUMNS;
+        h->rows = height / (HUD_SCALE * ADVANCE_H);
+        check(h->rows >= HUD_LINES, "Window too small for the HUD.");
+
+        h->atlas = bakeAtlas();
+
+        // None of these ever change.
+        glUseProgram(h->program);
+        glUniform2f(glGetUniformLocation(h->program,"screen"),width,height);
+        glUniform1f(glGetUniformLocation(h->program,"glyphScale"),HUD_SCALE);
+        glUniform4fv(glGetUniformLocation(h->program,"colours"),
+                     HUD_COLOURS,&hudColours[0][0]);
+        glUniform1i(glGetUniformLocation(h->program,"atlas"),0);
+        glUseProgram(0);
+
+        // Room for every character there could be.
+        glGenVertexArrays(1,&h->vao);
+        glBindVertexArray(h->vao);
+        glGenBuffers(1,&h->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER,h->vbo);
+        glBufferData(GL_ARRAY_BUFFER,sizeof(h->glyphs),NULL,GL_STREAM_DRAW);
+        glVertexAttribIPointer(0,4,GL_UNSIGNED_BYTE,sizeof(glyph_t),
+                               (GLvoid*)0);
+        glVertexAttribDivisor(0,1);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER,0);
+
+        return h;
+ error:
+        hudDestroy(h);
+        return NULL;
+}
+
+/* Set line `line` to a printf-style string in `colour`. Lines past
+ * HUD_COLUMNS, or the window, are cut short. Costs nothing on screen
+ * unless the text or colour differ from what's there.
+ */
+void hudLine(hud_t* h, int line, HudColour colour, const char* fmt, ...) {
+        char text[HUD_COLUMNS + 1];
+        va_list args;
+
+        if(line < 0 || line >= HUD_LINES) {
+                return;
+        }
+
+        va_start(args, fmt);
+        vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+
+        if(strcmp(text, h->text[line]) || colour != h->colours[line]) {
+                strcpy(h->text[line], text);
+                h->colours[line] = colour;
+                h->dirty = true;
+        }
+}
+
+/* Lay every line's characters out as glyphs, and hand them to the GPU */
+void hudUpload(hud_t* h) {
+        char* c;
+        int i,col,row;
+
+        h->count = 0;
+
+        for(i = 0; i < HUD_LINES; i++) {
+                row = i < HUD_LINES / 2 ? i : h->rows - (HUD_LINES - i);
+
+                for(c = h->text[i], col = 0; *c && col < h->columns; c++) {
+                        if(*c != ' ') {
+                                h->glyphs[h->count++] = (glyph_t){
+                                        col, row, glyphOf(*c), h->colours[i]
+                                };
+                        }
+
+                        col++;
+                }
+        }
+
+        // Orphaned first, so a draw still reading the old glyphs never
+        // holds us up.
+        glBindBuffer(GL_ARRAY_BUFFER,h->vbo);
+        glBufferData(GL_ARRAY_BUFFER,sizeof(h->glyphs),NULL,GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER,0,h->count * sizeof(glyph_t),
+                        h->glyphs);
+        glBindBuffer(GL_ARRAY_BUFFER,0);
+        metricAdd(UploadBytes, h->count * sizeof(glyph_t));
+
+        h->uploads++;
+        h->dirty = false;
+}
+
+/* Draw every line over whatever is drawn so far, uploading them first
+ * if they've changed. Leaves the VAO and program unbound.
+ */
+void hudDraw(hud_t* h) {
+        double began = now();
+
+        if(h->dirty) {
+                hudUpload(h);
+        }
+
+        if(h->count) {
+                glDisable(GL_DEPTH_TEST);
+                glUseProgram(h->program);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D,h->atlas);
+                glBindVertexArray(h->vao);
+                glDrawArraysInstanced(GL_TRIANGLES,0,6,h->count);
+                glBindVertexArray(0);
+                glUseProgram(0);
+                glEnable(GL_DEPTH_TEST);
+        }
+
+        h->draws++;
+        h->spent += now() - began;
+}
+
+/* Deallocate. Needs the same GL context */
+void hudDestroy(hud_t* h) {
+        if(h) {
+                glDeleteBuffers(1,&h->vbo);
+                glDeleteVertexArrays(1,&h->vao);
+                glDeleteTextures(1,&h->atlas);
+                glDeleteProgram(h->program);
+                free(h);
+        }
+}
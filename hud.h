@@ -0,0 +1,72 @@
+#ifndef __hud_h__
+#define __hud_h__
+
+#include <GL/glew.h>
+#include <stdbool.h>
+
+// --- //
+
+#define HUD_LINES   6   // The first half sit at the top, the rest at the bottom
+#define HUD_COLUMNS 48  // Most characters a line holds
+#define HUD_SCALE   2   // Screen pixels to a pixel of the font
+
+/* What colour a line is drawn in */
+typedef enum { HudPlain, HudBright, HudAlert, HudQuiet, HUD_COLOURS } HudColour;
+
+/* One character on screen, as an instance of the glyph quad: its column
+ * and row, its glyph in the atlas, and its HudColour.
+ */
+typedef struct glyph_t {
+        GLubyte col;
+        GLubyte row;
+        GLubyte glyph;
+        GLubyte colour;
+} glyph_t;
+
+/* Lines of text over the game. The font is baked into a texture once,
+ * and every character is a 4-byte instance in one streaming buffer, so
+ * the whole HUD is one draw. The buffer is only rebuilt and uploaded
+ * when some line's text actually changes; otherwise a frame's HUD costs
+ * a handful of GL calls.
+ */
+typedef struct hud_t {
+        GLuint program;
+        GLuint vao;
+        GLuint vbo;
+        GLuint atlas;
+        int rows;       // Character rows and columns that fit the window
+        int columns;
+        char text[HUD_LINES][HUD_COLUMNS + 1];
+        HudColour colours[HUD_LINES];
+        glyph_t glyphs[HUD_LINES * HUD_COLUMNS];
+        GLsizei count;  // Glyphs to draw; spaces aren't
+        bool dirty;     // Some line changed since the last upload
+        // What it costs.
+        unsigned long uploads;
+        unsigned long draws;
+        double spent;   // Seconds in hudDraw(), all told
+} hud_t;
+
+// --- //
+
+/* A HUD for a `width`x`height` window. Needs a current GL context.
+ * Yields NULL on failure.
+ */
+hud_t* hudCreate(int width, int height);
+
+/* Set line `line` to a printf-style string in `colour`. Lines past
+ * HUD_COLUMNS, or the window, are cut short. Costs nothing on screen
+ * unless the text or colour differ from what's there.
+ */
+void hudLine(hud_t* h, int line, HudColour colour, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+/* Draw every line over whatever is drawn so far, uploading them first
+ * if they've changed. Leaves the VAO and program unbound.
+ */
+void hudDraw(hud_t* h);
+
+/* Deallocate. Needs the same GL context */
+void hudDestroy(hud_t* h);
+
+#endif
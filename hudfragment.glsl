@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 vTexel;
+flat in vec4 vColour;
+
+// One byte a texel: lit or not.
+uniform sampler2D atlas;
+
+out vec4 colour;
+
+void main() {
+        if(texelFetch(atlas, ivec2(vTexel), 0).r < 0.5) {
+                discard;
+        }
+
+        colour = vColour;
+}
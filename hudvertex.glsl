@@ -0,0 +1,33 @@
+#version 330 core
+
+// Per instance: the character's column and row on screen, which glyph of
+// the atlas it is, and which of `colours` to paint it.
+layout (location = 0) in uvec4 glyph;
+
+// Window size in pixels, and pixels to an atlas texel.
+uniform vec2  screen;
+uniform float glyphScale;
+uniform vec4  colours[4];
+
+// Texels in one glyph of the atlas, and the room a character takes on
+// screen. Glyphs are 16 to an atlas row. See hud.c.
+const vec2 GLYPH   = vec2(6, 8);
+const vec2 ADVANCE = vec2(6, 10);
+
+// The two triangles of a glyph's quad, top left first.
+const vec2 corners[6] = vec2[6](vec2(0,0), vec2(1,0), vec2(0,1),
+                                vec2(1,0), vec2(1,1), vec2(0,1));
+
+out vec2 vTexel;
+flat out vec4 vColour;
+
+void main() {
+        vec2 corner = corners[gl_VertexID];
+        vec2 pixel = glyphScale * (vec2(glyph.xy) * ADVANCE + corner * GLYPH);
+
+        // Pixels count down from the top left, as text does.
+        gl_Position = vec4(2 * pixel.x / screen.x - 1,
+                           1 - 2 * pixel.y / screen.y, 0, 1);
+        vTexel = (vec2(glyph.z % 16u, glyph.z / 16u) + corner) * GLYPH;
+        vColour = colours[glyph.w];
+}
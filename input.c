@@ -0,0 +1,145 @@
+#include <stdlib.h>
+
+#include "input.h"
+#include "logger.h"
+
+// --- //
+
+/* Only movement repeats while held */
+bool repeats(Action a) {
+        return a == MoveLeft || a == MoveRight || a == MoveDown;
+}
+
+/* Create an input queue with the given repeat timings, in seconds */
+input_t* inputCreate(double das, double arr) {
+        input_t* in = calloc(1, sizeof(input_t));
+        check_mem(in);
+
+        in->events = ringCreate(sizeof(key_event_t), 256);
+        check(in->events, "Couldn't create input ring.");
+        in->das = das;
+        in->arr = arr;
+
+        return in;
+ error:
+        free(in);
+        return NULL;
+}
+
+/* Record a key going down or up. Safe from the window thread only */
+bool inputPush(input_t* in, Action a, bool down, double time) {
+        key_event_t e = { a, down, time };
+
+        return ringPush(in->events, &e);
+}
+
+/* Yield every Action due by time `t`, in order, with the time of the
+ * key event behind it. Repeats are stamped 0. Safe from the sim
+ * thread only.
+ */
+int inputPoll(input_t* in, double t, Action* as, double* stamps) {
+        key_event_t e;
+        key_state_t* k;
+        int n = 0;
+        int i,burst;
+
+        // Fresh presses go first, in the order they happened.
+        while(n < MAX_POLL && ringPop(in->events, &e)) {
+                k = &in->keys[e.action];
+
+                if(e.down && !k->held) {
+                        k->held = true;
+                        k->next = e.time + in->das;
+                        as[n] = e.action;
+                        stamps[n] = e.time;
+                        n++;
+                } else if(!e.down) {
+                        k->held = false;
+                }
+        }
+
+        // Then anything held long enough to repeat.
+        for(i = 0; i < ACTIONS; i++) {
+                k = &in->keys[i];
+
+                if(!k->held || !repeats(i)) {
+                        continue;
+                }
+
+                // Repeats missed while paused or stalled are dropped,
+                // not all fired at once.
+                if(k->next < t - in->arr) {
+                        k->next = t;
+                }
+
+                for(burst = 0; n < MAX_POLL && k->next <= t; burst++) {
+                        as[n] = i;
+                        stamps[n] = 0;
+                        n++;
+
+                        // Instant repeat: one Board's width is plenty.
+                        if(in->arr <= 0) {
+                                if(burst == BOARD_WIDTH) {
+                                        k->next = t;
+                                        break;
+                                }
+                        } else {
+                                k->next += in->arr;
+                        }
+                }
+        }
+
+        return n;
+}
+
+/* Deallocate an input queue */
+void inputDestroy(input_t* in) {
+        if(in) {
+                ringDestroy(in->events);
+                free(in);
+        }
+}
+
+/* Add one measurement */
+void latencyRecord(latency_t* l, double seconds) {
+        int ms = seconds * 1000;
+
+        if(l->count == 0 || seconds < l->min) { l->min = seconds; }
+        if(l->count == 0 || seconds > l->max) { l->max = seconds; }
+
+        l->count++;
+        l->total += seconds;
+        l->buckets[ms < 0 ? 0 : ms > 255 ? 255 : ms]++;
+}
+
+/* The millisecond bucket a fraction `p` of measurements fall under */
+int percentile(latency_t* l, double p) {
+        unsigned long seen = 0;
+        int i;
+
+        for(i = 0; i < 255; i++) {
+                seen += l->buckets[i];
+
+                if(seen >= p * l->count) {
+                        break;
+                }
+        }
+
+        return i + 1;
+}
+
+/* Log a summary of all measurements */
+void latencyReport(latency_t* l) {
+        if(l->count == 0) {
+                return;
+        }
+
+        log_info("Input latency over %lu presses: avg %.1fms, "
+                 "min %.1fms, p50 <%dms, p99 <%dms, max %.1fms",
+                 l->count,
+                 1000 * l->total / l->count,
+                 1000 * l->min,
+                 percentile(l, 0.5),
+                 percentile(l, 0.99),
+                 1000 * l->max);
+}
@@ -0,0 +1,71 @@
+#ifndef __input_h__
+#define __input_h__
+
+#include <stdbool.h>
+
+#include "game.h"
+#include "ring.h"
+
+// --- //
+
+#define ACTIONS     9    // How many kinds of Action there are
+#define DEFAULT_DAS 0.17 // Seconds held before a move starts repeating
+#define DEFAULT_ARR 0.05 // Seconds between repeats after that
+#define MAX_POLL    64   // Most Actions a single poll yields
+
+/* One key going up or down, stamped when it happened */
+typedef struct key_event_t {
+        Action action;
+        bool down;
+        double time;  // Seconds, on the now() clock
+} key_event_t;
+
+/* Where each key is in its press/repeat cycle */
+typedef struct key_state_t {
+        bool held;
+        double next;  // When it next repeats
+} key_state_t;
+
+/* Timestamped key events in, due Actions out. Events are pushed from
+ * the window thread and polled by the sim thread at tick boundaries.
+ */
+typedef struct input_t {
+        ring_t* events;
+        key_state_t keys[ACTIONS];
+        double das;  // Delayed Auto Shift
+        double arr;  // Auto Repeat Rate. 0 repeats to the wall at once.
+} input_t;
+
+/* Input-to-photon latency, in seconds */
+typedef struct latency_t {
+        unsigned long count;
+        double total;
+        double min;
+        double max;
+        unsigned long buckets[256];  // Whole milliseconds, last is overflow
+} latency_t;
+
+// --- //
+
+/* Create an input queue with the given repeat timings, in seconds */
+input_t* inputCreate(double das, double arr);
+
+/* Record a key going down or up. Safe from the window thread only */
+bool inputPush(input_t* in, Action a, bool down, double time);
+
+/* Yield every Action due by time `t`, in order, with the time of the
+ * key event behind it. Repeats are stamped 0. Safe from the sim
+ * thread only.
+ */
+int inputPoll(input_t* in, double t, Action* as, double* stamps);
+
+/* Deallocate an input queue */
+void inputDestroy(input_t* in);
+
+/* Add one measurement */
+void latencyRecord(latency_t* l, double seconds);
+
+/* Log a summary of all measurements */
+void latencyReport(latency_t* l);
+
+#endif
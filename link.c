@@ -0,0 +1,135 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "link.h"
+#include "logger.h"
+#include "util.h"
+
+// --- //
+
+/* A random number in [0, 1) */
+double linkChance(link_t* l) {
+        return (rngNext(&l->rng) >> 11) * (1.0 / (1ULL << 53));
+}
+
+/* Listen on 127.0.0.1:`port` and talk to `peer` on the same host */
+link_t* linkOpen(int port, int peer) {
+        struct sockaddr_in at = { .sin_family = AF_INET };
+        link_t* l = calloc(1, sizeof(link_t));
+
+        check_mem(l);
+        rngSeed(&l->rng, (uint64_t)(1e9 * now()));
+        l->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        check(l->fd >= 0, "Couldn't create socket.");
+        at.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        at.sin_port = htons(port);
+        check(bind(l->fd, (struct sockaddr*)&at, sizeof(at)) == 0,
+              "Couldn't listen on port %d.", port);
+
+        // Only the peer's datagrams get through from here on.
+        at.sin_port = htons(peer);
+        check(connect(l->fd, (struct sockaddr*)&at, sizeof(at)) == 0,
+              "Couldn't pair with port %d.", peer);
+        fcntl(l->fd, F_SETFL, O_NONBLOCK);
+
+        return l;
+ error:
+        if(l && l->fd >= 0) { close(l->fd); }
+        free(l);
+        return NULL;
+}
+
+/* Put a datagram on the wire. Nobody listening yet is no error */
+void linkWrite(link_t* l, const void* buf, size_t len) {
+        if(send(l->fd, buf, len, 0) < 0 && errno != ECONNREFUSED &&
+           errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_warn("Couldn't send to the peer.");
+        }
+
+        l->sent++;
+}
+
+/* Send a datagram, or hold it back to send later if we're playing at
+ * being a slow network
+ */
+void linkSend(link_t* l, const void* buf, size_t len) {
+        datagram_t* d;
+        double delay;
+
+        if(l->loss > 0 && linkChance(l) < l->loss) {
+                l->dropped++;
+                return;
+        }
+
+        delay = l->latency + l->jitter * (2 * linkChance(l) - 1);
+
+        if(delay <= 0) {
+                linkWrite(l, buf, len);
+                return;
+        }
+
+        // A network that backed up this far would drop things too.
+        if(l->count == LINK_HELD || len > MAX_DATAGRAM) {
+                l->dropped++;
+                return;
+        }
+
+        d = &l->held[l->count++];
+        d->due = now() + delay;
+        d->len = len;
+        memcpy(d->data, buf, len);
+}
+
+/* Send every held-back datagram that's due. Yields seconds until the
+ * next one is, or -1 if there are none.
+ */
+double linkPump(link_t* l) {
+        double t = now();
+        double next = -1;
+        int i = 0;
+
+        while(i < l->count) {
+                if(l->held[i].due <= t) {
+                        linkWrite(l, l->held[i].data, l->held[i].len);
+                        l->held[i] = l->held[--l->count];
+                        continue;
+                }
+
+                if(next < 0 || l->held[i].due - t < next) {
+                        next = l->held[i].due - t;
+                }
+
+                i++;
+        }
+
+        return next;
+}
+
+/* Take the next datagram that arrived, if any. Yields its length, or
+ * -1 if nothing is waiting.
+ */
+ssize_t linkRecv(link_t* l, void* buf, size_t cap) {
+        ssize_t n;
+
+        // A refusal is left over from a send before the peer was up.
+        do {
+                n = recv(l->fd, buf, cap, 0);
+        } while(n < 0 && (errno == ECONNREFUSED || errno == EINTR));
+
+        return n;
+}
+
+/* Close the socket and deallocate. Held-back datagrams are lost */
+void linkClose(link_t* l) {
+        if(l) {
+                close(l->fd);
+                free(l);
+        }
+}
@@ -0,0 +1,62 @@
+#ifndef __link_h__
+#define __link_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "rng.h"
+
+// --- //
+
+#define LINK_HELD    256  // Datagrams that can be held back at once
+#define MAX_DATAGRAM 512
+
+/* A datagram held back, to play at being a slower network */
+typedef struct datagram_t {
+        double due;
+        size_t len;
+        unsigned char data[MAX_DATAGRAM];
+} datagram_t;
+
+/* A UDP socket on the loopback, paired with one peer. To try netcode
+ * out without a real network, sends can be held back by `latency`
+ * seconds, give or take up to `jitter`, and dropped with probability
+ * `loss`. Held-back datagrams may overtake each other, as they would.
+ */
+typedef struct link_t {
+        int fd;
+        double latency;
+        double jitter;
+        double loss;
+        rng_t rng;
+        datagram_t held[LINK_HELD];
+        int count;
+        unsigned long sent;
+        unsigned long dropped;
+} link_t;
+
+// --- //
+
+/* Listen on 127.0.0.1:`port` and talk to `peer` on the same host */
+link_t* linkOpen(int port, int peer);
+
+/* Send a datagram, or hold it back to send later if we're playing at
+ * being a slow network
+ */
+void linkSend(link_t* l, const void* buf, size_t len);
+
+/* Send every held-back datagram that's due. Yields seconds until the
+ * next one is, or -1 if there are none.
+ */
+double linkPump(link_t* l);
+
+/* Take the next datagram that arrived, if any. Yields its length, or
+ * -1 if nothing is waiting.
+ */
+ssize_t linkRecv(link_t* l, void* buf, size_t cap);
+
+/* Close the socket and deallocate. Held-back datagrams are lost */
+void linkClose(link_t* l);
+
+#endif
@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "ring.h"
+
+// --- //
+
+#define LOG_BUFFER 65536  // Bytes the writer gathers per write()
+
+/* One thread's queued lines. Only that thread pushes, only the writer
+ * pops. The ring outlives the thread, so nothing queued is lost.
+ */
+typedef struct logshard_t {
+        ring_t* _Atomic ring;
+        _Atomic uint64_t dropped;  // Lines that found the ring full
+        atomic_bool taken;
+} logshard_t;
+
+/* The writer's state */
+typedef struct logger_t {
+        pthread_t thread;
+        int wakeFd;
+        atomic_bool quit;
+        size_t used;
+        char out[LOG_BUFFER];
+} logger_t;
+
+atomic_int logThreshold = LOG_FLOOR;
+
+logshard_t logShards[MAX_WRITERS];
+_Thread_local logshard_t* myLog = NULL;
+_Thread_local bool logging = false;  // Inside logWrite() already?
+_Atomic uint64_t logSeq = 0;
+atomic_bool logRunning = false;
+logger_t* logger = NULL;
+
+const char* levelNames[] = { "debug", "info", "warn", "error" };
+
+// --- //
+
+/* This thread's shard, with a ring. Claims one the first time. NULL if
+ * every shard is taken, or there's no memory for a ring.
+ */
+logshard_t* logShard() {
+        logshard_t* s = myLog;
+        ring_t* r;
+        bool expected;
+        int i;
+
+        for(i = 0; !s && i < MAX_WRITERS; i++) {
+                expected = false;
+
+                if(atomic_compare_exchange_strong(&logShards[i].taken,
+                                                  &expected, true)) {
+                        s = myLog = &logShards[i];
+                }
+        }
+
+        if(s && !atomic_load_explicit(&s->ring, memory_order_acquire)) {
+                r = ringCreate(sizeof(logline_t), LOG_SLOTS);
+
+                if(!r) {
+                        return NULL;
+                }
+
+                atomic_store_explicit(&s->ring, r, memory_order_release);
+        }
+
+        return s;
+}
+
+/* Format the start of a line the way cog/dbg.h always has */
+int logPrefix(char* buf, size_t size, int level, const char* file,
+              int line, int err) {
+        const char* why = err ? strerror(err) : "None";
+
+        switch(level) {
+        case LOG_DEBUG:
+                return snprintf(buf, size, "DEBUG %s:%d: ", file, line);
+        case LOG_INFO:
+                return snprintf(buf, size, "[INFO] (%s:%d) ", file, line);
+        case LOG_WARN:
+                return snprintf(buf, size, "[WARN] (%s:%d: errno: %s) ",
+                                file, line, why);
+        default:
+                return snprintf(buf, size, "[ERROR] (%s:%d: errno: %s) ",
+                                file, line, why);
+        }
+}
+
+/* Queue a line at `level`. Formats on this thread, writes on another */
+void logWrite(int level, const char* file, int line, const char* fmt, ...) {
+        int err = errno;  // Whatever failed, before we touch it
+        size_t room = sizeof(((logline_t*)0)->text) - 1;  // For the \n
+        logshard_t* s = NULL;
+        logline_t l;
+        va_list args;
+        int n;
+
+        n = logPrefix(l.text, room, level, file, line, err);
+        n = n < 0 ? 0 : (size_t)n < room ? n : room;
+
+        va_start(args, fmt);
+        n += vsnprintf(l.text + n, room - n, fmt, args);
+        va_end(args);
+
+        n = (size_t)n < room ? n : room - 1;
+        l.text[n++] = '\n';
+        l.length = n;
+
+        if(atomic_load_explicit(&logRunning, memory_order_acquire) &&
+           !logging) {
+                logging = true;
+                s = logShard();
+                logging = false;
+        }
+
+        if(!s) {
+                // No writer, or no ring to spare. Do it ourselves.
+                fwrite(l.text, 1, l.length, stderr);
+        } else {
+                l.seq = atomic_fetch_add_explicit(&logSeq, 1,
+                                                  memory_order_relaxed);
+
+                if(!ringPush(atomic_load_explicit(&s->ring,
+                                                  memory_order_relaxed),
+                             &l)) {
+                        atomic_fetch_add_explicit(&s->dropped, 1,
+                                                  memory_order_relaxed);
+                }
+        }
+
+        errno = err;
+}
+
+/* Skip lines below `level` from now on */
+void logSetLevel(int level) {
+        level = level < LOG_DEBUG ? LOG_DEBUG :
+                level > LOG_ERROR ? LOG_ERROR : level;
+
+        atomic_store(&logThreshold, level);
+}
+
+/* The level called `name`: debug, info, warn or error. -1 if none */
+int logLevelNamed(const char* name) {
+        int i;
+
+        for(i = LOG_DEBUG; i <= LOG_ERROR; i++) {
+                if(!strcmp(name, levelNames[i])) {
+                        return i;
+                }
+        }
+
+        return -1;
+}
+
+/* Give up this thread's ring before it exits. Queued lines still print */
+void logLeave() {
+        if(myLog) {
+                atomic_store(&myLog->taken, false);
+        }
+
+        myLog = NULL;
+}
+
+/* Send what's gathered to stderr. Only the writer waits on it */
+void logFlush(logger_t* lg) {
+        size_t done = 0;
+        ssize_t n;
+
+        while(done < lg->used) {
+                n = write(STDERR_FILENO, lg->out + done, lg->used - done);
+
+                if(n < 0 && errno == EINTR) {
+                        continue;
+                } else if(n <= 0) {
+                        break;  // Nowhere left to complain to.
+                }
+
+                done += n;
+        }
+
+        lg->used = 0;
+}
+
+/* Gather `length` bytes for the next write */
+void logGather(logger_t* lg, const char* text, size_t length) {
+        if(lg->used + length > LOG_BUFFER) {
+                logFlush(lg);
+        }
+
+        memcpy(lg->out + lg->used, text, length);
+        lg->used += length;
+}
+
+/* Write out every queued line, oldest first across all threads */
+void logDrain(logger_t* lg) {
+        const logline_t* oldest;
+        const logline_t* l;
+        ring_t* from = NULL;
+        ring_t* r;
+        uint64_t dropped;
+        char note[64];
+        int i,n;
+
+        for(;;) {
+                oldest = NULL;
+
+                for(i = 0; i < MAX_WRITERS; i++) {
+                        r = atomic_load_explicit(&logShards[i].ring,
+                                                 memory_order_acquire);
+
+                        if(r && (l = ringPeek(r)) &&
+                           (!oldest || l->seq < oldest->seq)) {
+                                oldest = l;
+                                from = r;
+                        }
+                }
+
+                if(!oldest) {
+                        break;
+                }
+
+                logGather(lg, oldest->text, oldest->length);
+                ringPop(from, NULL);
+        }
+
+        for(i = 0; i < MAX_WRITERS; i++) {
+                dropped = atomic_exchange(&logShards[i].dropped, 0);
+
+                if(dropped) {
+                        n = snprintf(note, sizeof(note),
+                                     "[WARN] Dropped %lu log lines.\n",
+                                     (unsigned long)dropped);
+                        logGather(lg, note, n);
+                }
+        }
+
+        logFlush(lg);
+}
+
+/* Drain the rings every LOG_PERIOD until told to quit */
+void* logLoop(void* arg) {
+        logger_t* lg = arg;
+        struct pollfd p = { lg->wakeFd, POLLIN, 0 };
+
+        while(!atomic_load(&lg->quit)) {
+                poll(&p, 1, LOG_PERIOD * 1000);
+                logDrain(lg);
+        }
+
+        logDrain(lg);
+
+        return NULL;
+}
+
+/* Start the writer thread. The level comes from $FETRIS_LOG, if set */
+int logStart() {
+        logger_t* lg = NULL;
+        char* name = getenv("FETRIS_LOG");
+        int level;
+
+        check(!logger, "Already logging.");
+
+        if(name) {
+                level = logLevelNamed(name);
+                check(level >= 0, "No log level called %s.", name);
+                logSetLevel(level);
+        }
+
+        lg = calloc(1, sizeof(logger_t));
+        check_mem(lg);
+        lg->wakeFd = eventfd(0, EFD_NONBLOCK);
+        check(lg->wakeFd >= 0, "Couldn't create eventfd.");
+        atomic_init(&lg->quit, false);
+
+        check(pthread_create(&lg->thread, NULL, logLoop, lg) == 0,
+              "Couldn't start the log writer.");
+        logger = lg;
+        atomic_store_explicit(&logRunning, true, memory_order_release);
+
+        return 1;
+ error:
+        if(lg) {
+                if(lg->wakeFd >= 0) { close(lg->wakeFd); }
+                free(lg);
+        }
+
+        return 0;
+}
+
+/* Write out everything queued, then stop the writer. Call once the
+ * other threads are done logging.
+ */
+void logStop() {
+        logger_t* lg = logger;
+        uint64_t one = 1;
+        ssize_t n;
+        int i;
+
+        if(lg) {
+                // Anything logged from here on goes straight to stderr.
+                atomic_store_explicit(&logRunning, false,
+                                      memory_order_release);
+                atomic_store(&lg->quit, true);
+                n = write(lg->wakeFd, &one, sizeof(one));
+                (void)n;
+                pthread_join(lg->thread, NULL);
+
+                logger = NULL;
+                close(lg->wakeFd);
+                free(lg);
+
+                for(i = 0; i < MAX_WRITERS; i++) {
+                        ringDestroy(atomic_exchange(&logShards[i].ring,
+                                                    NULL));
+                }
+        }
+}
@@ -0,0 +1,112 @@
+#ifndef __logger_h__
+#define __logger_h__
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "cog/dbg.h"
+
+// --- //
+
+/* Logging that never stalls the thread doing it. Each thread formats
+ * its lines into its own lock-free ring, and one writer thread drains
+ * them all to stderr in order. A full ring drops lines and counts them
+ * rather than wait.
+ *
+ * Including this instead of cog/dbg.h routes debug(), log_info(),
+ * log_warn() and log_err(), and so check() and friends, through it.
+ * Until logStart() is called, or after logStop(), lines are written
+ * straight to stderr as before.
+ */
+
+#define LOG_DEBUG 0
+#define LOG_INFO  1
+#define LOG_WARN  2
+#define LOG_ERROR 3
+
+/* Calls below this level aren't compiled at all. Release builds drop
+ * debug(), and -DLOG_FLOOR=LOG_WARN would drop log_info() too.
+ */
+#ifndef LOG_FLOOR
+#ifdef NDEBUG
+#define LOG_FLOOR LOG_INFO
+#else
+#define LOG_FLOOR LOG_DEBUG
+#endif
+#endif
+
+#define LOG_LINE    256  // Bytes per queued line, longer lines are cut
+#define LOG_SLOTS   256  // Lines each thread may have queued
+#define MAX_WRITERS 16   // Threads with their own ring
+#define LOG_PERIOD  0.01 // Seconds between drains
+
+/* One queued line. `seq` orders lines across threads */
+typedef struct logline_t {
+        uint64_t seq;
+        uint16_t length;
+        char text[LOG_LINE - 10];
+} logline_t;
+
+/* Lines below this level are skipped at runtime */
+extern atomic_int logThreshold;
+
+// --- //
+
+/* Queue a line at `level`. Formats on this thread, writes on another */
+void logWrite(int level, const char* file, int line, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+/* Skip lines below `level` from now on */
+void logSetLevel(int level);
+
+/* The level called `name`: debug, info, warn or error. -1 if none */
+int logLevelNamed(const char* name);
+
+/* Give up this thread's ring before it exits. Queued lines still print */
+void logLeave();
+
+/* Start the writer thread. The level comes from $FETRIS_LOG, if set */
+int logStart();
+
+/* Write out everything queued, then stop the writer. Call once the
+ * other threads are done logging.
+ */
+void logStop();
+
+// --- //
+
+#define LOG_AT(L, M, ...) do {                                          \
+                if((L) >= atomic_load_explicit(&logThreshold,           \
+                                               memory_order_relaxed)) { \
+                        logWrite((L), __FILE__, __LINE__, M,            \
+                                 ##__VA_ARGS__);                        \
+                }                                                       \
+        } while(0)
+
+#undef debug
+#undef log_info
+#undef log_warn
+#undef log_err
+
+#if LOG_FLOOR <= LOG_DEBUG
+#define debug(M, ...) LOG_AT(LOG_DEBUG, M, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+#if LOG_FLOOR <= LOG_INFO
+#define log_info(M, ...) LOG_AT(LOG_INFO, M, ##__VA_ARGS__)
+#else
+#define log_info(M, ...)
+#endif
+
+#if LOG_FLOOR <= LOG_WARN
+#define log_warn(M, ...) LOG_AT(LOG_WARN, M, ##__VA_ARGS__)
+#else
+#define log_warn(M, ...)
+#endif
+
+// Errors are never compiled out.
+#define log_err(M, ...) LOG_AT(LOG_ERROR, M, ##__VA_ARGS__)
+
+#endif
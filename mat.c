@@ -0,0 +1,195 @@
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "mat.h"
+
+// --- //
+
+#ifdef __SSE__
+
+/* A vector into a register. Built from its parts rather than loaded,
+ * since a vec3_t passed by value arrives split across two registers and
+ * a whole load would wait on the stores.
+ */
+__m128 load3(vec3_t v) {
+        return _mm_setr_ps(v.x, v.y, v.z, 0);
+}
+
+/* Every lane set to the dot product of `a` and `b` */
+__m128 dot4(__m128 a, __m128 b) {
+        __m128 p = _mm_mul_ps(a, b);
+        __m128 s = _mm_add_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2,3,0,1)));
+
+        return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1,0,3,2)));
+}
+
+/* The cross product. Lane 3 stays 0 */
+__m128 cross4(__m128 a, __m128 b) {
+        __m128 ayzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,0,2,1));
+        __m128 byzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,0,2,1));
+        __m128 c = _mm_sub_ps(_mm_mul_ps(a, byzx), _mm_mul_ps(ayzx, b));
+
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,0,2,1));
+}
+
+#endif
+
+/* A vector from its parts */
+vec3_t vec3(float x, float y, float z) {
+        vec3_t v = { x, y, z, 0 };
+
+        return v;
+}
+
+vec3_t v3Add(vec3_t a, vec3_t b) {
+        return vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+vec3_t v3Sub(vec3_t a, vec3_t b) {
+        return vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+vec3_t v3Scale(vec3_t a, float s) {
+        return vec3(a.x * s, a.y * s, a.z * s);
+}
+
+float v3Dot(vec3_t a, vec3_t b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+vec3_t v3Cross(vec3_t a, vec3_t b) {
+#ifdef __SSE__
+        vec3_t c;
+
+        _mm_store_ps(&c.x, cross4(load3(a), load3(b)));
+
+        return c;
+#else
+        return vec3(a.y * b.z - a.z * b.y,
+                    a.z * b.x - a.x * b.z,
+                    a.x * b.y - a.y * b.x);
+#endif
+}
+
+/* The same direction, length 1 */
+vec3_t v3Normalize(vec3_t a) {
+#ifdef __SSE__
+        __m128 v = load3(a);
+
+        _mm_store_ps(&a.x, _mm_div_ps(v, _mm_sqrt_ps(dot4(v, v))));
+
+        return a;
+#else
+        return v3Scale(a, 1 / sqrtf(v3Dot(a, a)));
+#endif
+}
+
+/* `out` = `a` * `b`. `out` may be either */
+void m4Multiply(const mat4_t* a, const mat4_t* b, mat4_t* out) {
+#ifdef __SSE__
+        __m128 a0 = _mm_load_ps(a->m);
+        __m128 a1 = _mm_load_ps(a->m + 4);
+        __m128 a2 = _mm_load_ps(a->m + 8);
+        __m128 a3 = _mm_load_ps(a->m + 12);
+        __m128 cols[4];
+        int j;
+
+        // Each column of the product mixes the columns of `a`.
+        for(j = 0; j < 4; j++) {
+                const float* bj = b->m + 4*j;
+
+                cols[j] = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bj[0])),
+                                   _mm_mul_ps(a1, _mm_set1_ps(bj[1]))),
+                        _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(bj[2])),
+                                   _mm_mul_ps(a3, _mm_set1_ps(bj[3]))));
+        }
+
+        for(j = 0; j < 4; j++) {
+                _mm_store_ps(out->m + 4*j, cols[j]);
+        }
+#else
+        mat4_t r;
+        int i,j,k;
+
+        for(j = 0; j < 4; j++) {
+                for(i = 0; i < 4; i++) {
+                        r.m[4*j + i] = 0;
+
+                        for(k = 0; k < 4; k++) {
+                                r.m[4*j + i] += a->m[4*k + i] * b->m[4*j + k];
+                        }
+                }
+        }
+
+        *out = r;
+#endif
+}
+
+/* A view matrix looking from `eye` at `target` */
+void m4LookAt(vec3_t eye, vec3_t target, vec3_t up, mat4_t* out) {
+#ifdef __SSE__
+        __m128 e = load3(eye);
+        __m128 f = _mm_sub_ps(load3(target), e);
+        __m128 s,u,t,r0,r1,r2,r3;
+
+        f = _mm_div_ps(f, _mm_sqrt_ps(dot4(f, f)));
+        s = cross4(f, load3(up));
+        s = _mm_div_ps(s, _mm_sqrt_ps(dot4(s, s)));
+        u = cross4(s, f);
+
+        // The rotation is built as rows and turned into columns. The
+        // translation is the last column.
+        t = _mm_movelh_ps(_mm_sub_ps(_mm_setzero_ps(),
+                                     _mm_unpacklo_ps(dot4(s, e), dot4(u, e))),
+                          _mm_unpacklo_ps(dot4(f, e), _mm_set1_ps(1)));
+        r0 = s;
+        r1 = u;
+        r2 = _mm_sub_ps(_mm_setzero_ps(), f);
+        r3 = _mm_setzero_ps();
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_store_ps(out->m, r0);
+        _mm_store_ps(out->m + 4, r1);
+        _mm_store_ps(out->m + 8, r2);
+        _mm_store_ps(out->m + 12, t);
+#else
+        vec3_t f = v3Normalize(v3Sub(target, eye));
+        vec3_t s = v3Normalize(v3Cross(f, up));
+        vec3_t u = v3Cross(s, f);
+
+        memset(out, 0, sizeof(mat4_t));
+
+        out->m[0] = s.x;
+        out->m[4] = s.y;
+        out->m[8] = s.z;
+        out->m[1] = u.x;
+        out->m[5] = u.y;
+        out->m[9] = u.z;
+        out->m[2] = -f.x;
+        out->m[6] = -f.y;
+        out->m[10] = -f.z;
+        out->m[12] = -v3Dot(s, eye);
+        out->m[13] = -v3Dot(u, eye);
+        out->m[14] = v3Dot(f, eye);
+        out->m[15] = 1;
+#endif
+}
+
+/* A perspective projection. `fovy` is in radians */
+void m4Perspective(float fovy, float aspect, float near, float far,
+                   mat4_t* out) {
+        float f = 1 / tanf(fovy / 2);
+
+        memset(out, 0, sizeof(mat4_t));
+
+        out->m[0] = f / aspect;
+        out->m[5] = f;
+        out->m[10] = (far + near) / (near - far);
+        out->m[11] = -1;
+        out->m[14] = 2 * far * near / (near - far);
+}
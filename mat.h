@@ -0,0 +1,49 @@
+#ifndef __mat_h__
+#define __mat_h__
+
+// --- //
+
+/* Vectors and matrices as plain values, for the camera. Nothing here
+ * touches the heap. With SSE, each is one or four 128-bit registers.
+ */
+
+#define TAU 6.283185307179586f
+
+/* A 3-vector, padded to 16 bytes so it loads whole. `w` is always 0 */
+typedef struct vec3_t {
+        _Alignas(16) float x;
+        float y;
+        float z;
+        float w;
+} vec3_t;
+
+/* A 4x4 matrix, column-major as OpenGL wants it */
+typedef struct mat4_t {
+        _Alignas(16) float m[16];
+} mat4_t;
+
+// --- //
+
+/* A vector from its parts */
+vec3_t vec3(float x, float y, float z);
+
+vec3_t v3Add(vec3_t a, vec3_t b);
+vec3_t v3Sub(vec3_t a, vec3_t b);
+vec3_t v3Scale(vec3_t a, float s);
+float v3Dot(vec3_t a, vec3_t b);
+vec3_t v3Cross(vec3_t a, vec3_t b);
+
+/* The same direction, length 1 */
+vec3_t v3Normalize(vec3_t a);
+
+/* `out` = `a` * `b`. `out` may be either */
+void m4Multiply(const mat4_t* a, const mat4_t* b, mat4_t* out);
+
+/* A view matrix looking from `eye` at `target` */
+void m4LookAt(vec3_t eye, vec3_t target, vec3_t up, mat4_t* out);
+
+/* A perspective projection. `fovy` is in radians */
+void m4Perspective(float fovy, float aspect, float near, float far,
+                   mat4_t* out);
+
+#endif
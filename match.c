@@ -0,0 +1,126 @@
+#include <string.h>
+
+#include "match.h"
+#include "snapshot.h"
+#include "util.h"
+
+// --- //
+
+// Garbage for clearing 0 to 4 rows at once. Each extra clearing step
+// in a chain sends one more.
+const int garbageTable[5] = { 0, 0, 1, 2, 4 };
+
+// --- //
+
+/* Start a match from a seed */
+void matchStart(match_t* m, uint64_t seed) {
+        int p;
+
+        // Padding too, so copies compare and checksum alike.
+        memset(m, 0, sizeof(match_t));
+
+        for(p = 0; p < PLAYERS; p++) {
+                rngSeed(&m->games[p].rng, seed);
+                gameReset(&m->games[p]);
+        }
+
+        rngSeed(&m->holes, ~seed);
+        m->winner = -1;
+}
+
+/* Garbage rows a lock sends for the rows it cleared, and the clearing
+ * steps it took to do it
+ */
+int garbageFor(int lines, int chain) {
+        if(lines <= 0) {
+                return 0;
+        }
+
+        return garbageTable[lines < 4 ? lines : 4] +
+                (chain > 1 ? chain - 1 : 0);
+}
+
+/* Advance one tick, with each player's Actions for it as a mask of
+ * (1 << Action). Yields whether anything changed.
+ */
+bool matchStep(match_t* m, const uint8_t* inputs) {
+        unsigned long lines[PLAYERS];
+        unsigned long pieces;
+        bool locked[PLAYERS];
+        bool changed = false;
+        game_t* g;
+        int p,a,send,cancel;
+
+        if(m->over) {
+                return false;
+        }
+
+        m->tick++;
+
+        for(p = 0; p < PLAYERS; p++) {
+                g = &m->games[p];
+                lines[p] = g->lines;
+                pieces = g->pieces;
+
+                for(a = 0; a <= Shuffle; a++) {
+                        if(inputs[p] & MATCH_MOVES & (1 << a)) {
+                                changed |= gameAct(g, a);
+                        }
+                }
+
+                changed |= gameTick(g);
+                locked[p] = g->pieces != pieces;
+        }
+
+        // Both players' locks count as at once, whoever is listed first.
+        for(p = 0; p < PLAYERS; p++) {
+                if(locked[p]) {
+                        g = &m->games[p];
+                        send = garbageFor(g->lines - lines[p], g->chain);
+
+                        // Clearing rows holds back garbage that's coming.
+                        cancel = send < m->pending[p] ? send : m->pending[p];
+                        m->pending[p] -= cancel;
+                        m->pending[!p] += send - cancel;
+                        m->sent[p] += send - cancel;
+                }
+        }
+
+        for(p = 0; p < PLAYERS; p++) {
+                if(locked[p] && m->pending[p]) {
+                        gameRaise(&m->games[p], m->pending[p],
+                                  rngBelow(&m->holes, BOARD_WIDTH));
+                        m->pending[p] = 0;
+                        changed = true;
+                }
+        }
+
+        // Topping out loses. Both at once is a draw.
+        if(m->games[0].over || m->games[1].over) {
+                m->over = true;
+                m->winner = m->games[0].over == m->games[1].over ? -1 :
+                        m->games[0].over ? 1 : 0;
+        }
+
+        return changed;
+}
+
+/* A checksum of everything in a match, to tell whether two copies of it
+ * have gone their separate ways
+ */
+uint32_t matchSync(match_t* m) {
+        snapshot_t s;
+        uint64_t sums[PLAYERS * 2 + 2];
+        int p;
+
+        for(p = 0; p < PLAYERS; p++) {
+                snapshotTake(&m->games[p], &s);
+                sums[2*p] = s.checksum;
+                sums[2*p + 1] = m->pending[p];
+        }
+
+        sums[2 * PLAYERS] = m->holes.state;
+        sums[2 * PLAYERS + 1] = m->tick;
+
+        return crc32(sums, sizeof(sums));
+}
@@ -0,0 +1,56 @@
+#ifndef __match_h__
+#define __match_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "rng.h"
+
+// --- //
+
+#define PLAYERS 2
+
+// The Actions a player may take in a match, as bits of an input mask.
+// Pausing or restarting would only hold up the other player.
+#define MATCH_MOVES ((1 << MoveLeft) | (1 << MoveRight) | (1 << MoveDown) | \
+                     (1 << Rotate) | (1 << Shuffle))
+
+/* A two-player match. Both players are dealt the same pieces, and
+ * clearing rows sends garbage to the other, which rises under their
+ * stack the next time one of their own Blocks locks.
+ *
+ * It's nothing but plain values, so saving one is a struct copy, and
+ * the same inputs on the same ticks always play out the same way.
+ */
+typedef struct match_t {
+        game_t games[PLAYERS];
+        rng_t holes;                  // Where the gaps in garbage go
+        int pending[PLAYERS];         // Garbage rows waiting under each
+        unsigned long sent[PLAYERS];  // Garbage rows each has sent
+        unsigned long tick;
+        int winner;                   // Once over. -1 for a draw
+        bool over;
+} match_t;
+
+// --- //
+
+/* Start a match from a seed */
+void matchStart(match_t* m, uint64_t seed);
+
+/* Advance one tick, with each player's Actions for it as a mask of
+ * (1 << Action). Yields whether anything changed.
+ */
+bool matchStep(match_t* m, const uint8_t* inputs);
+
+/* Garbage rows a lock sends for the rows it cleared, and the clearing
+ * steps it took to do it
+ */
+int garbageFor(int lines, int chain);
+
+/* A checksum of everything in a match, to tell whether two copies of it
+ * have gone their separate ways
+ */
+uint32_t matchSync(match_t* m);
+
+#endif
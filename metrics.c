@@ -0,0 +1,427 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "metrics.h"
+#include "util.h"
+
+// --- //
+
+#define MAX_TEXT 16384
+
+/* How each counter is exported. Counters sharing a name share a
+ * HELP line and differ by label.
+ */
+typedef struct counter_info_t {
+        const char* name;
+        const char* label;
+        const char* help;
+} counter_info_t;
+
+counter_info_t counterInfo[COUNTERS] = {
+        { "fetris_lines_cleared_total", NULL, "Rows cleared." },
+        { "fetris_fruit_matches_total", NULL, "Fruit triples cleared." },
+        { "fetris_pieces_locked_total", NULL, "Blocks locked into a Board." },
+        { "fetris_ticks_total", NULL, "Game ticks simulated." },
+        { "fetris_frames_total", NULL, "Frames drawn." },
+        { "fetris_upload_bytes_total", NULL, "Vertex bytes sent to the GPU." },
+        { "fetris_allocations_total", NULL, "Heap allocations made." },
+        { "fetris_frees_total", NULL, "Heap allocations freed." },
+        { "fetris_games_over_total", "cause=\"top_out\"", "Games ended." },
+        { "fetris_games_over_total", "cause=\"restart\"", NULL },
+        { "fetris_games_over_total", "cause=\"quit\"", NULL },
+};
+
+const char* histogramNames[HISTOGRAMS] = {
+        "fetris_frame_seconds",
+        "fetris_tick_seconds",
+};
+
+const char* histogramHelp[HISTOGRAMS] = {
+        "Time to draw and present a frame.",
+        "Time the sim spends on one tick.",
+};
+
+/* Upper bounds, in seconds. The last bucket is +Inf. */
+double bounds[BUCKETS - 1] = { 0.0001, 0.0005, 0.001, 0.002, 0.004,
+                               0.008, 0.0167, 0.033, 0.066, 0.133, 0.25 };
+
+shard_t shards[MAX_SHARDS];
+shard_t overflow;  // Shared by any threads beyond MAX_SHARDS
+_Thread_local shard_t* mine = NULL;
+
+/* The exporter's state */
+typedef struct exporter_t {
+        char* path;
+        int listenFd;
+        int wakeFd;
+        double period;
+        double tickRate;  // Over the last period
+        pthread_t thread;
+        atomic_bool quit;
+} exporter_t;
+
+exporter_t* exporter = NULL;
+
+// --- //
+
+/* This thread's shard. Claims one the first time. Never allocates, so
+ * it's safe from inside malloc().
+ */
+shard_t* myShard() {
+        bool expected;
+        int i;
+
+        if(mine) {
+                return mine;
+        }
+
+        for(i = 0; i < MAX_SHARDS; i++) {
+                expected = false;
+
+                if(atomic_compare_exchange_strong(&shards[i].taken,
+                                                  &expected, true)) {
+                        return mine = &shards[i];
+                }
+        }
+
+        return mine = &overflow;
+}
+
+/* Add to one of a shard's values */
+void bump(shard_t* s, _Atomic uint64_t* v, uint64_t n) {
+        if(s == &overflow) {
+                atomic_fetch_add_explicit(v, n, memory_order_relaxed);
+        } else {
+                atomic_store_explicit(v, atomic_load_explicit(
+                                              v, memory_order_relaxed) + n,
+                                      memory_order_relaxed);
+        }
+}
+
+/* Count something on this thread */
+void metricAdd(Counter c, uint64_t n) {
+        shard_t* s = myShard();
+
+        bump(s, &s->counters[c], n);
+}
+
+/* Observe a duration, in seconds, on this thread */
+void metricObserve(Histogram h, double seconds) {
+        shard_t* s = myShard();
+        int b = 0;
+
+        while(b < BUCKETS - 1 && seconds > bounds[b]) {
+                b++;
+        }
+
+        bump(s, &s->buckets[h][b], 1);
+        bump(s, &s->sums[h], (uint64_t)(seconds * 1e9));
+}
+
+/* Give up this thread's shard before it exits. Its counts stay */
+void metricsLeave() {
+        if(mine && mine != &overflow) {
+                atomic_store(&mine->taken, false);
+        }
+
+        mine = NULL;
+}
+
+/* Sum one value over every shard */
+uint64_t total(size_t offset) {
+        uint64_t sum = 0;
+        int i;
+
+        for(i = 0; i <= MAX_SHARDS; i++) {
+                shard_t* s = i < MAX_SHARDS ? &shards[i] : &overflow;
+
+                sum += atomic_load_explicit(
+                        (_Atomic uint64_t*)((char*)s + offset),
+                        memory_order_relaxed);
+        }
+
+        return sum;
+}
+
+/* A counter's total over every thread */
+uint64_t metricTotal(Counter c) {
+        return total(offsetof(shard_t, counters) + c * sizeof(uint64_t));
+}
+
+/* Append formatted text, keeping track of the length it needs */
+void put(char* buf, size_t size, size_t* len, const char* fmt, ...) {
+        va_list args;
+        int n;
+
+        va_start(args, fmt);
+        n = vsnprintf(*len < size ? buf + *len : NULL,
+                      *len < size ? size - *len : 0, fmt, args);
+        va_end(args);
+
+        if(n > 0) {
+                *len += n;
+        }
+}
+
+/* Write every metric in the Prometheus text format into `buf`.
+ * Yields the length, or the size needed if it didn't fit.
+ */
+size_t metricsFormat(char* buf, size_t size) {
+        counter_info_t* c;
+        uint64_t count;
+        size_t len = 0;
+        int i,h,b;
+
+        for(i = 0; i < COUNTERS; i++) {
+                c = &counterInfo[i];
+
+                if(c->help) {
+                        put(buf, size, &len, "# HELP %s %s\n# TYPE %s counter\n",
+                            c->name, c->help, c->name);
+                }
+
+                put(buf, size, &len, "%s%s%s%s %llu\n", c->name,
+                    c->label ? "{" : "", c->label ? c->label : "",
+                    c->label ? "}" : "", (unsigned long long)
+                    total(offsetof(shard_t, counters) + i * sizeof(uint64_t)));
+        }
+
+        for(h = 0; h < HISTOGRAMS; h++) {
+                put(buf, size, &len, "# HELP %s %s\n# TYPE %s histogram\n",
+                    histogramNames[h], histogramHelp[h], histogramNames[h]);
+
+                for(b = 0, count = 0; b < BUCKETS; b++) {
+                        count += total(offsetof(shard_t, buckets) +
+                                       (h * BUCKETS + b) * sizeof(uint64_t));
+
+                        if(b < BUCKETS - 1) {
+                                put(buf, size, &len,
+                                    "%s_bucket{le=\"%g\"} %llu\n",
+                                    histogramNames[h], bounds[b],
+                                    (unsigned long long)count);
+                        } else {
+                                put(buf, size, &len,
+                                    "%s_bucket{le=\"+Inf\"} %llu\n",
+                                    histogramNames[h],
+                                    (unsigned long long)count);
+                        }
+                }
+
+                put(buf, size, &len, "%s_sum %.9f\n%s_count %llu\n",
+                    histogramNames[h],
+                    total(offsetof(shard_t, sums) + h * sizeof(uint64_t)) / 1e9,
+                    histogramNames[h], (unsigned long long)count);
+        }
+
+        if(exporter) {
+                put(buf, size, &len, "# HELP fetris_ticks_per_second "
+                    "Tick rate over the last export period.\n"
+                    "# TYPE fetris_ticks_per_second gauge\n"
+                    "fetris_ticks_per_second %.1f\n", exporter->tickRate);
+        }
+
+        return len;
+}
+
+/* Replace the metrics file, atomically */
+void writeMetrics(const char* path, const char* text, size_t len) {
+        char temp[1024];
+        FILE* f;
+
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
+        f = fopen(temp, "w");
+        check(f, "Couldn't write %s", temp);
+        fwrite(text, 1, len, f);
+        check(fclose(f) == 0, "Couldn't write %s", temp);
+        check(rename(temp, path) == 0, "Couldn't replace %s", path);
+
+ error:
+        return;
+}
+
+/* Answer one scrape. Whatever was asked, the answer is the metrics */
+void serveMetrics(int fd, const char* text, size_t len) {
+        char header[256];
+        char request[1024];
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        int n;
+
+        // Read the request, but don't wait long on a slow client.
+        if(poll(&p, 1, 100) > 0) {
+                n = read(fd, request, sizeof(request));
+                (void)n;
+        }
+
+        n = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+                     "Content-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %lu\r\nConnection: close\r\n\r\n",
+                     (unsigned long)len);
+
+        if(write(fd, header, n) == n) {
+                n = write(fd, text, len);
+        }
+
+        close(fd);
+}
+
+/* The exporter thread */
+void* exportLoop(void* arg) {
+        exporter_t* e = arg;
+        struct pollfd ps[2] = {
+                { .fd = e->wakeFd, .events = POLLIN },
+                { .fd = e->listenFd, .events = POLLIN },
+        };
+        static char text[MAX_TEXT];
+        uint64_t ticks, lastTicks = metricTotal(Ticks);
+        double last = now();
+        double next = last;
+        double t;
+        size_t len;
+        int fd;
+
+        while(!atomic_load(&e->quit)) {
+                t = now();
+
+                if(t >= next) {
+                        ticks = metricTotal(Ticks);
+                        e->tickRate = (ticks - lastTicks) / (t - last);
+                        lastTicks = ticks;
+                        last = t;
+                        next = t + e->period;
+
+                        if(e->path) {
+                                len = metricsFormat(text, sizeof(text));
+                                writeMetrics(e->path, text,
+                                             len < sizeof(text) ? len : 0);
+                        }
+                }
+
+                poll(ps, e->listenFd >= 0 ? 2 : 1,
+                     (int)(1000 * (next - now())) + 1);
+
+                if(e->listenFd >= 0 && (ps[1].revents & POLLIN)) {
+                        fd = accept(e->listenFd, NULL, NULL);
+
+                        if(fd >= 0) {
+                                len = metricsFormat(text, sizeof(text));
+                                serveMetrics(fd, text,
+                                             len < sizeof(text) ? len : 0);
+                        }
+                }
+        }
+
+        // One last look, so the file has the final counts.
+        if(e->path) {
+                len = metricsFormat(text, sizeof(text));
+                writeMetrics(e->path, text, len < sizeof(text) ? len : 0);
+        }
+
+        metricsLeave();
+        logLeave();
+
+        return NULL;
+}
+
+/* Listen for scrapes on a local port */
+int listenLocal(const char* port) {
+        struct sockaddr_in in = { .sin_family = AF_INET };
+        int one = 1;
+        int fd = -1;
+
+        check(isPort(port), "Metrics need a port number, not %s.", port);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        check(fd >= 0, "Couldn't create socket.");
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        in.sin_port = htons(atoi(port));
+        in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        check(bind(fd, (struct sockaddr*)&in, sizeof(in)) == 0,
+              "Couldn't bind to port %s.", port);
+        check(listen(fd, 16) == 0, "Couldn't listen.");
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        return fd;
+ error:
+        if(fd >= 0) { close(fd); }
+        return -1;
+}
+
+/* Export metrics every `period` seconds, to the file at `path` and/or
+ * over HTTP on 127.0.0.1:`port`. Either may be NULL.
+ */
+int metricsStart(const char* path, const char* port, double period) {
+        exporter_t* e = calloc(1, sizeof(exporter_t));
+
+        check_mem(e);
+        e->listenFd = -1;
+        e->wakeFd = -1;
+        check(!exporter, "Metrics are already being exported.");
+
+        e->wakeFd = eventfd(0, EFD_NONBLOCK);
+        e->period = period;
+        check(e->wakeFd >= 0, "Couldn't create eventfd.");
+        atomic_init(&e->quit, false);
+
+        if(path) {
+                e->path = malloc(strlen(path) + 1);
+                check_mem(e->path);
+                strcpy(e->path, path);
+        }
+
+        if(port) {
+                e->listenFd = listenLocal(port);
+                check(e->listenFd >= 0, "Couldn't serve metrics.");
+        }
+
+        exporter = e;
+        check(pthread_create(&e->thread, NULL, exportLoop, e) == 0,
+              "Couldn't start metrics thread.");
+
+        return 1;
+ error:
+        if(exporter == e) {
+                exporter = NULL;
+        }
+
+        if(e) {
+                if(e->listenFd >= 0) { close(e->listenFd); }
+                if(e->wakeFd >= 0) { close(e->wakeFd); }
+                free(e->path);
+                free(e);
+        }
+
+        return 0;
+}
+
+/* Stop exporting, after one last write of the file */
+void metricsStop() {
+        exporter_t* e = exporter;
+        uint64_t one = 1;
+        ssize_t n;
+
+        if(e) {
+                atomic_store(&e->quit, true);
+                n = write(e->wakeFd, &one, sizeof(one));
+                (void)n;
+                pthread_join(e->thread, NULL);
+
+                exporter = NULL;
+
+                if(e->listenFd >= 0) { close(e->listenFd); }
+                close(e->wakeFd);
+                free(e->path);
+                free(e);
+        }
+}
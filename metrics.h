@@ -0,0 +1,62 @@
+#ifndef __metrics_h__
+#define __metrics_h__
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// --- //
+
+/* Every counter we keep */
+typedef enum {
+        LinesCleared, FruitMatches, PiecesLocked, Ticks, Frames,
+        UploadBytes, Allocations, Frees,
+        OverTopOut, OverRestart, OverQuit,  // Why games ended
+        COUNTERS
+} Counter;
+
+/* Every histogram we keep. Observations are in seconds. */
+typedef enum { FrameTime, TickTime, HISTOGRAMS } Histogram;
+
+#define METRICS_PERIOD 5.0  // Seconds between exports
+#define BUCKETS        12   // Including +Inf
+#define MAX_SHARDS     64   // Threads with their own counters
+
+/* One thread's counts. Only that thread writes them, so an update is a
+ * relaxed load and store with no contention. The exporter sums shards
+ * whenever it likes.
+ */
+typedef struct shard_t {
+        _Alignas(64) _Atomic uint64_t counters[COUNTERS];
+        _Atomic uint64_t buckets[HISTOGRAMS][BUCKETS];
+        _Atomic uint64_t sums[HISTOGRAMS];  // Nanoseconds
+        atomic_bool taken;
+} shard_t;
+
+// --- //
+
+/* Count something on this thread */
+void metricAdd(Counter c, uint64_t n);
+
+/* Observe a duration, in seconds, on this thread */
+void metricObserve(Histogram h, double seconds);
+
+/* A counter's total over every thread */
+uint64_t metricTotal(Counter c);
+
+/* Give up this thread's shard before it exits. Its counts stay */
+void metricsLeave();
+
+/* Write every metric in the Prometheus text format into `buf`.
+ * Yields the length, or the size needed if it didn't fit.
+ */
+size_t metricsFormat(char* buf, size_t size);
+
+/* Export metrics every `period` seconds, to the file at `path` and/or
+ * over HTTP on 127.0.0.1:`port`. Either may be NULL.
+ */
+int metricsStart(const char* path, const char* port, double period);
+
+/* Stop exporting, after one last write of the file */
+void metricsStop();
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cog/dbg.h"
+
+// --- //
+
+/* Bakes pieces.txt into the C tables block.c is built with, so turning
+ * and spawning a piece are plain lookups. Run by the Makefile:
+ *
+ *   ./mkpieces < pieces.txt > pieces.h
+ */
+
+#define MAX_PIECES    16
+#define MAX_ROTATIONS 4
+#define MAX_KICKS     5
+#define MAX_SIZE      8    // Widest or tallest drawing
+#define MAX_LINE      256
+
+typedef struct piece_t {
+        char name;
+        int spawnX;
+        int spawnY;
+        int rotations;
+        int shapes[MAX_ROTATIONS][8];      // A, B, C, D about C
+        int kickCounts[MAX_ROTATIONS];
+        int kicks[MAX_ROTATIONS][MAX_KICKS][2];
+        int rows;
+        char art[MAX_SIZE][MAX_ROTATIONS][MAX_SIZE + 1];
+} piece_t;
+
+piece_t pieces[MAX_PIECES];
+int count = 0;
+
+// --- //
+
+/* Read `dx,dy` pairs into a kick list. Yields how many */
+int readKicks(char* s, int kicks[MAX_KICKS][2]) {
+        char* tok;
+        int n = 0;
+
+        for(tok = strtok(s, " \t\n"); tok; tok = strtok(NULL, " \t\n")) {
+                check(n < MAX_KICKS, "More than %d kicks.", MAX_KICKS);
+                check(sscanf(tok, "%d,%d", &kicks[n][0], &kicks[n][1]) == 2,
+                      "Bad kick: %s", tok);
+                n++;
+        }
+
+        check(n > 0, "A piece needs at least one kick.");
+
+        return n;
+ error:
+        return -1;
+}
+
+/* Add one row of art, one token per rotation */
+int readArt(piece_t* p, char* line) {
+        char* tok;
+        int r = 0;
+
+        check(p->rows < MAX_SIZE, "Piece %c is too tall.", p->name);
+
+        for(tok = strtok(line, " \t\n"); tok; tok = strtok(NULL, " \t\n")) {
+                check(r < MAX_ROTATIONS, "Piece %c has too many rotations.",
+                      p->name);
+                check(strlen(tok) <= MAX_SIZE, "Piece %c is too wide.",
+                      p->name);
+                strcpy(p->art[p->rows][r++], tok);
+        }
+
+        check(!p->rows || r == p->rotations,
+              "Piece %c has ragged rotations.", p->name);
+
+        p->rotations = r;
+        p->rows++;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Turn a piece's art into cells about C */
+int finishPiece(piece_t* p) {
+        int r,row,col,k,found;
+        int cx = 0, cy = 0;
+        char c;
+
+        check(p->rows > 0, "Piece %c isn't drawn.", p->name);
+
+        for(r = 0; r < p->rotations; r++) {
+                // Find the centre first. Rows go down the page, y goes up.
+                found = 0;
+
+                for(row = 0; row < p->rows; row++) {
+                        for(col = 0; p->art[row][r][col]; col++) {
+                                if(p->art[row][r][col] == 'C') {
+                                        cx = col;
+                                        cy = row;
+                                        found++;
+                                }
+                        }
+                }
+
+                check(found == 1, "Piece %c rotation %d needs one C.",
+                      p->name, r);
+
+                for(k = 0; k < 4; k++) {
+                        c = "ABCD"[k];
+                        found = 0;
+
+                        for(row = 0; row < p->rows; row++) {
+                                for(col = 0; p->art[row][r][col]; col++) {
+                                        if(p->art[row][r][col] == c) {
+                                                p->shapes[r][2*k] = col - cx;
+                                                p->shapes[r][2*k+1] = cy - row;
+                                                found++;
+                                        }
+                                }
+                        }
+
+                        check(found == 1, "Piece %c rotation %d needs one %c.",
+                              p->name, r, c);
+                }
+
+                check(p->kickCounts[r] > 0, "Piece %c has no kicks.",
+                      p->name);
+        }
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Read every piece from `in` */
+int readPieces(FILE* in) {
+        char line[MAX_LINE];
+        int kicks[MAX_KICKS][2];
+        piece_t* p = NULL;
+        int n,r,from;
+
+        while(fgets(line, sizeof(line), in)) {
+                if(line[0] == '#') {
+                        continue;
+                } else if(!strncmp(line, "piece ", 6)) {
+                        check(!p || finishPiece(p), "Bad piece.");
+                        check(count < MAX_PIECES, "Too many pieces.");
+                        p = &pieces[count++];
+                        check(sscanf(line + 6, " %c %d,%d", &p->name,
+                                     &p->spawnX, &p->spawnY) == 3,
+                              "Bad piece line: %s", line);
+                } else if(!strncmp(line, "kicks ", 6)) {
+                        check(p, "Kicks before any piece.");
+                        from = -1;
+
+                        if(sscanf(line + 6, " %d %n", &r, &n) == 1 &&
+                           line[6 + n] != ',') {
+                                from = r;
+                        } else {
+                                n = 0;
+                        }
+
+                        check(from < MAX_ROTATIONS, "No rotation %d.", from);
+                        n = readKicks(line + 6 + n, kicks);
+                        check(n > 0, "Bad kicks for piece %c.", p->name);
+
+                        for(r = 0; r < MAX_ROTATIONS; r++) {
+                                if(from == -1 || from == r) {
+                                        p->kickCounts[r] = n;
+                                        memcpy(p->kicks[r], kicks,
+                                               sizeof(kicks));
+                                }
+                        }
+                } else if(strspn(line, " \t\n") != strlen(line)) {
+                        check(p, "Art before any piece.");
+                        check(readArt(p, line), "Bad art.");
+                }
+        }
+
+        check(p && finishPiece(p), "Bad piece.");
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Write the tables as C */
+void writePieces(FILE* out) {
+        piece_t* p;
+        int i,r,k;
+
+        fprintf(out, "/* Generated by mkpieces from pieces.txt. "
+                "Edit that, not this. */\n\n");
+
+        fprintf(out, "const char pieceNames[PIECES + 1] = \"");
+        for(i = 0; i < count; i++) {
+                fputc(pieces[i].name, out);
+        }
+        fprintf(out, "\";\n\n");
+
+        fprintf(out, "const uint8_t pieceRotations[PIECES] = {");
+        for(i = 0; i < count; i++) {
+                fprintf(out, "%s%d", i ? ", " : " ", pieces[i].rotations);
+        }
+        fprintf(out, " };\n\n");
+
+        fprintf(out, "const int8_t pieceSpawns[PIECES][2] = {");
+        for(i = 0; i < count; i++) {
+                fprintf(out, "%s{ %d,%d }", i ? ", " : " ",
+                        pieces[i].spawnX, pieces[i].spawnY);
+        }
+        fprintf(out, " };\n\n");
+
+        fprintf(out, "const int8_t pieceShapes[PIECES][MAX_ROTATIONS][8] = {\n");
+        for(i = 0; i < count; i++) {
+                p = &pieces[i];
+                fprintf(out, "        {  // %c\n", p->name);
+
+                for(r = 0; r < p->rotations; r++) {
+                        fprintf(out, "                {");
+                        for(k = 0; k < 8; k++) {
+                                fprintf(out, "%s%d", k ? (k % 2 ? "," : ", ")
+                                        : " ", p->shapes[r][k]);
+                        }
+                        fprintf(out, " },\n");
+                }
+
+                fprintf(out, "        },\n");
+        }
+        fprintf(out, "};\n\n");
+
+        fprintf(out, "const uint8_t pieceKickCounts[PIECES][MAX_ROTATIONS] = {\n");
+        for(i = 0; i < count; i++) {
+                p = &pieces[i];
+                fprintf(out, "        {");
+                for(r = 0; r < p->rotations; r++) {
+                        fprintf(out, "%s%d", r ? ", " : " ",
+                                p->kickCounts[r]);
+                }
+                fprintf(out, " },  // %c\n", p->name);
+        }
+        fprintf(out, "};\n\n");
+
+        fprintf(out, "const int8_t pieceKicks[PIECES][MAX_ROTATIONS]"
+                "[MAX_KICKS][2] = {\n");
+        for(i = 0; i < count; i++) {
+                p = &pieces[i];
+                fprintf(out, "        {  // %c\n", p->name);
+
+                for(r = 0; r < p->rotations; r++) {
+                        fprintf(out, "                {");
+                        for(k = 0; k < p->kickCounts[r]; k++) {
+                                fprintf(out, "%s{ %d,%d }", k ? ", " : " ",
+                                        p->kicks[r][k][0], p->kicks[r][k][1]);
+                        }
+                        fprintf(out, " },\n");
+                }
+
+                fprintf(out, "        },\n");
+        }
+        fprintf(out, "};\n\n");
+
+        fprintf(out, "_Static_assert(PIECES == %d, "
+                "\"pieces.txt and PIECES disagree.\");\n", count);
+}
+
+int main(int argc, char** argv) {
+        check(readPieces(stdin), "Couldn't read the pieces.");
+        writePieces(stdout);
+
+        return EXIT_SUCCESS;
+ error:
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "pboard.h"
+
+// --- //
+
+/* A row of `cells`, or an empty one if that's NULL */
+prow_t* rowCreate(const Fruit* cells) {
+        prow_t* r = malloc(sizeof(prow_t));
+        int x;
+
+        check_mem(r);
+        atomic_init(&r->refs, 1);
+
+        for(x = 0; x < BOARD_WIDTH; x++) {
+                r->cells[x] = cells ? cells[x] : None;
+        }
+
+        return r;
+ error:
+        return NULL;
+}
+
+/* Let go of a row */
+void rowDrop(prow_t* r) {
+        if(r && atomic_fetch_sub(&r->refs, 1) == 1) {
+                free(r);
+        }
+}
+
+/* Is this the only reference? Then it can be changed in place */
+bool unshared(atomic_int* refs) {
+        return atomic_load_explicit(refs, memory_order_acquire) == 1;
+}
+
+/* A version of our own to change, sharing every row with `b`. Uses up
+ * `b`, even if there's no memory for a copy.
+ */
+pboard_t* pboardOwn(pboard_t* b) {
+        pboard_t* c;
+        int y;
+
+        if(unshared(&b->refs)) {
+                return b;
+        }
+
+        c = malloc(sizeof(pboard_t));
+        check_mem(c);
+        atomic_init(&c->refs, 1);
+
+        for(y = 0; y < BOARD_HEIGHT; y++) {
+                c->rows[y] = b->rows[y];
+                atomic_fetch_add_explicit(&c->rows[y]->refs, 1,
+                                          memory_order_relaxed);
+        }
+
+        pboardDrop(b);
+
+        return c;
+ error:
+        pboardDrop(b);
+        return NULL;
+}
+
+/* Row `y` of a version we own, made ours to change too */
+prow_t* rowOwn(pboard_t* b, int y) {
+        prow_t* r = b->rows[y];
+
+        if(!unshared(&r->refs)) {
+                r = rowCreate(r->cells);
+                check(r, "Couldn't copy a row.");
+                rowDrop(b->rows[y]);
+                b->rows[y] = r;
+        }
+
+        return r;
+ error:
+        return NULL;
+}
+
+/* A first version, from a flat Board, or empty if `cells` is NULL */
+pboard_t* pboardCreate(const Fruit* cells) {
+        pboard_t* b = calloc(1, sizeof(pboard_t));
+        prow_t* empty = NULL;
+        int y;
+
+        check_mem(b);
+        atomic_init(&b->refs, 1);
+
+        // Empty rows are all the same row.
+        for(y = 0; y < BOARD_HEIGHT; y++) {
+                if(cells) {
+                        b->rows[y] = rowCreate(cells + y * BOARD_WIDTH);
+                } else if(empty) {
+                        atomic_fetch_add(&empty->refs, 1);
+                        b->rows[y] = empty;
+                } else {
+                        b->rows[y] = empty = rowCreate(NULL);
+                }
+
+                check(b->rows[y], "Couldn't create a row.");
+        }
+
+        return b;
+ error:
+        pboardDrop(b);
+        return NULL;
+}
+
+/* Keep a version. O(1): nothing is copied until someone changes it */
+pboard_t* pboardKeep(pboard_t* b) {
+        atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+
+        return b;
+}
+
+/* Let go of a version */
+void pboardDrop(pboard_t* b) {
+        int y;
+
+        if(b && atomic_fetch_sub(&b->refs, 1) == 1) {
+                for(y = 0; y < BOARD_HEIGHT; y++) {
+                        rowDrop(b->rows[y]);
+                }
+
+                free(b);
+        }
+}
+
+/* What's at `x`,`y` */
+Fruit pboardGet(const pboard_t* b, int x, int y) {
+        return b->rows[y]->cells[x];
+}
+
+/* The version with `x`,`y` set to `f`. Uses up `b`: it's changed in
+ * place if nothing else holds it, and copied otherwise. NULL if there's
+ * no memory.
+ */
+pboard_t* pboardSet(pboard_t* b, int x, int y, Fruit f) {
+        prow_t* r;
+
+        if(b->rows[y]->cells[x] == f) {
+                return b;
+        }
+
+        b = pboardOwn(b);
+        check(b, "Couldn't copy a Board.");
+        r = rowOwn(b, y);
+        check(r, "Couldn't copy a row.");
+        r->cells[x] = f;
+
+        return b;
+ error:
+        pboardDrop(b);
+        return NULL;
+}
+
+/* The version that matches a flat Board, as pboardSet() does. Only
+ * rows that differ are copied, so following a game from lock to lock
+ * costs the rows that changed.
+ */
+pboard_t* pboardUpdate(pboard_t* b, const Fruit* cells) {
+        const Fruit* want;
+        bool owned = false;
+        prow_t* r;
+        int y;
+
+        for(y = 0; y < BOARD_HEIGHT; y++) {
+                want = cells + y * BOARD_WIDTH;
+
+                if(!memcmp(b->rows[y]->cells, want, sizeof(r->cells))) {
+                        continue;
+                }
+
+                if(!owned) {
+                        b = pboardOwn(b);
+                        check(b, "Couldn't copy a Board.");
+                        owned = true;
+                }
+
+                r = rowOwn(b, y);
+                check(r, "Couldn't copy a row.");
+                memcpy(r->cells, want, sizeof(r->cells));
+        }
+
+        return b;
+ error:
+        pboardDrop(b);
+        return NULL;
+}
+
+/* Write a version out as a flat Board */
+void pboardRead(const pboard_t* b, Fruit* cells) {
+        int y;
+
+        for(y = 0; y < BOARD_HEIGHT; y++) {
+                memcpy(cells + y * BOARD_WIDTH, b->rows[y]->cells,
+                       sizeof(b->rows[y]->cells));
+        }
+}
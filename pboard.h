@@ -0,0 +1,58 @@
+#ifndef __pboard_h__
+#define __pboard_h__
+
+#include <stdatomic.h>
+
+#include "game.h"
+
+// --- //
+
+/* One row of a persistent Board. Shared by every version that has it,
+ * and never changed while it is.
+ */
+typedef struct prow_t {
+        atomic_int refs;
+        Fruit cells[BOARD_WIDTH];
+} prow_t;
+
+/* A version of a Board that can be kept around cheaply. Keeping one is
+ * a reference count, and changing one copies only the rows it touches;
+ * every other row stays shared with the versions before it. Versions
+ * may be handed between threads, so long as each is only changed by
+ * whoever holds its last reference.
+ */
+typedef struct pboard_t {
+        atomic_int refs;
+        prow_t* rows[BOARD_HEIGHT];
+} pboard_t;
+
+// --- //
+
+/* A first version, from a flat Board, or empty if `cells` is NULL */
+pboard_t* pboardCreate(const Fruit* cells);
+
+/* Keep a version. O(1): nothing is copied until someone changes it */
+pboard_t* pboardKeep(pboard_t* b);
+
+/* Let go of a version */
+void pboardDrop(pboard_t* b);
+
+/* What's at `x`,`y` */
+Fruit pboardGet(const pboard_t* b, int x, int y);
+
+/* The version with `x`,`y` set to `f`. Uses up `b`: it's changed in
+ * place if nothing else holds it, and copied otherwise. NULL if there's
+ * no memory.
+ */
+pboard_t* pboardSet(pboard_t* b, int x, int y, Fruit f);
+
+/* The version that matches a flat Board, as pboardSet() does. Only
+ * rows that differ are copied, so following a game from lock to lock
+ * costs the rows that changed.
+ */
+pboard_t* pboardUpdate(pboard_t* b, const Fruit* cells);
+
+/* Write a version out as a flat Board */
+void pboardRead(const pboard_t* b, Fruit* cells);
+
+#endif
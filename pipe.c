@@ -0,0 +1,470 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "pipe.h"
+
+// --- //
+
+#define MAX_GAMES (1 << 20)
+
+// --- //
+
+/* How long the message at the front of `buf` is, if `len` bytes hold
+ * all of it. Yields 0 if more bytes are needed, -1 if it's garbage.
+ */
+long pipeLength(const unsigned char* buf, size_t len) {
+        pipe_header_t h;
+
+        if(len < sizeof(h)) {
+                return 0;
+        }
+
+        memcpy(&h, buf, sizeof(h));
+
+        if(h.length > MAX_PIPE_MESSAGE) {
+                return -1;
+        }
+
+        return len >= sizeof(h) + h.length ? (long)(sizeof(h) + h.length) : 0;
+}
+
+/* Serve commands from `in`, with replies to `out`. Neither is closed
+ * by us. Yields NULL on failure.
+ */
+pipe_t* pipeOpen(int in, int out) {
+        pipe_t* p = calloc(1, sizeof(pipe_t));
+
+        check_mem(p);
+        p->in = in;
+        p->out = out;
+        p->inSize = 2 * PIPE_READ;
+        p->inBuf = malloc(p->inSize);
+        p->outSize = PIPE_READ;
+        p->outBuf = malloc(p->outSize);
+        check_mem(p->inBuf && p->outBuf);
+
+        return p;
+ error:
+        pipeClose(p);
+        return NULL;
+}
+
+/* Make room for `n` more bytes of replies */
+void* pipeReserve(pipe_t* p, size_t n) {
+        unsigned char* grown;
+        size_t size = p->outSize;
+
+        while(size - p->outUsed < n) {
+                size *= 2;
+        }
+
+        if(size != p->outSize) {
+                grown = realloc(p->outBuf, size);
+                check_mem(grown);
+                p->outBuf = grown;
+                p->outSize = size;
+        }
+
+        return p->outBuf + p->outUsed;
+ error:
+        return NULL;
+}
+
+/* Start a reply to `cmd` with `length` bytes of payload. Yields where
+ * the payload goes, or NULL if there's no room.
+ */
+unsigned char* pipeReply(pipe_t* p, pipe_header_t* cmd, uint8_t type,
+                         size_t length) {
+        pipe_header_t h = { length, type, cmd->flags, cmd->tag };
+        unsigned char* at = pipeReserve(p, sizeof(h) + length);
+
+        if(at) {
+                memcpy(at, &h, sizeof(h));
+                p->outUsed += sizeof(h) + length;
+                at += sizeof(h);
+        }
+
+        return at;
+}
+
+/* Tell the agent why a command was refused */
+void pipeRefuse(pipe_t* p, pipe_header_t* cmd, const char* fmt, ...) {
+        char reason[256];
+        unsigned char* at;
+        va_list args;
+        int n;
+
+        va_start(args, fmt);
+        n = vsnprintf(reason, sizeof(reason), fmt, args);
+        va_end(args);
+        n = n < (int)sizeof(reason) ? n : (int)sizeof(reason) - 1;
+
+        if((at = pipeReply(p, cmd, PIPE_ERROR, n))) {
+                memcpy(at, reason, n);
+        }
+}
+
+/* Write every reply gathered so far */
+int pipeFlush(pipe_t* p) {
+        size_t done = 0;
+        ssize_t n;
+
+        while(done < p->outUsed) {
+                n = write(p->out, p->outBuf + done, p->outUsed - done);
+
+                if(n < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                check(n > 0, "Couldn't write to the agent.");
+                done += n;
+                p->writes++;
+        }
+
+        p->outUsed = 0;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Pack games `first` to `first + count` into `at`: states, then Fruits
+ * if asked for. Yields the end.
+ */
+unsigned char* pipePack(pipe_t* p, unsigned char* at, size_t first,
+                        size_t count, bool states, bool fruits) {
+        batch_t* b = p->batch;
+        pipe_state_t s;
+        int cells[8];
+        size_t i;
+        int k;
+
+        for(i = first; states && i < first + count; i++) {
+                memcpy(s.rows, b->rows + i * BOARD_HEIGHT, sizeof(s.rows));
+                s.piece = b->piece[i];
+                s.rotation = b->rotation[i];
+                s.x = b->x[i];
+                s.y = b->y[i];
+                batchCells(b, i, cells);
+
+                for(k = 0; k < 8; k++) {
+                        s.cells[k] = cells[k];
+                }
+
+                for(k = 0; k < 4; k++) {
+                        s.fruits[k] = b->pieceFruits[4*i + k];
+                }
+
+                for(k = 0; k < PREVIEW; k++) {
+                        s.next[k] = queuePeek(&b->queue[i], k).piece;
+                }
+
+                s.chain = b->chain[i];
+                s.running = b->running[i];
+                s.over = b->over[i];
+                s.tick = b->tick[i];
+                s.lines = b->lines[i];
+                s.matches = b->matches[i];
+                s.pieces = b->pieces[i];
+                memcpy(at, &s, sizeof(s));
+                at += sizeof(s);
+        }
+
+        for(i = first * BOARD_CELLS; fruits && i < (first + count) *
+                    BOARD_CELLS; i++) {
+                *at++ = b->fruits[i];
+        }
+
+        return at;
+}
+
+/* HELLO: start a fresh batch of games */
+void pipeHello(pipe_t* p, pipe_header_t* cmd, const unsigned char* body) {
+        pipe_hello_t hello;
+        pipe_welcome_t welcome;
+        unsigned char* at;
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        int workers;
+
+        if(cmd->length != sizeof(hello)) {
+                pipeRefuse(p, cmd, "HELLO of %u bytes.", cmd->length);
+                return;
+        }
+
+        memcpy(&hello, body, sizeof(hello));
+
+        if(hello.games < 1 || hello.games > MAX_GAMES) {
+                pipeRefuse(p, cmd, "Between 1 and %d games, please.",
+                           MAX_GAMES);
+                return;
+        }
+
+        workers = hello.workers ? (int)hello.workers : cores > 0 ? cores : 1;
+
+        batchDestroy(p->batch);
+        free(p->rewards);
+        free(p->totals);
+        free(p->dones);
+        p->batch = batchCreate(hello.games, hello.seed, workers);
+        p->rewards = malloc(hello.games * sizeof(float));
+        p->totals = malloc(hello.games * sizeof(float));
+        p->dones = malloc(hello.games);
+
+        if(!p->batch || !p->rewards || !p->totals || !p->dones) {
+                batchDestroy(p->batch);
+                p->batch = NULL;
+                pipeRefuse(p, cmd, "Couldn't create %u games.", hello.games);
+                return;
+        }
+
+        welcome = (pipe_welcome_t){ PIPE_VERSION, hello.games,
+                                    p->batch->workers, sizeof(pipe_state_t) };
+
+        if((at = pipeReply(p, cmd, PIPE_HELLO + 'a' - 'A', sizeof(welcome)))) {
+                memcpy(at, &welcome, sizeof(welcome));
+        }
+}
+
+/* STEP: play every game some ticks, with the Actions given */
+void pipeStep(pipe_t* p, pipe_header_t* cmd, const unsigned char* body) {
+        batch_t* b = p->batch;
+        bool states = cmd->flags & PIPE_STATE;
+        bool fruits = cmd->flags & PIPE_FRUITS;
+        bool restart = cmd->flags & PIPE_RESTART;
+        unsigned char* at;
+        uint8_t* ended;
+        uint32_t ticks = 0, t;
+        size_t i, n;
+
+        if(!b) {
+                pipeRefuse(p, cmd, "No games yet. Say HELLO.");
+                return;
+        }
+
+        n = b->count;
+
+        if(cmd->length >= sizeof(ticks)) {
+                memcpy(&ticks, body, sizeof(ticks));
+        }
+
+        if(cmd->length < sizeof(ticks) ||
+           cmd->length != sizeof(ticks) + (uint64_t)ticks * n) {
+                pipeRefuse(p, cmd, "STEP of %u bytes for %lu games.",
+                           cmd->length, (unsigned long)n);
+                return;
+        }
+
+        at = pipeReply(p, cmd, PIPE_STEP + 'a' - 'A', sizeof(ticks) +
+                       n * (sizeof(float) + 1) +
+                       (states ? n * sizeof(pipe_state_t) : 0) +
+                       (fruits ? n * BOARD_CELLS : 0));
+
+        if(!at) {
+                return;
+        }
+
+        // Whether games ended goes straight into the reply. The rewards
+        // may not be aligned there, so they're summed aside.
+        ended = at + sizeof(ticks) + n * sizeof(float) +
+                (states ? n * sizeof(pipe_state_t) : 0);
+        memset(p->totals, 0, n * sizeof(float));
+        memset(ended, 0, n);
+        body += sizeof(ticks);
+
+        for(t = 0; t < ticks; t++) {
+                batchPlay(b, body + t * n, p->rewards,
+                          restart ? p->dones : NULL);
+
+                for(i = 0; i < n; i++) {
+                        p->totals[i] += p->rewards[i];
+                        ended[i] |= restart ? p->dones[i] : b->over[i];
+                }
+        }
+
+        memcpy(at, &ticks, sizeof(ticks));
+        memcpy(at + sizeof(ticks), p->totals, n * sizeof(float));
+        pipePack(p, at + sizeof(ticks) + n * sizeof(float), 0, n, states,
+                 false);
+        pipePack(p, ended + n, 0, n, false, fruits);
+        p->steps += (unsigned long)ticks * n;
+}
+
+/* OBSERVE: the state of some games */
+void pipeObserve(pipe_t* p, pipe_header_t* cmd, const unsigned char* body) {
+        bool fruits = cmd->flags & PIPE_FRUITS;
+        unsigned char* at;
+        uint32_t range[2];
+
+        if(!p->batch) {
+                pipeRefuse(p, cmd, "No games yet. Say HELLO.");
+                return;
+        }
+
+        if(cmd->length != sizeof(range)) {
+                pipeRefuse(p, cmd, "OBSERVE of %u bytes.", cmd->length);
+                return;
+        }
+
+        memcpy(range, body, sizeof(range));
+
+        if(range[0] > p->batch->count ||
+           range[1] > p->batch->count - range[0]) {
+                pipeRefuse(p, cmd, "Games %u to %u of %lu.", range[0],
+                           range[0] + range[1], (unsigned long)p->batch->count);
+                return;
+        }
+
+        at = pipeReply(p, cmd, PIPE_OBSERVE + 'a' - 'A', sizeof(range) +
+                       range[1] * (sizeof(pipe_state_t) +
+                                   (fruits ? BOARD_CELLS : 0)));
+
+        if(at) {
+                memcpy(at, range, sizeof(range));
+                pipePack(p, at + sizeof(range), range[0], range[1], true,
+                         fruits);
+        }
+}
+
+/* RESET: start all games over, or some */
+void pipeReset(pipe_t* p, pipe_header_t* cmd, const unsigned char* body) {
+        size_t i;
+
+        if(!p->batch) {
+                pipeRefuse(p, cmd, "No games yet. Say HELLO.");
+                return;
+        }
+
+        if(cmd->length && cmd->length != p->batch->count) {
+                pipeRefuse(p, cmd, "RESET of %u bytes for %lu games.",
+                           cmd->length, (unsigned long)p->batch->count);
+                return;
+        }
+
+        for(i = 0; i < p->batch->count; i++) {
+                if(!cmd->length || body[i]) {
+                        batchReset(p->batch, i);
+                }
+        }
+
+        pipeReply(p, cmd, PIPE_RESET + 'a' - 'A', 0);
+}
+
+/* Handle one whole command. Every command gets a reply, if only to
+ * say there was no room for the real one. Yields 0 if not even that
+ * would fit.
+ */
+int pipeHandle(pipe_t* p, const unsigned char* msg) {
+        pipe_header_t h;
+        const unsigned char* body = msg + sizeof(h);
+        size_t before = p->outUsed;
+
+        memcpy(&h, msg, sizeof(h));
+        p->messages++;
+
+        switch(h.type) {
+        case PIPE_HELLO:
+                pipeHello(p, &h, body);
+                break;
+        case PIPE_STEP:
+                pipeStep(p, &h, body);
+                break;
+        case PIPE_OBSERVE:
+                pipeObserve(p, &h, body);
+                break;
+        case PIPE_RESET:
+                pipeReset(p, &h, body);
+                break;
+        case PIPE_BYE:
+                pipeReply(p, &h, PIPE_BYE + 'a' - 'A', 0);
+                p->bye = true;
+                break;
+        default:
+                pipeRefuse(p, &h, "No such command: %u.", h.type);
+                break;
+        }
+
+        if(p->outUsed == before) {
+                pipeRefuse(p, &h, "No room for the reply.");
+        }
+
+        return p->outUsed != before;
+}
+
+/* Handle commands until BYE or the end of `in`. Yields 0 if reading or
+ * writing failed, or the agent sent garbage.
+ */
+int pipeServe(pipe_t* p) {
+        unsigned char* grown;
+        size_t done;
+        ssize_t n;
+        long len = 0;
+
+        while(!p->bye) {
+                // Everything that's here already, before a single reply.
+                done = 0;
+
+                while(!p->bye &&
+                      (len = pipeLength(p->inBuf + done,
+                                        p->inUsed - done)) > 0) {
+                        check(pipeHandle(p, p->inBuf + done),
+                              "Couldn't reply to the agent.");
+                        done += len;
+                }
+
+                check(len >= 0, "Garbage from the agent.");
+                memmove(p->inBuf, p->inBuf + done, p->inUsed - done);
+                p->inUsed -= done;
+                check(pipeFlush(p), "Lost the agent.");
+
+                if(p->bye) {
+                        break;
+                }
+
+                // A message bigger than the buffer needs a bigger one.
+                if(p->inUsed >= sizeof(pipe_header_t) &&
+                   p->inSize - p->inUsed < PIPE_READ) {
+                        grown = realloc(p->inBuf, 2 * p->inSize);
+                        check_mem(grown);
+                        p->inBuf = grown;
+                        p->inSize *= 2;
+                }
+
+                n = read(p->in, p->inBuf + p->inUsed, p->inSize - p->inUsed);
+
+                if(n < 0 && errno == EINTR) {
+                        continue;
+                }
+
+                check(n >= 0, "Couldn't read from the agent.");
+                p->reads++;
+
+                if(n == 0) {
+                        check(p->inUsed == 0, "The agent hung up mid-message.");
+                        break;
+                }
+
+                p->inUsed += n;
+        }
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Deallocate, games and all */
+void pipeClose(pipe_t* p) {
+        if(p) {
+                batchDestroy(p->batch);
+                free(p->rewards);
+                free(p->totals);
+                free(p->dones);
+                free(p->inBuf);
+                free(p->outBuf);
+                free(p);
+        }
+}
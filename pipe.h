@@ -0,0 +1,142 @@
+#ifndef __pipe_h__
+#define __pipe_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "batch.h"
+
+// --- //
+
+/* The agent wire format, for programs that play from another process
+ * over a pipe or a socket. Every message is a header and `length` bytes
+ * of payload; every command gets exactly one reply, in order, typed as
+ * the command in lowercase (or PIPE_ERROR). All fields are single bytes
+ * or little-endian.
+ *
+ *   HELLO:   pipe_hello_t. Starts a fresh batch of games.
+ *            -> pipe_welcome_t
+ *   STEP:    u32 ticks, then `ticks` rows of one Action per game
+ *            (NO_ACTION for none), soonest first. Every game plays them
+ *            all, a tick apiece.
+ *            -> u32 ticks, then an f32 per game (lines and matches over
+ *               all the ticks), a pipe_state_t per game with PIPE_STATE,
+ *               a u8 per game (did it end), and with PIPE_FRUITS,
+ *               BOARD_CELLS Fruits per game, one byte each
+ *   OBSERVE: u32 first, u32 count
+ *            -> the same, then `count` pipe_state_t, and Fruits with
+ *               PIPE_FRUITS
+ *   RESET:   nothing, to start every game over, or one u8 per game
+ *            -> nothing
+ *   BYE:     nothing. The reply is the last thing sent.
+ *            -> nothing
+ */
+#define PIPE_HELLO   'H'
+#define PIPE_STEP    'S'
+#define PIPE_OBSERVE 'O'
+#define PIPE_RESET   'R'
+#define PIPE_BYE     'Q'
+#define PIPE_ERROR   'E'  // Payload is the reason, as text
+
+// Header flags
+#define PIPE_STATE   1  // STEP: reply with every game's state too
+#define PIPE_FRUITS  2  // STEP, OBSERVE: ...and every Board's Fruits
+#define PIPE_RESTART 4  // STEP: games that end start over straight away
+
+#define PIPE_VERSION     1
+#define MAX_PIPE_MESSAGE (64 << 20)  // Longer is taken to be garbage
+#define PIPE_READ        (1 << 16)   // Bytes asked of each read()
+
+typedef struct pipe_header_t {
+        uint32_t length;  // Payload bytes
+        uint8_t type;
+        uint8_t flags;
+        uint16_t tag;     // The caller's own. Copied into the reply.
+} pipe_header_t;
+
+typedef struct pipe_hello_t {
+        uint64_t seed;    // Game i is seeded with `seed + i`
+        uint32_t games;
+        uint32_t workers; // Threads to step them on. 0 for one per core.
+} pipe_hello_t;
+
+typedef struct pipe_welcome_t {
+        uint32_t version;
+        uint32_t games;
+        uint32_t workers;     // How many we actually got
+        uint32_t stateBytes;  // sizeof(pipe_state_t)
+} pipe_welcome_t;
+
+/* One game, packed. The Board is one occupancy mask per row, bottom row
+ * first, and the piece is its pose plus the cells that pose covers.
+ */
+typedef struct pipe_state_t {
+        uint16_t rows[BOARD_HEIGHT];  // Bit x: occupied
+        uint8_t piece;                // 0 to 6: L, S, Z, O, I, T, J
+        uint8_t rotation;
+        int8_t x;                     // Grid position of the piece's centre
+        int8_t y;
+        int8_t cells[8];              // ...and its cells, as x,y pairs
+        uint8_t fruits[4];            // ...and their Fruits
+        uint8_t next[PREVIEW];        // The pieces after it, soonest first
+        uint8_t chain;                // Clearing steps the last lock set off
+        uint8_t running;
+        uint8_t over;
+        uint32_t tick;
+        uint32_t lines;
+        uint32_t matches;
+        uint32_t pieces;
+} pipe_state_t;
+
+_Static_assert(sizeof(pipe_header_t) == 8, "Header must be packed.");
+_Static_assert(sizeof(pipe_hello_t) == 16, "Hello must be packed.");
+_Static_assert(sizeof(pipe_state_t) == 80, "State must be packed.");
+
+/* Serves one agent: a batch of games, driven by the commands read from
+ * `in`. Everything already read is handled before the replies go out
+ * in one write, so an agent that sends many commands at once pays for
+ * few syscalls.
+ */
+typedef struct pipe_t {
+        int in;
+        int out;
+        batch_t* batch;
+        unsigned char* inBuf;    // Commands read but not yet handled
+        size_t inSize;
+        size_t inUsed;
+        unsigned char* outBuf;   // Replies not yet written
+        size_t outSize;
+        size_t outUsed;
+        float* rewards;          // One step's, per game
+        float* totals;           // ...and one STEP's
+        uint8_t* dones;
+        bool bye;
+        // How it's going
+        unsigned long messages;
+        unsigned long steps;     // Game-steps: games times ticks
+        unsigned long reads;
+        unsigned long writes;
+} pipe_t;
+
+// --- //
+
+/* How long the message at the front of `buf` is, if `len` bytes hold
+ * all of it. Yields 0 if more bytes are needed, -1 if it's garbage.
+ */
+long pipeLength(const unsigned char* buf, size_t len);
+
+/* Serve commands from `in`, with replies to `out`. Neither is closed
+ * by us. Yields NULL on failure.
+ */
+pipe_t* pipeOpen(int in, int out);
+
+/* Handle commands until BYE or the end of `in`. Yields 0 if reading or
+ * writing failed, or the agent sent garbage.
+ */
+int pipeServe(pipe_t* p);
+
+/* Deallocate, games and all */
+void pipeClose(pipe_t* p);
+
+#endif
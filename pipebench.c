@@ -0,0 +1,294 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "pipe.h"
+#include "util.h"
+
+// --- //
+
+/* Measures the agent protocol end to end: an agent that keeps `depth`
+ * STEPs in flight, each for every game and several ticks, against a
+ * server in a child process over a socket pair, or a fetris-agent
+ * already listening with -u. Reports messages and game-steps a second.
+ */
+
+// --- //
+
+/* Send all of `len` bytes, waiting on the socket as need be */
+int sendAll(int fd, const void* buf, size_t len) {
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        size_t done = 0;
+        ssize_t n;
+
+        while(done < len) {
+                n = write(fd, (const char*)buf + done, len - done);
+
+                if(n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                        poll(&pfd, 1, -1);
+                        continue;
+                }
+
+                check(n > 0, "Couldn't write to the server.");
+                done += n;
+        }
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Wait for one whole reply, of type `type`, into `buf`. Yields its
+ * length, or -1.
+ */
+long awaitReply(int fd, unsigned char* buf, size_t size, uint8_t type) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        pipe_header_t h;
+        size_t len = 0;
+        ssize_t n;
+        long whole;
+
+        while((whole = pipeLength(buf, len)) == 0) {
+                check(len < size, "Reply too long.");
+                n = read(fd, buf + len, size - len);
+
+                if(n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                        poll(&pfd, 1, -1);
+                        continue;
+                }
+
+                check(n > 0, "The server hung up.");
+                len += n;
+        }
+
+        check(whole > 0, "Garbage from the server.");
+        memcpy(&h, buf, sizeof(h));
+        check(h.type == type, "Got '%c' for '%c': %.*s", h.type, type,
+              (int)h.length, buf + sizeof(h));
+
+        return whole;
+ error:
+        return -1;
+}
+
+/* Serve the benchmark from a child process, over our end of the pair */
+void child(int fd) {
+        pipe_t* p = pipeOpen(fd, fd);
+        int ok = p && pipeServe(p);
+
+        log_info("Server: %lu messages over %lu reads and %lu writes.",
+                 p ? p->messages : 0, p ? p->reads : 0, p ? p->writes : 0);
+        pipeClose(p);
+        logStop();
+        _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+        pipe_header_t h;
+        pipe_hello_t hello = { 1, 1000, 0 };
+        pipe_welcome_t welcome;
+        struct pollfd pfd;
+        unsigned char* msg = NULL;
+        unsigned char* buf = NULL;
+        char* where = NULL;
+        size_t msgLen, replyLen, size, used = 0, off = 0;
+        uint32_t ticks = 10;
+        unsigned long sent = 0, replies = 0, bytesIn = 0;
+        double seconds = 5, start, t = 0;
+        bool states = false;
+        pid_t pid = -1;
+        int sv[2];
+        int depth = 4, inflight = 0;
+        int fd = -1;
+        int opt;
+        ssize_t n;
+        long len;
+        size_t i;
+        rng_t r;
+
+        while((opt = getopt(argc, argv, "n:k:d:t:w:su:")) != -1) {
+                switch(opt) {
+                case 'n':
+                        hello.games = strtoul(optarg, NULL, 10);
+                        break;
+                case 'k':
+                        ticks = strtoul(optarg, NULL, 10);
+                        break;
+                case 'd':
+                        depth = atoi(optarg);
+                        break;
+                case 't':
+                        seconds = atof(optarg);
+                        break;
+                case 'w':
+                        hello.workers = atoi(optarg);
+                        break;
+                case 's':
+                        states = true;
+                        break;
+                case 'u':
+                        where = optarg;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-n games] [-k ticks] "
+                                "[-d depth] [-t seconds] [-w workers] [-s] "
+                                "[-u socket|port]\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        signal(SIGPIPE, SIG_IGN);
+
+        // Before any threads, so the child starts clean.
+        if(!where) {
+                if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+                        perror("socketpair");
+                        return EXIT_FAILURE;
+                }
+
+                pid = fork();
+
+                if(pid == 0) {
+                        close(sv[0]);
+                        logStart();
+                        child(sv[1]);
+                }
+
+                close(sv[1]);
+                fd = sv[0];
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+        }
+
+        check(logStart(), "Couldn't start logging.");
+        check(pid != -1 || where, "Couldn't fork a server.");
+
+        if(where) {
+                fd = connectTo(where);
+                check(fd >= 0, "No server at %s", where);
+        }
+
+        check(hello.games > 0 && depth > 0, "Nothing to do.");
+
+        // One STEP, sent over and over: random Actions, and some idling.
+        msgLen = sizeof(h) + sizeof(ticks) + (size_t)ticks * hello.games;
+        replyLen = sizeof(h) + sizeof(ticks) + hello.games *
+                (sizeof(float) + 1 + (states ? sizeof(pipe_state_t) : 0));
+        size = 2 * (replyLen > PIPE_READ ? replyLen : PIPE_READ);
+        msg = malloc(msgLen);
+        buf = malloc(size);
+        check_mem(msg && buf);
+
+        h = (pipe_header_t){ msgLen - sizeof(h), PIPE_STEP,
+                             PIPE_RESTART | (states ? PIPE_STATE : 0), 0 };
+        memcpy(msg, &h, sizeof(h));
+        memcpy(msg + sizeof(h), &ticks, sizeof(ticks));
+        rngSeed(&r, 1);
+
+        for(i = sizeof(h) + sizeof(ticks); i < msgLen; i++) {
+                n = rngBelow(&r, 8);
+                msg[i] = n < 5 ? n : NO_ACTION;
+        }
+
+        // Say hello, and wait for the games to exist.
+        h = (pipe_header_t){ sizeof(hello), PIPE_HELLO, 0, 0 };
+        check(sendAll(fd, &h, sizeof(h)) && sendAll(fd, &hello, sizeof(hello)),
+              "Couldn't say hello.");
+        len = awaitReply(fd, buf, size, PIPE_HELLO + 'a' - 'A');
+        check(len == sizeof(h) + sizeof(welcome), "No welcome.");
+        memcpy(&welcome, buf + sizeof(h), sizeof(welcome));
+        check(welcome.version == PIPE_VERSION, "Protocol %u, not %u.",
+              welcome.version, PIPE_VERSION);
+
+        log_info("Stepping %u games on %u workers, %u ticks a message, %d "
+                 "in flight, for %.0fs.", welcome.games, welcome.workers,
+                 ticks, depth, seconds);
+        start = now();
+        pfd.fd = fd;
+
+        // Keep `depth` STEPs in flight until time's up, then drain them.
+        while(t < seconds || inflight > 0) {
+                pfd.events = POLLIN;
+
+                if(off || (inflight < depth && t < seconds)) {
+                        pfd.events |= POLLOUT;
+                }
+
+                n = poll(&pfd, 1, -1);
+                check(n >= 0 || errno == EINTR, "Couldn't poll.");
+
+                if(pfd.revents & POLLOUT) {
+                        n = write(fd, msg + off, msgLen - off);
+                        check(n > 0 || errno == EAGAIN || errno == EINTR,
+                              "Couldn't write to the server.");
+
+                        if(n > 0 && off == 0) {
+                                inflight++;
+                        }
+
+                        off = n > 0 ? (off + n) % msgLen : off;
+                        sent += n > 0 && off == 0;
+                }
+
+                if(pfd.revents & (POLLIN | POLLHUP)) {
+                        n = read(fd, buf + used, size - used);
+                        check(n > 0 || errno == EAGAIN || errno == EINTR,
+                              "The server hung up.");
+                        used += n > 0 ? n : 0;
+                        bytesIn += n > 0 ? n : 0;
+
+                        while((len = pipeLength(buf, used)) > 0) {
+                                memcpy(&h, buf, sizeof(h));
+                                check(h.type == PIPE_STEP + 'a' - 'A' &&
+                                      (size_t)len == replyLen,
+                                      "Bad reply '%c': %.*s", h.type,
+                                      (int)h.length, buf + sizeof(h));
+                                memmove(buf, buf + len, used - len);
+                                used -= len;
+                                replies++;
+                                inflight--;
+                        }
+
+                        check(len == 0, "Garbage from the server.");
+                }
+
+                t = now() - start;
+        }
+
+        log_info("%.0f messages/s, %.2fM game-steps/s (%.0f ticks/s a game). "
+                 "%.1fMB/s out, %.1fMB/s back.", replies / t,
+                 replies * (double)ticks * welcome.games / t / 1e6,
+                 replies * (double)ticks / t, sent * msgLen / t / 1e6,
+                 bytesIn / t / 1e6);
+
+        h = (pipe_header_t){ 0, PIPE_BYE, 0, 0 };
+        check(sendAll(fd, &h, sizeof(h)), "Couldn't say goodbye.");
+        check(awaitReply(fd, buf, size, PIPE_BYE + 'a' - 'A') > 0,
+              "No goodbye.");
+
+        close(fd);
+
+        if(pid > 0) {
+                waitpid(pid, NULL, 0);
+        }
+
+        free(msg);
+        free(buf);
+        logStop();
+
+        return EXIT_SUCCESS;
+ error:
+        if(fd >= 0) { close(fd); }
+        if(pid > 0) { waitpid(pid, NULL, 0); }
+        free(msg);
+        free(buf);
+        logStop();
+        return EXIT_FAILURE;
+}
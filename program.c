@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "program.h"
+#include "util.h"
+
+// --- //
+
+#define CACHE_MAGIC   0x42505446  // "FTPB"
+#define CACHE_VERSION 1
+
+/* The shader sources, baked in at build time. See the Makefile. */
+const GLchar vertexSource[] =
+#include "vertex.glsl.h"
+;
+
+const GLchar fragmentSource[] =
+#include "fragment.glsl.h"
+;
+
+/* Sits in front of the driver's binary blob in a cache file */
+typedef struct cache_header_t {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;  // GLenum, as reported by the driver
+        uint32_t length;  // Bytes of binary that follow
+} cache_header_t;
+
+// --- //
+
+/* Where cached program binaries live. Cannot fail, but may yield "" */
+const char* cacheDir() {
+        static char dir[1024] = "";
+        const char* base = getenv("XDG_CACHE_HOME");
+        const char* home = getenv("HOME");
+
+        if(dir[0]) {
+                return dir;
+        }
+
+        if(base && base[0]) {
+                snprintf(dir, sizeof(dir), "%s/fetris", base);
+        } else if(home && home[0]) {
+                snprintf(dir, sizeof(dir), "%s/.cache", home);
+                mkdir(dir, 0755);
+                snprintf(dir, sizeof(dir), "%s/.cache/fetris", home);
+        } else {
+                return dir;
+        }
+
+        mkdir(dir, 0755);
+
+        return dir;
+}
+
+/* Identify this driver and these sources. Binaries never cross drivers */
+uint64_t cacheKey(const GLchar* vertexSrc, const GLchar* fragmentSrc) {
+        const GLubyte* vendor   = glGetString(GL_VENDOR);
+        const GLubyte* renderer = glGetString(GL_RENDERER);
+        const GLubyte* version  = glGetString(GL_VERSION);
+        uint64_t h = FNV_OFFSET;
+
+        h = fnv1a(h, vendor,   vendor   ? strlen((char*)vendor)   : 0);
+        h = fnv1a(h, renderer, renderer ? strlen((char*)renderer) : 0);
+        h = fnv1a(h, version,  version  ? strlen((char*)version)  : 0);
+        h = fnv1a(h, vertexSrc,   strlen(vertexSrc) + 1);
+        h = fnv1a(h, fragmentSrc, strlen(fragmentSrc) + 1);
+
+        return h;
+}
+
+/* Can this driver hand us program binaries at all? */
+bool binariesSupported() {
+        GLint formats = 0;
+
+        if(!GLEW_ARB_get_program_binary) {
+                return false;
+        }
+
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+        return formats > 0;
+}
+
+/* Compile one embedded shader */
+GLuint compileShader(GLenum type, const GLchar* source) {
+        GLchar log[512];
+        GLint ok;
+        GLuint shader = glCreateShader(type);
+
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+
+        if(!ok) {
+                glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+                log_err("Shader compilation failed:\n%s", log);
+                glDeleteShader(shader);
+                return 0;
+        }
+
+        return shader;
+}
+
+/* Compile and link a pair of embedded sources from scratch */
+GLuint compileProgram(const GLchar* vertexSrc, const GLchar* fragmentSrc,
+                      bool retrievable) {
+        GLchar log[512];
+        GLint ok;
+        GLuint program = 0;
+        GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSrc);
+        GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSrc);
+
+        check(vertex && fragment, "Couldn't compile shaders.");
+
+        program = glCreateProgram();
+
+        if(retrievable) {
+                glProgramParameteri(program,
+                                    GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                    GL_TRUE);
+        }
+
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+
+        if(!ok) {
+                glGetProgramInfoLog(program, sizeof(log), NULL, log);
+                log_err("Shader linking failed:\n%s", log);
+                glDeleteProgram(program);
+                program = 0;
+        }
+
+ error:
+        if(vertex)   { glDeleteShader(vertex);   }
+        if(fragment) { glDeleteShader(fragment); }
+        return program;
+}
+
+/* Try the binary cached under `path`. Yields 0 on any mismatch */
+GLuint readCache(const char* path, uint64_t key) {
+        cache_header_t header;
+        GLint ok = 0;
+        GLuint program = 0;
+        void* binary = NULL;
+        FILE* f = fopen(path, "rb");
+
+        check_debug(f, "No cached program at %s", path);
+        check_debug(fread(&header, sizeof(header), 1, f) == 1,
+                    "Truncated program cache.");
+        check_debug(header.magic == CACHE_MAGIC &&
+                    header.version == CACHE_VERSION &&
+                    header.key == key,
+                    "Stale program cache.");
+
+        binary = malloc(header.length);
+        check_mem(binary);
+        check_debug(fread(binary, 1, header.length, f) == header.length,
+                    "Truncated program cache.");
+
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, binary, header.length);
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+
+        // The driver may reject its own binaries after an update.
+        if(!ok) {
+                debug("Driver rejected cached program.");
+                glDeleteProgram(program);
+                program = 0;
+        }
+
+ error:
+        if(f) { fclose(f); }
+        free(binary);
+        return program;
+}
+
+/* Save a linked program's binary under `path` */
+void writeCache(const char* path, uint64_t key, GLuint program) {
+        cache_header_t header = { CACHE_MAGIC, CACHE_VERSION, key, 0, 0 };
+        char temp[1100];
+        GLint length = 0;
+        GLenum format;
+        void* binary = NULL;
+        FILE* f = NULL;
+
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        check(length > 0, "Driver gave no program binary.");
+
+        binary = malloc(length);
+        check_mem(binary);
+        glGetProgramBinary(program, length, NULL, &format, binary);
+
+        header.format = format;
+        header.length = length;
+
+        // Write beside the real file, so a crash never leaves half of one.
+        snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+        f = fopen(temp, "wb");
+        check(f, "Couldn't write program cache %s", temp);
+        check(fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(binary, 1, length, f) == (size_t)length,
+              "Couldn't write program cache %s", temp);
+        check(fclose(f) == 0, "Couldn't write program cache %s", temp);
+        f = NULL;
+        check(rename(temp, path) == 0, "Couldn't move program cache.");
+
+        free(binary);
+        return;
+ error:
+        if(f) { fclose(f); }
+        unlink(temp);
+        free(binary);
+}
+
+/* Build a shader program from a pair of embedded sources, as
+ * loadProgram() does for the game's own
+ */
+GLuint loadProgramFrom(const GLchar* vertexSrc, const GLchar* fragmentSrc,
+                       bool* cached) {
+        char path[1100];
+        const char* dir = cacheDir();
+        bool useCache = dir[0] && binariesSupported();
+        uint64_t key = 0;
+        GLuint program = 0;
+
+        *cached = false;
+
+        if(useCache) {
+                key = cacheKey(vertexSrc, fragmentSrc);
+                snprintf(path, sizeof(path), "%s/program-%016llx.bin",
+                         dir, (unsigned long long)key);
+                program = readCache(path, key);
+        }
+
+        if(program) {
+                *cached = true;
+                return program;
+        }
+
+        program = compileProgram(vertexSrc, fragmentSrc, useCache);
+
+        if(program && useCache) {
+                writeCache(path, key, program);
+        }
+
+        return program;
+}
+
+/* Build the game's shader program from the embedded sources.
+ * A linked binary cached by a previous run is tried first. `cached`
+ * reports whether that worked. Yields 0 on failure.
+ */
+GLuint loadProgram(bool* cached) {
+        return loadProgramFrom(vertexSource, fragmentSource, cached);
+}
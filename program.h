@@ -0,0 +1,24 @@
+#ifndef __program_h__
+#define __program_h__
+
+#include <GL/glew.h>
+#include <stdbool.h>
+
+// --- //
+
+/* Build the game's shader program from the embedded sources.
+ * A linked binary cached by a previous run is tried first. `cached`
+ * reports whether that worked. Yields 0 on failure.
+ */
+GLuint loadProgram(bool* cached);
+
+/* Build a shader program from a pair of embedded sources, as
+ * loadProgram() does for the game's own
+ */
+GLuint loadProgramFrom(const GLchar* vertexSrc, const GLchar* fragmentSrc,
+                       bool* cached);
+
+/* Where cached program binaries live. Cannot fail, but may yield "" */
+const char* cacheDir();
+
+#endif
@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "collision.h"
+#include "logger.h"
+#include "puzzle.h"
+
+// --- //
+
+#define POSE_SPAN_X (BOARD_WIDTH + 6)
+#define POSE_SPAN_Y (BOARD_HEIGHT + 6)
+
+/* Where a pose lives in a table of MAX_POSES, or -1 if off the end.
+ * Every pose that fits the Board is well inside.
+ */
+int poseIndex(int curr, int x, int y) {
+        if(x < -3 || x >= BOARD_WIDTH + 3 || y < -3 || y >= BOARD_HEIGHT + 3) {
+                return -1;
+        }
+
+        return (curr * POSE_SPAN_X + x + 3) * POSE_SPAN_Y + y + 3;
+}
+
+/* The Fruit a letter stands for, as frameDump() writes them. -1 if none */
+int fruitNamed(char c) {
+        const char* fruits = ".gabpo";
+        const char* at = c ? strchr(fruits, c) : NULL;
+
+        return at ? at - fruits : -1;
+}
+
+/* The Goal called `name`, or -1 */
+int goalNamed(const char* name) {
+        const char* names[] = { "clear", "lines", "matches", "chain" };
+        int g;
+
+        for(g = 0; g < 4; g++) {
+                if(!strcmp(name, names[g])) {
+                        return g;
+                }
+        }
+
+        return -1;
+}
+
+/* Read a piece like "T:gabp" into slot `n` */
+int parsePiece(const char* word, puzzle_t* p, int n) {
+        int k, f;
+
+        check(n < MAX_PUZZLE_PIECES, "More than %d pieces.",
+              MAX_PUZZLE_PIECES);
+        check(strlen(word) == 6 && word[1] == ':', "Bad piece: %s", word);
+        p->pieces[n] = pieceNamed(word[0]);
+        check(p->pieces[n] >= 0, "No such piece: %c", word[0]);
+
+        for(k = 0; k < 4; k++) {
+                f = fruitNamed(word[2 + k]);
+                check(f > None, "Bad Fruit in %s", word);
+                p->fruits[n][k] = f;
+        }
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Read a puzzle from `path` */
+int puzzleLoad(const char* path, puzzle_t* p) {
+        char rows[BOARD_HEIGHT][BOARD_WIDTH];
+        char line[256];
+        char* word;
+        FILE* f = fopen(path, "r");
+        bool inBoard = false, haveGoal = false;
+        int count = 0, lineNo = 0;
+        int x, y, fruit, goal;
+        size_t len;
+
+        check(f, "Couldn't open %s", path);
+        memset(p, 0, sizeof(*p));
+
+        while(fgets(line, sizeof(line), f)) {
+                lineNo++;
+                line[strcspn(line, "#\r\n")] = '\0';
+                word = strtok(line, " \t");
+
+                if(!word) {
+                        continue;
+                }
+
+                if(inBoard) {
+                        len = strlen(word);
+                        check(len == BOARD_WIDTH && !strtok(NULL, " \t"),
+                              "%s:%d: Rows are %d wide.", path, lineNo,
+                              BOARD_WIDTH);
+                        check(count < BOARD_HEIGHT, "%s:%d: Board too tall.",
+                              path, lineNo);
+                        memcpy(rows[count++], word, BOARD_WIDTH);
+                } else if(!strcmp(word, "goal")) {
+                        word = strtok(NULL, " \t");
+                        goal = word ? goalNamed(word) : -1;
+                        check(goal >= 0, "%s:%d: No such goal.", path, lineNo);
+                        p->goal = goal;
+                        haveGoal = true;
+
+                        if(p->goal != GoalClear) {
+                                word = strtok(NULL, " \t");
+                                p->target = word ? atoi(word) : 0;
+                                check(p->target > 0, "%s:%d: Goal needs a "
+                                      "target.", path, lineNo);
+                        }
+                } else if(!strcmp(word, "pieces")) {
+                        while((word = strtok(NULL, " \t"))) {
+                                check(parsePiece(word, p, p->count),
+                                      "%s:%d: Bad pieces.", path, lineNo);
+                                p->count++;
+                        }
+                } else {
+                        check(!strcmp(word, "board"), "%s:%d: Don't know "
+                              "'%s'.", path, lineNo, word);
+                        inBoard = true;
+                }
+        }
+
+        check(haveGoal, "%s: No goal.", path);
+        check(p->count > 0, "%s: No pieces.", path);
+
+        // Rows were given top first, and sit on the floor.
+        for(y = 0; y < count; y++) {
+                for(x = 0; x < BOARD_WIDTH; x++) {
+                        fruit = fruitNamed(rows[count - 1 - y][x]);
+                        check(fruit >= 0, "%s: Bad Fruit '%c'.", path,
+                              rows[count - 1 - y][x]);
+                        p->board[x + y * BOARD_WIDTH] = fruit;
+                }
+        }
+
+        fclose(f);
+
+        return 1;
+ error:
+        if(f) { fclose(f); }
+        return 0;
+}
+
+/* Every distinct place a piece can come to rest. A breadth-first walk
+ * over poses from the spawn, one Action at a time, just as gameAct()
+ * allows them. Resting poses are still walked from, since a player can
+ * slide or turn a resting Block before the next tick locks it.
+ */
+int puzzlePlacements(Fruit* board, int piece, const Fruit* fs,
+                     placement_t* out) {
+        bool seen[MAX_POSES] = { false };
+        placement_t queue[MAX_POSES];
+        Fruit spun[4][4];
+        int which[4];
+        int turned[8];
+        block_t b, copy;
+        const int8_t* kick;
+        int cells[8];
+        int head = 0, tail = 0, n = 0, shuffles = 0;
+        int i, k, s, kicks;
+
+        b = spawnBlock(piece, (Fruit*)fs);
+        blockCells(&b, cells);
+
+        if(overlapping(cells, board)) {
+                return 0;
+        }
+
+        // The Shuffles that give different Fruits, A to D.
+        for(s = 0; s < 4; s++) {
+                for(k = 0; k < 4; k++) {
+                        spun[shuffles][k] = fs[(k - s + 4) % 4];
+                }
+
+                for(i = 0; i < shuffles; i++) {
+                        if(!memcmp(spun[i], spun[shuffles], sizeof(spun[i]))) {
+                                break;
+                        }
+                }
+
+                if(i == shuffles) {
+                        which[shuffles++] = s;
+                }
+        }
+
+        seen[poseIndex(b.curr, b.x, b.y)] = true;
+        queue[tail++] = (placement_t){ b.curr, b.x, b.y, 0 };
+
+        while(head < tail) {
+                b.curr = queue[head].curr;
+                b.x = queue[head].x;
+                b.y = queue[head].y;
+                head++;
+                blockCells(&b, cells);
+
+                // Come to rest. Resting at the top ends the game.
+                if(collidingDown(cells, board) && b.y != BOARD_HEIGHT - 1) {
+                        for(s = 0; s < shuffles; s++) {
+                                out[n++] = (placement_t){ b.curr, b.x, b.y,
+                                                          which[s] };
+                        }
+                }
+
+                for(k = 0; k < 4; k++) {
+                        copy = b;
+
+                        if(k == MoveLeft && !collidingLeft(cells, board)) {
+                                copy.x -= 1;
+                        } else if(k == MoveRight &&
+                                  !collidingRight(cells, board)) {
+                                copy.x += 1;
+                        } else if(k == MoveDown &&
+                                  !collidingDown(cells, board)) {
+                                copy.y -= 1;
+                        } else if(k == Rotate && b.y < BOARD_HEIGHT - 1) {
+                                kicks = pieceKickCounts[piece][b.curr];
+
+                                for(i = 0; i < kicks; i++) {
+                                        kick = pieceKicks[piece][b.curr][i];
+                                        copy = b;
+                                        rotateBlock(&copy);
+                                        copy.x += kick[0];
+                                        copy.y += kick[1];
+                                        blockCells(&copy, turned);
+
+                                        if(!overlapping(turned, board)) {
+                                                break;
+                                        }
+                                }
+
+                                if(i == kicks) {
+                                        continue;
+                                }
+                        } else {
+                                continue;
+                        }
+
+                        i = poseIndex(copy.curr, copy.x, copy.y);
+
+                        if(i >= 0 && !seen[i]) {
+                                seen[i] = true;
+                                queue[tail++] = (placement_t){
+                                        copy.curr, copy.x, copy.y, 0 };
+                        }
+                }
+        }
+
+        return n;
+}
+
+/* Lock a placement into `board`, clearing what it sets off */
+cascade_t puzzlePlace(Fruit* board, int piece, const Fruit* fs,
+                      placement_t pl) {
+        block_t b = spawnBlock(piece, (Fruit*)fs);
+        int cells[8];
+        int i, j, n, s;
+
+        for(s = 0; s < pl.shuffles; s++) {
+                shuffleFruit(&b);
+        }
+
+        b.curr = pl.curr;
+        b.x = pl.x;
+        b.y = pl.y;
+        blockCells(&b, cells);
+
+        // As gameTick() locks: any cells still above the Board are lost.
+        for(i = 0, j = 0, n = 0; i < 8; i += 2, j++) {
+                if(cells[i+1] < BOARD_HEIGHT) {
+                        board[cells[i] + BOARD_WIDTH * cells[i+1]] = b.fs[j];
+                        cells[2*n] = cells[i];
+                        cells[2*n+1] = cells[i+1];
+                        n++;
+                }
+        }
+
+        return cascadeResolve(board, cells, n);
+}
+
+/* Describe a placement, e.g. "T turned 1, at 4,2, shuffled 1" */
+void placementPrint(FILE* out, int piece, placement_t pl) {
+        fprintf(out, "%c turned %d, at %d,%d, shuffled %d",
+                pieceNames[piece], pl.curr, pl.x, pl.y, pl.shuffles);
+}
@@ -0,0 +1,70 @@
+#ifndef __puzzle_h__
+#define __puzzle_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cascade.h"
+
+// --- //
+
+#define MAX_PUZZLE_PIECES 24
+#define MAX_POSES (MAX_ROTATIONS * (BOARD_WIDTH + 6) * (BOARD_HEIGHT + 6))
+#define MAX_PLACEMENTS (4 * MAX_POSES)  // Every pose, shuffled every way
+
+/* What solving a puzzle takes */
+typedef enum { GoalClear, GoalLines, GoalMatches, GoalChain } Goal;
+
+/* A Board to start from, the pieces to place on it, in order and with
+ * their Fruits, and what counts as solving it
+ */
+typedef struct puzzle_t {
+        Fruit board[BOARD_CELLS];
+        int count;
+        int pieces[MAX_PUZZLE_PIECES];
+        Fruit fruits[MAX_PUZZLE_PIECES][4];  // A, B, C, D, as dealt
+        Goal goal;
+        int target;  // Lines, matches or chain length. Unused by GoalClear.
+} puzzle_t;
+
+/* Where one piece came to rest, and how many Shuffles it took first */
+typedef struct placement_t {
+        int8_t curr;
+        int8_t x;
+        int8_t y;
+        int8_t shuffles;
+} placement_t;
+
+// --- //
+
+/* Read a puzzle from `path`:
+ *
+ *   # Comments and blank lines are skipped.
+ *   goal clear            (or: goal lines 2, goal matches 3, goal chain 3)
+ *   pieces T:gabp I:oooo  (a piece, then its Fruits in A, B, C, D order)
+ *   board                 (then the bottom rows, top first, as in
+ *   ..........             frameDump(): . for empty, and g, a, b, p, o
+ *   gg.ggggggg             for Grape, Apple, Banana, Pear and Orange)
+ *
+ * Yields 0 on failure.
+ */
+int puzzleLoad(const char* path, puzzle_t* p);
+
+/* Every distinct place piece `piece` with Fruits `fs` can come to rest
+ * on `board`, reached as a player would from where it spawns: moving,
+ * turning (with the same kicks) and dropping, with each Shuffle of its
+ * Fruits. Placements that would top out are left out. Yields how many
+ * went into `out`, which has room for MAX_PLACEMENTS.
+ */
+int puzzlePlacements(Fruit* board, int piece, const Fruit* fs,
+                     placement_t* out);
+
+/* Lock a placement into `board`, clearing what it sets off */
+cascade_t puzzlePlace(Fruit* board, int piece, const Fruit* fs,
+                      placement_t pl);
+
+/* Describe a placement, e.g. "T turned 1, at 4,2, shuffled 1" */
+void placementPrint(FILE* out, int piece, placement_t pl);
+
+#endif
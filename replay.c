@@ -0,0 +1,324 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "replay.h"
+#include "spool.h"
+
+// --- //
+
+/* Write raw bytes, keeping count, through the spool if there is one */
+int recorderWrite(recorder_t* r, const void* data, size_t length,
+                  bool flush) {
+        if(r->spool) {
+                spoolWrite(r->spool, r->file, data, length, flush);
+        } else {
+                check(fwrite(data, 1, length, r->file) == length &&
+                      (!flush || fflush(r->file) == 0),
+                      "Couldn't write replay.");
+        }
+
+        r->offset += length;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Remember where a keyframe is */
+int indexPush(replay_index_t** index, size_t* count, size_t* capacity,
+              uint64_t step, uint64_t offset) {
+        replay_index_t* more;
+
+        if(*count == *capacity) {
+                *capacity = *capacity ? *capacity * 2 : 64;
+                more = realloc(*index, *capacity * sizeof(replay_index_t));
+                check_mem(more);
+                *index = more;
+        }
+
+        (*index)[*count].step = step;
+        (*index)[*count].offset = offset;
+        (*count)++;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Start recording to a new file at `path` */
+recorder_t* recorderOpen(const char* path, uint32_t interval) {
+        replay_header_t header = { REPLAY_MAGIC, REPLAY_VERSION, 0,
+                                   interval, 0 };
+        recorder_t* r = calloc(1, sizeof(recorder_t));
+
+        check_mem(r);
+        check(interval > 0, "Keyframe interval must be positive.");
+
+        r->interval = interval;
+        r->file = fopen(path, "wb");
+        check(r->file, "Couldn't open %s", path);
+        check(recorderWrite(r, &header, sizeof(header), false),
+              "Couldn't start replay.");
+
+        return r;
+ error:
+        if(r && r->file) { fclose(r->file); }
+        free(r);
+        return NULL;
+}
+
+/* Begin a step. Writes a keyframe of `g` when one is due */
+int recorderBegin(recorder_t* r, game_t* g) {
+        replay_record_t record = { r->step, RECORD_KEYFRAME, 0, 0 };
+        snapshot_t snap;
+
+        if(r->step % r->interval) {
+                return 1;
+        }
+
+        snapshotTake(g, &snap);
+
+        check(indexPush(&r->index, &r->count, &r->capacity,
+                        r->step, r->offset), "Couldn't index keyframe.");
+        // Whatever crashes later, this much can be replayed.
+        check(recorderWrite(r, &record, sizeof(record), false) &&
+              recorderWrite(r, &snap, sizeof(snap), true),
+              "Couldn't write keyframe.");
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Note an Action applied during the current step */
+int recorderAction(recorder_t* r, Action a) {
+        replay_record_t record = { r->step, RECORD_ACTION, a, 0 };
+
+        return recorderWrite(r, &record, sizeof(record), false);
+}
+
+/* Finish the current step */
+void recorderEnd(recorder_t* r) {
+        r->step++;
+}
+
+/* Write the index and trailer, and deallocate */
+int recorderClose(recorder_t* r) {
+        replay_trailer_t trailer;
+        int ok = 0;
+
+        if(!r) {
+                return 1;
+        }
+
+        trailer.indexOffset = r->offset;
+        trailer.keyframes = r->count;
+        trailer.steps = r->step;
+        trailer.magic = REPLAY_MAGIC;
+        trailer.version = REPLAY_VERSION;
+
+        check(recorderWrite(r, r->index, r->count * sizeof(replay_index_t),
+                            false) &&
+              recorderWrite(r, &trailer, sizeof(trailer), false),
+              "Couldn't finish replay.");
+        ok = 1;
+
+ error:
+        if(fclose(r->file) != 0) { ok = 0; }
+        free(r->index);
+        free(r);
+        return ok;
+}
+
+/* Use the index and trailer at the end of a finished replay */
+int replayTrailer(replay_t* r) {
+        replay_trailer_t* t;
+        size_t length;
+
+        if(r->bytes < sizeof(replay_header_t) + sizeof(replay_trailer_t) ||
+           r->bytes % 8) {
+                return 0;
+        }
+
+        t = (replay_trailer_t*)(r->map + r->bytes - sizeof(*t));
+        length = t->keyframes * sizeof(replay_index_t);
+
+        if(t->magic != REPLAY_MAGIC || t->version != REPLAY_VERSION ||
+           t->indexOffset + length + sizeof(*t) != r->bytes) {
+                return 0;
+        }
+
+        r->index = malloc(length ? length : 1);
+        check_mem(r->index);
+        memcpy(r->index, r->map + t->indexOffset, length);
+        r->keyframes = t->keyframes;
+        r->steps = t->steps;
+        r->end = t->indexOffset;
+        r->finished = true;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Rebuild the index of an unfinished replay by walking its records.
+ * Stops at the first torn one.
+ */
+int replayScan(replay_t* r) {
+        size_t offset = sizeof(replay_header_t);
+        size_t capacity = 0;
+        replay_record_t* record;
+
+        while(offset + sizeof(replay_record_t) <= r->bytes) {
+                record = (replay_record_t*)(r->map + offset);
+
+                if(record->type == RECORD_KEYFRAME) {
+                        if(offset + sizeof(*record) + sizeof(snapshot_t) >
+                           r->bytes ||
+                           !snapshotValid((snapshot_t*)(record + 1))) {
+                                break;
+                        }
+
+                        check(indexPush(&r->index, &r->keyframes, &capacity,
+                                        record->step, offset),
+                              "Couldn't index keyframe.");
+                        offset += sizeof(snapshot_t);
+                } else if(record->type != RECORD_ACTION ||
+                          record->action > Restart) {
+                        break;
+                }
+
+                r->steps = record->step + 1;
+                offset += sizeof(*record);
+        }
+
+        r->end = offset;
+
+        log_info("Replay unfinished. Recovered %lu steps.",
+                 (unsigned long)r->steps);
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Map a replay, finished or not */
+replay_t* replayOpen(const char* path) {
+        replay_t* r = calloc(1, sizeof(replay_t));
+        replay_header_t* header;
+        struct stat st;
+        void* map;
+        int fd = -1;
+
+        check_mem(r);
+
+        fd = open(path, O_RDONLY);
+        check(fd >= 0, "Couldn't open %s", path);
+        check(fstat(fd, &st) == 0, "Couldn't stat %s", path);
+        check((size_t)st.st_size >= sizeof(replay_header_t),
+              "%s isn't a replay.", path);
+
+        r->bytes = st.st_size;
+        map = mmap(NULL, r->bytes, PROT_READ, MAP_SHARED, fd, 0);
+        check(map != MAP_FAILED, "Couldn't map %s", path);
+        r->map = map;
+        close(fd);
+        fd = -1;
+
+        header = (replay_header_t*)r->map;
+        check(header->magic == REPLAY_MAGIC &&
+              header->version == REPLAY_VERSION &&
+              header->interval > 0,
+              "%s isn't a replay.", path);
+        r->interval = header->interval;
+
+        if(!replayTrailer(r)) {
+                check(replayScan(r), "Couldn't read %s", path);
+        }
+
+        check(r->keyframes > 0, "%s has no keyframes.", path);
+
+        return r;
+ error:
+        if(fd >= 0) { close(fd); }
+        replayClose(r);
+        return NULL;
+}
+
+/* The last keyframe at or before `step` */
+replay_index_t* replayKeyframe(replay_t* r, uint64_t step) {
+        size_t lo = 0;
+        size_t hi = r->keyframes;
+        size_t mid;
+
+        while(hi - lo > 1) {
+                mid = lo + (hi - lo) / 2;
+
+                if(r->index[mid].step <= step) {
+                        lo = mid;
+                } else {
+                        hi = mid;
+                }
+        }
+
+        return r->index[lo].step <= step ? &r->index[lo] : NULL;
+}
+
+/* Put `g` in the state it had at the start of `step`. Never simulates
+ * more than one keyframe interval.
+ */
+int replaySeek(replay_t* r, game_t* g, uint64_t step) {
+        replay_index_t* key = replayKeyframe(r, step);
+        replay_record_t* record;
+        size_t offset;
+        uint64_t curr;
+
+        check(step <= r->steps, "Replay only has %lu steps.",
+              (unsigned long)r->steps);
+        check(key, "No keyframe before step %lu.", (unsigned long)step);
+
+        offset = key->offset + sizeof(replay_record_t);
+        check(snapshotRestore(g, (snapshot_t*)(r->map + offset)),
+              "Bad keyframe at step %lu.", (unsigned long)key->step);
+        offset += sizeof(snapshot_t);
+
+        for(curr = key->step; curr < step; curr++) {
+                while(offset < r->end) {
+                        record = (replay_record_t*)(r->map + offset);
+
+                        if(record->step > curr) {
+                                break;
+                        }
+
+                        offset += sizeof(*record);
+
+                        if(record->type == RECORD_KEYFRAME) {
+                                offset += sizeof(snapshot_t);
+                        } else {
+                                gameAct(g, record->action);
+                        }
+                }
+
+                gameTick(g);
+        }
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Unmap a replay */
+void replayClose(replay_t* r) {
+        if(r) {
+                if(r->map) {
+                        munmap(r->map, r->bytes);
+                }
+                free(r->index);
+                free(r);
+        }
+}
@@ -0,0 +1,111 @@
+#ifndef __replay_h__
+#define __replay_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "snapshot.h"
+
+// --- //
+
+#define REPLAY_MAGIC    0x4c505246  // "FRPL"
+#define REPLAY_VERSION  3
+#define REPLAY_INTERVAL 600  // Steps between keyframes. Ten seconds.
+
+#define RECORD_KEYFRAME 'K'  // A snapshot_t follows
+#define RECORD_ACTION   'A'
+
+/* A replay is a header, then records in step order, then an index of
+ * keyframes and a trailer. A step is one turn of the sim loop: its
+ * Actions, in order, then one gameTick(). A keyframe holds the game as
+ * it stood before its step's Actions.
+ *
+ * Recording that never finished has no index or trailer. Readers then
+ * rebuild the index from the records themselves.
+ */
+typedef struct replay_header_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t interval;  // Steps between keyframes
+        uint32_t reserved2;
+} replay_header_t;
+
+typedef struct replay_record_t {
+        uint32_t step;
+        uint8_t type;
+        uint8_t action;     // For RECORD_ACTION
+        uint16_t reserved;
+} replay_record_t;
+
+typedef struct replay_index_t {
+        uint64_t step;
+        uint64_t offset;    // Of the keyframe's record
+} replay_index_t;
+
+typedef struct replay_trailer_t {
+        uint64_t indexOffset;
+        uint64_t keyframes;
+        uint64_t steps;     // Recorded in total
+        uint32_t magic;
+        uint32_t version;
+} replay_trailer_t;
+
+struct spool_t;
+
+/* Writes a replay as the game is played */
+typedef struct recorder_t {
+        FILE* file;
+        struct spool_t* spool;  // Optional. Does the writing if set.
+        uint64_t offset;    // Bytes written so far
+        uint32_t interval;
+        uint32_t step;      // The step being recorded
+        replay_index_t* index;
+        size_t count;
+        size_t capacity;
+} recorder_t;
+
+/* A read-only, mmap'd replay */
+typedef struct replay_t {
+        unsigned char* map;
+        size_t bytes;
+        size_t end;             // Where the records stop
+        uint32_t interval;
+        replay_index_t* index;  // Always our own copy
+        size_t keyframes;
+        uint64_t steps;
+        bool finished;          // Had a trailer
+} replay_t;
+
+// --- //
+
+/* Start recording to a new file at `path` */
+recorder_t* recorderOpen(const char* path, uint32_t interval);
+
+/* Begin a step. Writes a keyframe of `g` when one is due */
+int recorderBegin(recorder_t* r, game_t* g);
+
+/* Note an Action applied during the current step */
+int recorderAction(recorder_t* r, Action a);
+
+/* Finish the current step */
+void recorderEnd(recorder_t* r);
+
+/* Write the index and trailer, and deallocate */
+int recorderClose(recorder_t* r);
+
+/* Map a replay, finished or not */
+replay_t* replayOpen(const char* path);
+
+/* Put `g` in the state it had at the start of `step`. Never simulates
+ * more than one keyframe interval.
+ */
+int replaySeek(replay_t* r, game_t* g, uint64_t step);
+
+/* Unmap a replay */
+void replayClose(replay_t* r);
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "ring.h"
+
+// --- //
+
+/* Create a ring of at least `capacity` items of `size` bytes */
+ring_t* ringCreate(size_t size, size_t capacity) {
+        ring_t* r = aligned_alloc(64, sizeof(ring_t));
+        size_t c = 1;
+
+        check_mem(r);
+
+        while(c < capacity) {
+                c <<= 1;
+        }
+
+        atomic_init(&r->head, 0);
+        atomic_init(&r->tail, 0);
+        r->size = size;
+        r->capacity = c;
+        r->items = malloc(size * c);
+        check_mem(r->items);
+
+        return r;
+ error:
+        free(r);
+        return NULL;
+}
+
+/* Queue a copy of `item`. Fails when the ring is full */
+bool ringPush(ring_t* r, const void* item) {
+        size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+        if(head - tail == r->capacity) {
+                return false;
+        }
+
+        memcpy(r->items + (head & (r->capacity - 1)) * r->size, item, r->size);
+        atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+        return true;
+}
+
+/* Dequeue the oldest item into `item`, or discard it if `item` is
+ * NULL. Fails when the ring is empty.
+ */
+bool ringPop(ring_t* r, void* item) {
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+        if(head == tail) {
+                return false;
+        }
+
+        if(item) {
+                memcpy(item, r->items + (tail & (r->capacity - 1)) * r->size,
+                       r->size);
+        }
+
+        atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+
+        return true;
+}
+
+/* The oldest item, left in place. NULL when the ring is empty. Only
+ * the consumer may peek.
+ */
+const void* ringPeek(ring_t* r) {
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+        if(head == tail) {
+                return NULL;
+        }
+
+        return r->items + (tail & (r->capacity - 1)) * r->size;
+}
+
+/* Is there nothing to pop? */
+bool ringEmpty(ring_t* r) {
+        return atomic_load_explicit(&r->head, memory_order_acquire) ==
+                atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+/* Deallocate a ring */
+void ringDestroy(ring_t* r) {
+        if(r) {
+                free(r->items);
+                free(r);
+        }
+}
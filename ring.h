@@ -0,0 +1,43 @@
+#ifndef __ring_h__
+#define __ring_h__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// --- //
+
+/* A lock-free queue of fixed-size items between exactly one producer
+ * and one consumer. Pushing to a full ring fails rather than waits.
+ */
+typedef struct ring_t {
+        _Alignas(64) atomic_size_t head;  // Next slot to write
+        _Alignas(64) atomic_size_t tail;  // Next slot to read
+        size_t size;      // Bytes per item
+        size_t capacity;  // Always a power of two
+        unsigned char* items;
+} ring_t;
+
+/* Create a ring of at least `capacity` items of `size` bytes */
+ring_t* ringCreate(size_t size, size_t capacity);
+
+/* Queue a copy of `item`. Fails when the ring is full */
+bool ringPush(ring_t* r, const void* item);
+
+/* Dequeue the oldest item into `item`, or discard it if `item` is
+ * NULL. Fails when the ring is empty.
+ */
+bool ringPop(ring_t* r, void* item);
+
+/* The oldest item, left in place. NULL when the ring is empty. Only
+ * the consumer may peek.
+ */
+const void* ringPeek(ring_t* r);
+
+/* Is there nothing to pop? */
+bool ringEmpty(ring_t* r);
+
+/* Deallocate a ring */
+void ringDestroy(ring_t* r);
+
+#endif
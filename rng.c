@@ -0,0 +1,24 @@
+#include "rng.h"
+
+// --- //
+
+/* Start a generator from a seed. Any seed is fine, including 0 */
+void rngSeed(rng_t* r, uint64_t seed) {
+        r->state = seed;
+}
+
+/* The next 64 random bits */
+uint64_t rngNext(rng_t* r) {
+        uint64_t z = (r->state += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+        return z ^ (z >> 31);
+}
+
+/* A random integer in [0, n) */
+int rngBelow(rng_t* r, int n) {
+        // The high bits are the good ones, and this avoids modulo bias.
+        return (int)(((rngNext(r) >> 32) * (uint64_t)n) >> 32);
+}
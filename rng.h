@@ -0,0 +1,26 @@
+#ifndef __rng_h__
+#define __rng_h__
+
+#include <stdint.h>
+
+// --- //
+
+/* A small, fast, seedable random number generator (SplitMix64).
+ * Its whole state is one integer, so games can be saved and replayed.
+ */
+typedef struct rng_t {
+        uint64_t state;
+} rng_t;
+
+// --- //
+
+/* Start a generator from a seed. Any seed is fine, including 0 */
+void rngSeed(rng_t* r, uint64_t seed);
+
+/* The next 64 random bits */
+uint64_t rngNext(rng_t* r);
+
+/* A random integer in [0, n) */
+int rngBelow(rng_t* r, int n);
+
+#endif
@@ -0,0 +1,254 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "rollback.h"
+
+// --- //
+
+#define NO_TICK ULONG_MAX
+
+// --- //
+
+/* Play player `local` in the match from `seed`, with our input held
+ * back by `delay` ticks
+ */
+rollback_t* rollbackCreate(uint64_t seed, int local, int delay) {
+        rollback_t* r = NULL;
+
+        check(local >= 0 && local < PLAYERS, "No player %d.", local);
+        check(delay >= 0 && delay <= MAX_DELAY, "Delay of %d ticks.", delay);
+
+        // The first `delay` ticks' inputs are nothing.
+        r = calloc(1, sizeof(rollback_t));
+        check_mem(r);
+        matchStart(&r->match, seed);
+        r->seed = seed;
+        r->local = local;
+        r->delay = delay;
+        r->wrong = NO_TICK;
+
+        return r;
+ error:
+        free(r);
+        return NULL;
+}
+
+/* Our player pressed a key. Goes into our next input */
+void rollbackPress(rollback_t* r, Action a) {
+        if(a < 8 && (MATCH_MOVES & (1 << a))) {
+                r->pressing |= 1 << a;
+        }
+}
+
+/* A guess about the peer was wrong: go back to the first tick it was
+ * wrong for, and play forward again with what we know now
+ */
+void rollbackRewind(rollback_t* r) {
+        unsigned long t;
+
+        if(r->wrong >= r->tick) {
+                return;
+        }
+
+        r->match = r->saved[r->wrong % ROLLBACK_TICKS];
+
+        for(t = r->wrong; t < r->tick; t++) {
+                r->saved[t % ROLLBACK_TICKS] = r->match;
+                matchStep(&r->match, r->inputs[t % ROLLBACK_TICKS]);
+        }
+
+        r->rollbacks++;
+        r->resimulated += r->tick - r->wrong;
+        r->deepest = r->tick - r->wrong > r->deepest ?
+                r->tick - r->wrong : r->deepest;
+        r->wrong = NO_TICK;
+}
+
+/* Checksum every checkpoint that can no longer change: every input
+ * before it is known, and it's been played
+ */
+void rollbackSettle(rollback_t* r) {
+        unsigned long last = r->known < r->tick ? r->known : r->tick;
+        match_t* m;
+
+        while(r->settled + SYNC_PERIOD <= last) {
+                r->settled += SYNC_PERIOD;
+                m = r->settled == r->tick ? &r->match :
+                        &r->saved[r->settled % ROLLBACK_TICKS];
+                r->syncs[(r->settled / SYNC_PERIOD) % SYNC_KEEP] =
+                        (sync_t){ r->settled, matchSync(m) };
+        }
+}
+
+/* Play the next tick, after going back over any that were played on a
+ * wrong guess. Yields false if the match is over, or if we're too far
+ * ahead of the peer and have to wait for it.
+ */
+bool rollbackAdvance(rollback_t* r) {
+        uint8_t* inputs;
+
+        rollbackRewind(r);
+
+        if(r->match.over) {
+                return false;
+        }
+
+        // Past this, the ticks we'd have to go back over aren't kept.
+        if(r->tick >= r->known + ROLLBACK_WINDOW) {
+                r->stalls++;
+                return false;
+        }
+
+        // What we pressed is decided for a tick a little way off...
+        r->inputs[(r->tick + r->delay) % ROLLBACK_TICKS][r->local] =
+                r->pressing;
+        r->pressing = 0;
+
+        // ...and what the peer did this tick is guessed, if need be.
+        inputs = r->inputs[r->tick % ROLLBACK_TICKS];
+
+        if(r->tick >= r->known) {
+                inputs[!r->local] = 0;
+        }
+
+        r->saved[r->tick % ROLLBACK_TICKS] = r->match;
+        matchStep(&r->match, inputs);
+        r->tick++;
+        rollbackSettle(r);
+
+        return true;
+}
+
+/* How many ticks our clock runs ahead of the peer's. Whoever starts
+ * first, or runs fast, sees the other's input late, and so guesses
+ * wrong more often. They should give up a tick now and then.
+ */
+long rollbackAhead(rollback_t* r) {
+        // Latency adds to both leads alike, so it cancels out.
+        return (r->lead - r->theirLead) / 2;
+}
+
+/* Is the match over, with nothing the peer could still send to change
+ * that?
+ */
+bool rollbackOver(rollback_t* r) {
+        return r->match.over && r->wrong == NO_TICK &&
+                r->known >= r->match.tick;
+}
+
+/* What to send the peer now. Yields its length in bytes */
+size_t rollbackPacket(rollback_t* r, packet_t* p) {
+        unsigned long t;
+        sync_t* s = &r->syncs[(r->settled / SYNC_PERIOD) % SYNC_KEEP];
+        int n = 0;
+
+        p->seed = r->seed;
+        p->magic = ROLLBACK_MAGIC;
+        p->first = r->acked;
+        p->ack = r->known;
+        p->tick = r->tick;
+        p->lead = r->lead;
+        p->syncTick = r->settled;
+        p->sync = s->tick == r->settled ? s->sync : 0;
+
+        // Everything we've decided that they don't have yet.
+        for(t = r->acked; t < r->tick + r->delay && n < ROLLBACK_TICKS; t++) {
+                p->inputs[n++] = r->inputs[t % ROLLBACK_TICKS][r->local];
+        }
+
+        p->count = n;
+
+        return offsetof(packet_t, inputs) + n;
+}
+
+/* Read and check a datagram from the peer into `p`. Yields 0 if it
+ * isn't one of ours.
+ */
+int packetRead(const void* buf, size_t len, packet_t* p) {
+        check(len >= offsetof(packet_t, inputs) && len <= sizeof(packet_t),
+              "Datagram of %lu bytes.", (unsigned long)len);
+        memcpy(p, buf, len);
+        check(p->magic == ROLLBACK_MAGIC &&
+              offsetof(packet_t, inputs) + p->count == len,
+              "Not a versus packet.");
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Take in a datagram from the peer. Yields 0 if it isn't from our
+ * match.
+ */
+int rollbackReceive(rollback_t* r, const void* buf, size_t len) {
+        packet_t p;
+        unsigned long t;
+        sync_t* s;
+        uint8_t* theirs;
+        uint8_t input;
+        int i;
+
+        check(packetRead(buf, len, &p), "Bad packet from the peer.");
+        check(p.seed == r->seed, "Packet from another match.");
+
+        // Inputs come in order and are resent until we ack them, so the
+        // only one of any use is the next we need. Too far ahead, and
+        // its place in the ring is still taken.
+        for(i = 0; i < p.count; i++) {
+                t = p.first + i;
+                input = p.inputs[i] & MATCH_MOVES;
+
+                if(t != r->known ||
+                   t >= r->tick + ROLLBACK_TICKS - ROLLBACK_WINDOW) {
+                        continue;
+                }
+
+                // Already played on a guess. Was it right?
+                theirs = &r->inputs[t % ROLLBACK_TICKS][!r->local];
+
+                if(t < r->tick && *theirs != input && t < r->wrong) {
+                        r->wrong = t;
+                }
+
+                *theirs = input;
+                r->known++;
+        }
+
+        if(p.ack > r->acked) {
+                r->acked = p.ack < r->tick + r->delay ?
+                        p.ack : r->tick + r->delay;
+        }
+
+        // Only the latest word on whose clock is ahead counts.
+        if(p.tick > r->heard || !r->heard) {
+                r->heard = p.tick;
+                r->lead = (long)r->tick - (long)p.tick;
+                r->theirLead = p.lead;
+        }
+
+        // Compare a checkpoint of theirs with ours, if we still have it.
+        s = &r->syncs[(p.syncTick / SYNC_PERIOD) % SYNC_KEEP];
+
+        if(p.syncTick > r->checked && s->tick == p.syncTick) {
+                r->checked = p.syncTick;
+
+                if(s->sync != p.sync) {
+                        r->desyncs++;
+                        log_err("Out of sync with the peer at tick %lu.",
+                                r->checked);
+                }
+        }
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Deallocate */
+void rollbackDestroy(rollback_t* r) {
+        if(r) {
+                free(r);
+        }
+}
@@ -0,0 +1,122 @@
+#ifndef __rollback_h__
+#define __rollback_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "match.h"
+
+// --- //
+
+#define ROLLBACK_MAGIC  0x53524556  // "VERS"
+#define ROLLBACK_TICKS  128  // Ticks of inputs and saved matches kept
+#define ROLLBACK_WINDOW 32   // Most ticks we run past the peer's input
+#define MAX_DELAY       15   // Most ticks our own input may be held back
+#define SYNC_PERIOD     60   // Ticks between desync checks
+#define SYNC_KEEP       4    // ...and how many of ours to compare against
+
+/* What each peer sends the other every tick: its inputs from the first
+ * one we haven't acknowledged. Lost datagrams cost nothing but a little
+ * latency, since everything is resent until it's acknowledged. Fields
+ * are little-endian.
+ */
+typedef struct packet_t {
+        uint64_t seed;      // Which match this is
+        uint32_t magic;
+        uint32_t first;     // Tick of inputs[0]
+        uint32_t ack;       // Sender has all our inputs before this tick
+        uint32_t tick;      // Sender's next tick to play
+        uint32_t syncTick;  // Sender's latest settled checkpoint
+        uint32_t sync;      // ...and matchSync() at its start
+        int16_t lead;       // How far ahead of us the sender seems
+        uint16_t count;     // Inputs that follow
+        uint8_t inputs[ROLLBACK_TICKS];
+} packet_t;
+
+/* A settled checkpoint of ours */
+typedef struct sync_t {
+        unsigned long tick;
+        uint32_t sync;
+} sync_t;
+
+/* One side of a match played over the network. Both sides run the
+ * whole match in lockstep. When the peer's input for a tick hasn't
+ * arrived we guess it and carry on; if the guess turns out wrong, we go
+ * back to the saved match from that tick and play forward again, all
+ * before the next tick is drawn.
+ *
+ * Actions are presses, not keys held down, so the guess is always that
+ * the peer did nothing: it's right for almost every tick.
+ */
+typedef struct rollback_t {
+        match_t match;                    // As of the start of `tick`
+        match_t saved[ROLLBACK_TICKS];    // Each tick's match, at its start
+        uint8_t inputs[ROLLBACK_TICKS][PLAYERS]; // Some of the peer's guessed
+        uint64_t seed;
+        int local;              // Which player is ours
+        int delay;              // Ticks our input waits, to hide latency
+        uint8_t pressing;       // Our Actions for the next input
+        unsigned long tick;     // Next to simulate
+        unsigned long known;    // The peer's inputs before this are known
+        unsigned long acked;    // The peer has our inputs before this
+        unsigned long wrong;    // First tick played on a wrong guess
+        unsigned long settled;  // Latest checkpoint that can't change
+        unsigned long checked;  // Latest of the peer's checkpoints compared
+        sync_t syncs[SYNC_KEEP];
+        unsigned long heard;    // The peer's tick in its latest packet
+        long lead;              // How far ahead of the peer we seem
+        long theirLead;         // ...and it of us. Both count the latency
+        unsigned long yields;   // Ticks given up to let the peer catch up
+        // How it's going
+        unsigned long rollbacks;
+        unsigned long resimulated;  // Ticks played again
+        unsigned long deepest;      // Most ticks one rollback went back
+        unsigned long stalls;       // Ticks held up, too far ahead
+        unsigned long desyncs;
+} rollback_t;
+
+// --- //
+
+/* Play player `local` in the match from `seed`, with our input held
+ * back by `delay` ticks
+ */
+rollback_t* rollbackCreate(uint64_t seed, int local, int delay);
+
+/* Our player pressed a key. Goes into our next input */
+void rollbackPress(rollback_t* r, Action a);
+
+/* Play the next tick, after going back over any that were played on a
+ * wrong guess. Yields false if the match is over, or if we're too far
+ * ahead of the peer and have to wait for it.
+ */
+bool rollbackAdvance(rollback_t* r);
+
+/* How many ticks our clock runs ahead of the peer's. Whoever starts
+ * first, or runs fast, sees the other's input late, and so guesses
+ * wrong more often. They should give up a tick now and then.
+ */
+long rollbackAhead(rollback_t* r);
+
+/* Is the match over, with nothing the peer could still send to change
+ * that?
+ */
+bool rollbackOver(rollback_t* r);
+
+/* What to send the peer now. Yields its length in bytes */
+size_t rollbackPacket(rollback_t* r, packet_t* p);
+
+/* Read and check a datagram from the peer into `p`. Yields 0 if it
+ * isn't one of ours.
+ */
+int packetRead(const void* buf, size_t len, packet_t* p);
+
+/* Take in a datagram from the peer. Yields 0 if it isn't from our
+ * match.
+ */
+int rollbackReceive(rollback_t* r, const void* buf, size_t len);
+
+/* Deallocate */
+void rollbackDestroy(rollback_t* r);
+
+#endif
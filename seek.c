@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "logger.h"
+#include "replay.h"
+#include "util.h"
+
+// --- //
+
+/* Inspect a replay. Prints the game as it stood at each step named on
+ * the command line, or just the replay's outline with none. Steps may
+ * come in any order; each seek starts from the nearest keyframe.
+ */
+
+/* Print the game at the start of a step */
+int dumpStep(replay_t* r, game_t* g, uint64_t step) {
+        frame_t f;
+        double t = now();
+
+        check(replaySeek(r, g, step), "Couldn't seek to step %lu.",
+              (unsigned long)step);
+        t = now() - t;
+
+        gameFrame(g, &f);
+        printf("step %lu: lines %lu, matches %lu, pieces %lu "
+               "(%.2fms)\n", (unsigned long)step, g->lines, g->matches,
+               g->pieces, 1000 * t);
+        frameDump(stdout, &f);
+
+        return 1;
+ error:
+        return 0;
+}
+
+int main(int argc, char** argv) {
+        replay_t* r = NULL;
+        game_t* g = NULL;
+        bool failed = false;
+        int i;
+
+        if(argc < 2) {
+                fprintf(stderr, "Usage: %s replay [step ...]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        r = replayOpen(argv[1]);
+        check(r, "Couldn't open replay.");
+        g = gameCreate(0);
+        check(g, "Couldn't create a game.");
+
+        printf("%s: %lu steps (%.1fs), %lu keyframes every %u steps%s\n",
+               argv[1], (unsigned long)r->steps,
+               (double)r->steps / TICK_RATE, (unsigned long)r->keyframes,
+               r->interval, r->finished ? "" : ", unfinished");
+
+        for(i = 2; i < argc; i++) {
+                failed |= !dumpStep(r, g, strtoull(argv[i], NULL, 10));
+        }
+
+        gameDestroy(g);
+        replayClose(r);
+
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+ error:
+        gameDestroy(g);
+        replayClose(r);
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,364 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "metrics.h"
+#include "server.h"
+#include "util.h"
+
+// --- //
+
+#define BACKLOG 4096
+#define EVENTS  256
+
+/* Open a non-blocking listening socket */
+int listenAt(server_t* s, const char* where) {
+        struct sockaddr_un un = { .sun_family = AF_UNIX };
+        struct sockaddr_in in = { .sin_family = AF_INET };
+        int one = 1;
+        int fd = -1;
+
+        if(isPort(where)) {
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                check(fd >= 0, "Couldn't create socket.");
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                in.sin_port = htons(atoi(where));
+                in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                check(bind(fd, (struct sockaddr*)&in, sizeof(in)) == 0,
+                      "Couldn't bind to port %s.", where);
+        } else {
+                check(strlen(where) < sizeof(un.sun_path), "Path too long.");
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                check(fd >= 0, "Couldn't create socket.");
+                strcpy(un.sun_path, where);
+                unlink(where);  // Left over from a crash, most likely.
+                check(bind(fd, (struct sockaddr*)&un, sizeof(un)) == 0,
+                      "Couldn't bind to %s.", where);
+                strcpy(s->path, where);
+        }
+
+        check(listen(fd, BACKLOG) == 0, "Couldn't listen.");
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        return fd;
+ error:
+        if(fd >= 0) { close(fd); }
+        return -1;
+}
+
+/* Send what we can right now, and keep the rest for later.
+ * Yields 0 if the spectator is gone.
+ */
+int clientSend(client_t* c, unsigned char* msg, size_t len) {
+        ssize_t n = send(c->fd, msg, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                return 0;
+        }
+
+        n = n < 0 ? 0 : n;
+        memcpy(c->out, msg + n, len - n);
+        c->pending = len - n;
+
+        return 1;
+}
+
+/* Mark a spectator as gone. It's freed once the current batch is done */
+void clientKill(client_t* c) {
+        if(!c->dead) {
+                c->dead = true;
+                close(c->fd);
+        }
+}
+
+/* Bring a spectator up to date with everything at once */
+void clientResync(server_t* s, client_t* c) {
+        unsigned char msg[MAX_MESSAGE];
+
+        c->needFull = false;
+
+        if(!clientSend(c, msg, streamFull(&s->last, msg))) {
+                clientKill(c);
+        }
+}
+
+/* Push out whatever a spectator couldn't take before */
+void clientFlush(server_t* s, client_t* c) {
+        ssize_t n;
+
+        if(c->pending > 0) {
+                n = send(c->fd, c->out, c->pending,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+
+                if(n < 0) {
+                        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                                clientKill(c);
+                        }
+                        return;
+                }
+
+                memmove(c->out, c->out + n, c->pending - n);
+                c->pending -= n;
+        }
+
+        // Drained at last. It missed Frames, so start it over.
+        if(c->pending == 0 && c->needFull && s->haveLast) {
+                clientResync(s, c);
+        }
+}
+
+/* Spectators only ever talk to hang up. Drain and check for that */
+void clientRead(client_t* c) {
+        unsigned char junk[256];
+        ssize_t n;
+
+        while((n = read(c->fd, junk, sizeof(junk))) > 0);
+
+        if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                clientKill(c);
+        }
+}
+
+/* Take on everyone waiting to connect */
+void acceptAll(server_t* s) {
+        struct epoll_event ev;
+        client_t** more;
+        client_t* c = NULL;
+        int one = 1;
+        int fd;
+
+        while((fd = accept(s->listenFd, NULL, NULL)) >= 0) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                if(s->count == s->capacity) {
+                        more = realloc(s->clients, (s->capacity ?
+                                       s->capacity * 2 : 64) *
+                                       sizeof(client_t*));
+                        check_mem(more);
+                        s->clients = more;
+                        s->capacity = s->capacity ? s->capacity * 2 : 64;
+                }
+
+                c = calloc(1, sizeof(client_t));
+                check_mem(c);
+                c->fd = fd;
+                c->needFull = true;
+
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.ptr = c;
+                check(epoll_ctl(s->epollFd, EPOLL_CTL_ADD, fd, &ev) == 0,
+                      "Couldn't watch spectator.");
+
+                s->clients[s->count++] = c;
+                c = NULL;
+                debug("Spectator joined. %d watching.", s->count);
+        }
+
+        return;
+ error:
+        if(fd >= 0) { close(fd); }
+        free(c);
+}
+
+/* Free every spectator that hung up */
+void reap(server_t* s) {
+        int i;
+
+        for(i = s->count - 1; i >= 0; i--) {
+                if(s->clients[i]->dead) {
+                        free(s->clients[i]);
+                        s->clients[i] = s->clients[--s->count];
+                        debug("Spectator left. %d watching.", s->count);
+                }
+        }
+}
+
+/* Send a Frame to everyone. The DIFF is encoded once and shared */
+void broadcast(server_t* s, frame_t* f) {
+        unsigned char diff[MAX_MESSAGE];
+        size_t len = 0;
+        client_t* c;
+        int i;
+
+        if(s->haveLast) {
+                len = streamDiff(&s->last, f, diff);
+        }
+
+        s->last = *f;
+        s->haveLast = true;
+
+        for(i = 0; i < s->count; i++) {
+                c = s->clients[i];
+
+                if(c->dead) {
+                        continue;
+                } else if(c->pending > 0) {
+                        // Still chewing on an old Frame. Skip this one.
+                        c->needFull = true;
+                        s->dropped++;
+                } else if(c->needFull || len == 0) {
+                        clientResync(s, c);
+                } else if(!clientSend(c, diff, len)) {
+                        clientKill(c);
+                }
+        }
+}
+
+/* The server thread */
+void* serverLoop(void* arg) {
+        server_t* s = arg;
+        struct epoll_event events[EVENTS];
+        uint64_t pokes;
+        frame_t* f;
+        client_t* c;
+        bool fresh;
+        int i,n;
+
+        while(!atomic_load(&s->quit)) {
+                n = epoll_wait(s->epollFd, events, EVENTS, -1);
+
+                for(i = 0; i < n; i++) {
+                        if(events[i].data.ptr == &s->listenFd) {
+                                acceptAll(s);
+                        } else if(events[i].data.ptr == &s->wakeFd) {
+                                while(read(s->wakeFd, &pokes, sizeof(pokes)) > 0);
+                                f = tripleFront(s->frames, &fresh);
+
+                                if(fresh) {
+                                        broadcast(s, f);
+                                }
+                        } else {
+                                c = events[i].data.ptr;
+
+                                if(c->dead) {
+                                        continue;
+                                } else if(events[i].events &
+                                          (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                                        clientKill(c);
+                                        continue;
+                                }
+
+                                if(events[i].events & EPOLLIN) {
+                                        clientRead(c);
+                                }
+
+                                if(!c->dead && (events[i].events & EPOLLOUT)) {
+                                        clientFlush(s, c);
+                                }
+                        }
+                }
+
+                reap(s);
+        }
+
+        metricsLeave();
+        logLeave();
+
+        return NULL;
+}
+
+/* Listen at `where`, either a filesystem path for a Unix socket or a
+ * port number on 127.0.0.1, and start serving on a new thread.
+ */
+server_t* serverStart(const char* where) {
+        struct epoll_event ev = { .events = EPOLLIN };
+        server_t* s = calloc(1, sizeof(server_t));
+        check_mem(s);
+
+        s->listenFd = -1;
+        s->epollFd = -1;
+        s->wakeFd = -1;
+        atomic_init(&s->quit, false);
+
+        s->frames = tripleCreate(sizeof(frame_t));
+        check(s->frames, "Couldn't create server queue.");
+        s->listenFd = listenAt(s, where);
+        check(s->listenFd >= 0, "Couldn't listen at %s", where);
+        s->epollFd = epoll_create1(0);
+        check(s->epollFd >= 0, "Couldn't create epoll instance.");
+        s->wakeFd = eventfd(0, EFD_NONBLOCK);
+        check(s->wakeFd >= 0, "Couldn't create eventfd.");
+
+        ev.data.ptr = &s->listenFd;
+        check(epoll_ctl(s->epollFd, EPOLL_CTL_ADD, s->listenFd, &ev) == 0,
+              "Couldn't watch listening socket.");
+        ev.data.ptr = &s->wakeFd;
+        check(epoll_ctl(s->epollFd, EPOLL_CTL_ADD, s->wakeFd, &ev) == 0,
+              "Couldn't watch eventfd.");
+
+        check(pthread_create(&s->thread, NULL, serverLoop, s) == 0,
+              "Couldn't start server thread.");
+
+        log_info("Spectators welcome at %s", where);
+
+        return s;
+ error:
+        if(s) {
+                if(s->listenFd >= 0) { close(s->listenFd); }
+                if(s->epollFd >= 0)  { close(s->epollFd);  }
+                if(s->wakeFd >= 0)   { close(s->wakeFd);   }
+                tripleDestroy(s->frames);
+                free(s);
+        }
+        return NULL;
+}
+
+/* Hand a Frame to the spectators. Safe from one thread only */
+void serverPublish(server_t* s, frame_t* f) {
+        uint64_t poke = 1;
+
+        *(frame_t*)tripleBack(s->frames) = *f;
+        triplePublish(s->frames);
+
+        if(write(s->wakeFd, &poke, sizeof(poke)) < 0) {
+                debug("Server is already awake.");
+        }
+}
+
+/* Disconnect everyone, stop the thread and deallocate */
+void serverStop(server_t* s) {
+        uint64_t poke = 1;
+        int i;
+
+        if(s) {
+                atomic_store(&s->quit, true);
+
+                if(write(s->wakeFd, &poke, sizeof(poke)) < 0) {
+                        debug("Server is already awake.");
+                }
+
+                pthread_join(s->thread, NULL);
+
+                for(i = 0; i < s->count; i++) {
+                        clientKill(s->clients[i]);
+                }
+                reap(s);
+
+                if(s->path[0]) {
+                        unlink(s->path);
+                }
+
+                if(s->dropped) {
+                        log_info("Skipped %lu Frames for slow spectators.",
+                                 s->dropped);
+                }
+
+                close(s->listenFd);
+                close(s->epollFd);
+                close(s->wakeFd);
+                tripleDestroy(s->frames);
+                free(s->clients);
+                free(s);
+        }
+}
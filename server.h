@@ -0,0 +1,60 @@
+#ifndef __server_h__
+#define __server_h__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "game.h"
+#include "stream.h"
+#include "triple.h"
+
+// --- //
+
+#define MAX_PENDING 4096  // Bytes a slow spectator may fall behind by
+
+/* One connected spectator */
+typedef struct client_t {
+        int fd;
+        bool dead;          // Hung up. Reaped after the current batch.
+        bool needFull;      // It missed something. Resync it.
+        size_t pending;     // Unsent bytes in `out`
+        unsigned char out[MAX_PENDING];
+} client_t;
+
+/* Streams a game to any number of spectators over a local socket.
+ * New spectators get a FULL, then a DIFF per published Frame.
+ * Spectators that can't keep up skip Frames and are resynced with a
+ * FULL once they drain, so nobody ever sees stale history.
+ */
+typedef struct server_t {
+        int listenFd;
+        char path[108];      // Unix socket to remove at shutdown, if any
+        int epollFd;
+        int wakeFd;          // Poked by serverPublish()
+        triple_t* frames;    // Publisher -> server thread
+        frame_t last;        // Latest Frame sent out
+        bool haveLast;
+        client_t** clients;
+        int count;
+        int capacity;
+        unsigned long dropped;  // Frames skipped for slow spectators
+        pthread_t thread;
+        atomic_bool quit;
+} server_t;
+
+// --- //
+
+/* Listen at `where`, either a filesystem path for a Unix socket or a
+ * port number on 127.0.0.1, and start serving on a new thread.
+ */
+server_t* serverStart(const char* where);
+
+/* Hand a Frame to the spectators. Safe from one thread only */
+void serverPublish(server_t* s, frame_t* f);
+
+/* Disconnect everyone, stop the thread and deallocate */
+void serverStop(server_t* s);
+
+#endif
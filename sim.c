@@ -0,0 +1,279 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include "logger.h"
+#include "metrics.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "util.h"
+
+// --- //
+
+#define NSEC_PER_TICK (1000000000L / TICK_RATE)
+#define MAX_LAG_TICKS TICK_RATE  // Beyond this we stop catching up.
+
+/* Publish the game as it stands. `stamp` is when the oldest key
+ * press it answers happened, or 0. Until the renderer takes a Frame,
+ * each one carries the oldest stamp of those it may overwrite.
+ */
+void simPublish(sim_t* s, double stamp) {
+        frame_t* f = tripleBack(s->frames);
+
+        if(atomic_exchange(&s->taken, false)) {
+                s->unseen = 0;
+        }
+
+        if(stamp && (!s->unseen || stamp < s->unseen)) {
+                s->unseen = stamp;
+        }
+
+        gameFrame(s->game, f);
+        f->inputStamp = s->unseen;
+        triplePublish(s->frames);
+
+        if(s->notify) {
+                s->notify();
+        }
+
+        if(s->server) {
+                serverPublish(s->server, f);
+        }
+}
+
+/* Save the game for crash recovery and later analysis. The spool does
+ * the writing, so a slow disk never costs a tick.
+ */
+void simSave(sim_t* s) {
+        snapshot_t snap;
+
+        snapshotTake(s->game, &snap);
+
+        if(s->savePath) {
+                spoolSave(s->spool, s->savePath, &snap);
+        }
+
+        if(s->archive) {
+                spoolWrite(s->spool, s->archive, &snap, sizeof(snap), true);
+        }
+}
+
+/* Nothing moves in a paused or finished game. Sleep until a key
+ * event or shutdown rather than ticking for nothing.
+ */
+void simIdle(sim_t* s) {
+        pthread_mutex_lock(&s->idleLock);
+
+        while(!atomic_load(&s->quit) &&
+              !(s->game->running && !s->game->over) &&
+              ringEmpty(s->input->events)) {
+                pthread_cond_wait(&s->idle, &s->idleLock);
+        }
+
+        pthread_mutex_unlock(&s->idleLock);
+}
+
+/* Wake the sim thread if it's idle */
+void simWake(sim_t* s) {
+        pthread_mutex_lock(&s->idleLock);
+        pthread_cond_signal(&s->idle);
+        pthread_mutex_unlock(&s->idleLock);
+}
+
+/* Push a deadline forward by a number of ticks */
+void addTicks(struct timespec* t, long ticks) {
+        t->tv_nsec += ticks * NSEC_PER_TICK;
+        t->tv_sec  += t->tv_nsec / 1000000000L;
+        t->tv_nsec %= 1000000000L;
+}
+
+/* Ticks from `a` until `b`, rounded down */
+long ticksBetween(struct timespec* a, struct timespec* b) {
+        return ((b->tv_sec - a->tv_sec) * 1000000000L +
+                (b->tv_nsec - a->tv_nsec)) / NSEC_PER_TICK;
+}
+
+/* The sim thread. Ticks on absolute deadlines, so time spent
+ * elsewhere never stretches the game.
+ */
+void* simLoop(void* arg) {
+        sim_t* s = arg;
+        struct timespec next, curr;
+        Action as[MAX_POLL];
+        double stamps[MAX_POLL];
+        double stamp;
+        double began;
+        bool changed, acted;
+        unsigned long saved = s->game->boardSerial;
+        int i,n;
+
+        clock_gettime(CLOCK_MONOTONIC, &next);
+
+        while(!atomic_load(&s->quit)) {
+                changed = false;
+                stamp = 0;
+                began = now();
+
+                if(s->replay) {
+                        recorderBegin(s->replay, s->game);
+                }
+
+                n = inputPoll(s->input, now(), as, stamps);
+
+                for(i = 0; i < n; i++) {
+                        if(s->history && (as[i] == Undo || as[i] == Redo)) {
+                                acted = as[i] == Undo ?
+                                        historyUndo(s->history, s->game) :
+                                        historyRedo(s->history, s->game);
+                        } else {
+                                if(s->replay) {
+                                        recorderAction(s->replay, as[i]);
+                                }
+
+                                acted = gameAct(s->game, as[i]);
+                        }
+
+                        if(acted) {
+                                changed = true;
+
+                                if(stamps[i] && (!stamp || stamps[i] < stamp)) {
+                                        stamp = stamps[i];
+                                }
+                        }
+                }
+
+                changed |= gameTick(s->game);
+
+                if(s->replay) {
+                        recorderEnd(s->replay);
+                }
+
+                if(changed) {
+                        simPublish(s, stamp);
+                }
+
+                // A Block locked, or the game restarted.
+                if(s->game->boardSerial != saved) {
+                        saved = s->game->boardSerial;
+                        simSave(s);
+
+                        if(s->history && !historyRecord(s->history, s->game)) {
+                                log_warn("Couldn't record a turn to undo.");
+                        }
+                }
+
+                metricObserve(TickTime, now() - began);
+
+                if(!s->game->running || s->game->over) {
+                        simIdle(s);
+                        clock_gettime(CLOCK_MONOTONIC, &next);
+                        continue;
+                }
+
+                addTicks(&next, 1);
+                clock_gettime(CLOCK_MONOTONIC, &curr);
+
+                // Suspended or starved. Don't sprint to catch up.
+                if(ticksBetween(&next, &curr) > MAX_LAG_TICKS) {
+                        debug("Sim fell behind. Skipping ahead.");
+                        next = curr;
+                }
+
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+
+        metricsLeave();
+        logLeave();
+
+        return NULL;
+}
+
+/* Prepare to simulate a game. `das` and `arr` are the key repeat
+ * timings, in seconds.
+ */
+sim_t* simCreate(game_t* g, double das, double arr) {
+        sim_t* s = calloc(1, sizeof(sim_t));
+        check_mem(s);
+
+        s->game = g;
+        pthread_mutex_init(&s->idleLock, NULL);
+        pthread_cond_init(&s->idle, NULL);
+        s->input = inputCreate(das, arr);
+        s->frames = tripleCreate(sizeof(frame_t));
+        check(s->input && s->frames, "Couldn't create sim queues.");
+        atomic_init(&s->quit, false);
+        atomic_init(&s->taken, false);
+
+        return s;
+ error:
+        simStop(s);
+        return NULL;
+}
+
+/* Start simulating on a new thread */
+int simStart(sim_t* s) {
+        // The renderer should always have something to draw.
+        simPublish(s, 0);
+
+        if(s->savePath || s->archive || s->replay) {
+                s->spool = spoolStart();
+                check(s->spool, "Couldn't start writing.");
+
+                if(s->replay) {
+                        s->replay->spool = s->spool;
+                }
+        }
+
+        check(pthread_create(&s->thread, NULL, simLoop, s) == 0,
+              "Couldn't start sim thread.");
+        s->started = true;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Queue a key event, stamped with now(), for the next tick */
+bool simKey(sim_t* s, Action a, bool down) {
+        bool ok = inputPush(s->input, a, down, now());
+
+        simWake(s);
+
+        return ok;
+}
+
+/* The latest complete Frame. `fresh` says whether it's new to us */
+frame_t* simFrame(sim_t* s, bool* fresh) {
+        frame_t* f = tripleFront(s->frames, fresh);
+
+        if(*fresh) {
+                atomic_store(&s->taken, true);
+        }
+
+        return f;
+}
+
+/* Stop the sim thread if it started, finish writing, and deallocate.
+ * The game, server, files and recorder are left to the caller.
+ */
+void simStop(sim_t* s) {
+        if(s) {
+                if(s->started) {
+                        atomic_store(&s->quit, true);
+                        simWake(s);
+                        pthread_join(s->thread, NULL);
+                }
+
+                // Whatever the recorder writes from now on, it writes itself.
+                spoolStop(s->spool);
+
+                if(s->replay) {
+                        s->replay->spool = NULL;
+                }
+
+                inputDestroy(s->input);
+                tripleDestroy(s->frames);
+                pthread_mutex_destroy(&s->idleLock);
+                pthread_cond_destroy(&s->idle);
+                free(s);
+        }
+}
@@ -0,0 +1,72 @@
+#ifndef __sim_h__
+#define __sim_h__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "game.h"
+#include "history.h"
+#include "input.h"
+#include "replay.h"
+#include "server.h"
+#include "spool.h"
+#include "triple.h"
+
+// --- //
+
+/* Runs a game on its own thread at TICK_RATE. Key events go in through
+ * an input queue, and Frames come out through a triple buffer, so a
+ * stalled renderer never holds up gravity.
+ *
+ * The optional fields may be set between simCreate() and simStart().
+ */
+typedef struct sim_t {
+        game_t* game;      // Owned by the sim thread once started
+        input_t* input;    // Input thread -> sim thread
+        triple_t* frames;  // Sim thread -> render thread
+        void (*notify)();  // Optional. Called after each publish.
+        server_t* server;  // Optional. Spectators see every publish.
+        char* savePath;    // Optional. Snapshot here after every lock.
+        FILE* archive;     // Optional. Append a snapshot every lock.
+        recorder_t* replay;  // Optional. Record every step.
+        history_t* history;  // Optional. Undo and Redo step through it.
+        spool_t* spool;    // Writes the above, off the sim thread
+        pthread_t thread;
+        bool started;
+        atomic_bool quit;
+        // The oldest key press answered by a Frame that may yet be
+        // overwritten unseen, and whether the renderer has since taken one.
+        double unseen;
+        atomic_bool taken;
+        // A paused game sleeps here until the next key event.
+        pthread_mutex_t idleLock;
+        pthread_cond_t idle;
+} sim_t;
+
+// --- //
+
+/* Prepare to simulate a game. `das` and `arr` are the key repeat
+ * timings, in seconds.
+ */
+sim_t* simCreate(game_t* g, double das, double arr);
+
+/* Start simulating on a new thread */
+int simStart(sim_t* s);
+
+/* Queue a key event, stamped with now(), for the next tick */
+bool simKey(sim_t* s, Action a, bool down);
+
+/* The latest complete Frame. `fresh` says whether it's new to us.
+ * Its inputStamp also covers any Frames published since the last one
+ * we took, so a key press answered in an overwritten Frame isn't lost.
+ */
+frame_t* simFrame(sim_t* s, bool* fresh);
+
+/* Stop the sim thread if it started, finish writing, and deallocate.
+ * The game, server, files and recorder are left to the caller.
+ */
+void simStop(sim_t* s);
+
+#endif
@@ -0,0 +1,232 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "snapshot.h"
+#include "util.h"
+
+// --- //
+
+/* Record a game in a snapshot */
+void snapshotTake(game_t* g, snapshot_t* s) {
+        int i;
+
+        memset(s, 0, sizeof(snapshot_t));
+
+        s->magic = SNAPSHOT_MAGIC;
+        s->version = SNAPSHOT_VERSION;
+        s->size = sizeof(snapshot_t);
+        s->rng = g->rng.state;
+        s->tick = g->tick;
+        s->lines = g->lines;
+        s->matches = g->matches;
+        s->pieces = g->pieces;
+        s->chain = g->chain;
+        s->gravity = g->gravity;
+        s->running = g->running;
+        s->over = g->over;
+        s->name = pieceNames[g->block.piece];
+        s->curr = g->block.curr;
+        s->x = g->block.x;
+        s->y = g->block.y;
+
+        for(i = 0; i < 4; i++) {
+                s->fs[i] = g->block.fs[i];
+        }
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                s->board[i] = g->board[i];
+        }
+
+        // The queue is stored from its head.
+        s->queued = g->next.count;
+
+        for(i = 0; i < g->next.count; i++) {
+                s->next[i] = g->next.slots[(g->next.head + i) % QUEUE_SIZE];
+        }
+
+        s->checksum = crc32(s, offsetof(snapshot_t, checksum));
+}
+
+/* Is this an intact snapshot we understand? */
+bool snapshotValid(snapshot_t* s) {
+        return s->magic == SNAPSHOT_MAGIC &&
+                s->version == SNAPSHOT_VERSION &&
+                s->size == sizeof(snapshot_t) &&
+                s->checksum == crc32(s, offsetof(snapshot_t, checksum));
+}
+
+/* Put a game back the way a valid snapshot says */
+int snapshotRestore(game_t* g, snapshot_t* s) {
+        Fruit fs[4];
+        int i;
+
+        check(snapshotValid(s), "Invalid snapshot.");
+        check(s->queued <= QUEUE_SIZE, "Snapshot has a bad queue.");
+
+        for(i = 0; i < s->queued; i++) {
+                check((s->next[i] & 15) < PIECES, "Snapshot has a bad queue.");
+        }
+
+        for(i = 0; i < 4; i++) {
+                fs[i] = s->fs[i];
+        }
+
+        check(poseBlock(s->name, s->curr, s->x, s->y, fs, &g->block),
+              "Snapshot has a bad Block.");
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                g->board[i] = s->board[i];
+        }
+
+        queueClear(&g->next);
+        g->next.count = s->queued;
+
+        for(i = 0; i < s->queued; i++) {
+                g->next.slots[i] = s->next[i];
+        }
+
+        g->rng.state = s->rng;
+        g->tick = s->tick;
+        g->lines = s->lines;
+        g->matches = s->matches;
+        g->pieces = s->pieces;
+        g->chain = s->chain;
+        g->gravity = s->gravity;
+        g->running = s->running;
+        g->over = s->over;
+        g->boardSerial++;
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Replace the file at `path` with one snapshot, atomically */
+int snapshotSave(const char* path, snapshot_t* s) {
+        char temp[1024];
+        int fd = -1;
+
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
+        fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        check(fd >= 0, "Couldn't write %s", temp);
+        check(write(fd, s, sizeof(snapshot_t)) == sizeof(snapshot_t),
+              "Couldn't write %s", temp);
+        // Or a crash could leave the rename, but not what was renamed.
+        check(fsync(fd) == 0, "Couldn't write %s", temp);
+        check(close(fd) == 0, "Couldn't write %s", temp);
+        fd = -1;
+        check(rename(temp, path) == 0, "Couldn't replace %s", path);
+
+        return 1;
+ error:
+        if(fd >= 0) { close(fd); }
+        return 0;
+}
+
+/* Read and validate the one snapshot in the file at `path` */
+int snapshotLoad(const char* path, snapshot_t* s) {
+        int fd = open(path, O_RDONLY);
+        ssize_t n;
+
+        check_debug(fd >= 0, "No snapshot at %s", path);
+        n = read(fd, s, sizeof(snapshot_t));
+        close(fd);
+
+        check(n == sizeof(snapshot_t) && snapshotValid(s),
+              "Corrupt snapshot at %s", path);
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Map an archive. It's simply snapshots back to back */
+archive_t* archiveOpen(const char* path) {
+        archive_t* a = calloc(1, sizeof(archive_t));
+        struct stat st;
+        void* map;
+        int fd = -1;
+
+        check_mem(a);
+
+        fd = open(path, O_RDONLY);
+        check(fd >= 0, "Couldn't open %s", path);
+        check(fstat(fd, &st) == 0, "Couldn't stat %s", path);
+        a->count = st.st_size / sizeof(snapshot_t);
+        a->bytes = a->count * sizeof(snapshot_t);
+
+        // Cut short by a crash mid-write. Everything before it is fine.
+        if((size_t)st.st_size != a->bytes) {
+                log_warn("%s ends in a partial snapshot of %zu bytes; "
+                         "skipping it.", path, st.st_size - a->bytes);
+        }
+
+        if(a->bytes > 0) {
+                map = mmap(NULL, a->bytes, PROT_READ, MAP_SHARED, fd, 0);
+                check(map != MAP_FAILED, "Couldn't map %s", path);
+                madvise(map, a->bytes, MADV_SEQUENTIAL);
+                a->snaps = map;
+        }
+
+        close(fd);
+
+        return a;
+ error:
+        if(fd >= 0) { close(fd); }
+        free(a);
+        return NULL;
+}
+
+/* Open an archive to append to, creating it if need be. A partial
+ * snapshot left at the end by a crash is cut off first, so what's
+ * appended lines up with what's already there.
+ */
+FILE* archiveCreate(const char* path) {
+        FILE* f = fopen(path, "ab");
+        struct stat st;
+        off_t whole;
+
+        check(f, "Couldn't open %s", path);
+        check(fstat(fileno(f), &st) == 0, "Couldn't stat %s", path);
+        whole = st.st_size - st.st_size % sizeof(snapshot_t);
+
+        if(whole != st.st_size) {
+                log_warn("Cutting a partial snapshot of %ld bytes off %s.",
+                         (long)(st.st_size - whole), path);
+                check(ftruncate(fileno(f), whole) == 0,
+                      "Couldn't truncate %s", path);
+        }
+
+        return f;
+ error:
+        if(f) { fclose(f); }
+        return NULL;
+}
+
+/* Add a snapshot to the end of an archive file. It's flushed straight
+ * away, so a crash can't leave more than one snapshot half-written.
+ */
+int archiveAppend(FILE* f, snapshot_t* s) {
+        check(fwrite(s, sizeof(snapshot_t), 1, f) == 1 && fflush(f) == 0,
+              "Couldn't append to archive.");
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Unmap an archive */
+void archiveClose(archive_t* a) {
+        if(a) {
+                if(a->snaps) {
+                        munmap(a->snaps, a->bytes);
+                }
+                free(a);
+        }
+}
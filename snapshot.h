@@ -0,0 +1,91 @@
+#ifndef __snapshot_h__
+#define __snapshot_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// --- //
+
+#define SNAPSHOT_MAGIC   0x50414e53  // "SNAP"
+#define SNAPSHOT_VERSION 2
+
+/* Everything needed to resume a game exactly, in a fixed 288 bytes.
+ * Fields are naturally aligned and little-endian, so an archive of
+ * snapshots back to back can be mmap'd and read in place. A bad
+ * checksum means a torn or corrupt record.
+ */
+typedef struct snapshot_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t size;       // sizeof(snapshot_t), as written
+        uint64_t rng;
+        uint64_t tick;
+        uint32_t lines;
+        uint32_t matches;
+        uint32_t pieces;
+        uint16_t gravity;
+        uint8_t running;
+        uint8_t over;
+        // The current Block
+        uint8_t name;
+        uint8_t curr;
+        int8_t x;
+        int8_t y;
+        uint8_t fs[4];
+        uint8_t board[BOARD_CELLS];
+        // The upcoming pieces, packed as in queue_t, from its head
+        uint16_t next[QUEUE_SIZE];
+        uint8_t queued;
+        uint8_t chain;       // Clearing steps the last lock set off
+        uint8_t reserved[2]; // Always 0, for now
+        uint32_t checksum;   // CRC-32 of everything before it
+} snapshot_t;
+
+_Static_assert(sizeof(snapshot_t) == 288, "Snapshots are 288 bytes.");
+_Static_assert(_Alignof(snapshot_t) == 8, "Snapshots are 8-aligned.");
+
+/* A read-only, mmap'd file of snapshots */
+typedef struct archive_t {
+        snapshot_t* snaps;
+        size_t count;
+        size_t bytes;  // Of the whole mapping
+} archive_t;
+
+// --- //
+
+/* Record a game in a snapshot */
+void snapshotTake(game_t* g, snapshot_t* s);
+
+/* Is this an intact snapshot we understand? */
+bool snapshotValid(snapshot_t* s);
+
+/* Put a game back the way a valid snapshot says */
+int snapshotRestore(game_t* g, snapshot_t* s);
+
+/* Replace the file at `path` with one snapshot, atomically */
+int snapshotSave(const char* path, snapshot_t* s);
+
+/* Read and validate the one snapshot in the file at `path` */
+int snapshotLoad(const char* path, snapshot_t* s);
+
+/* Map an archive. It's simply snapshots back to back. A partial one at
+ * the end, from a crash, is left out.
+ */
+archive_t* archiveOpen(const char* path);
+
+/* Open an archive to append to, cutting off any partial snapshot at the
+ * end. Yields NULL on failure.
+ */
+FILE* archiveCreate(const char* path);
+
+/* Add a snapshot to the end of an archive file, and flush it */
+int archiveAppend(FILE* f, snapshot_t* s);
+
+/* Unmap an archive */
+void archiveClose(archive_t* a);
+
+#endif
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "input.h"
+#include "logger.h"
+#include "metrics.h"
+#include "server.h"
+#include "snapshot.h"
+#include "stream.h"
+#include "triple.h"
+#include "util.h"
+
+// --- //
+
+/* Plays days of Fetris with no window, as fast as it can, through what
+ * the game does every tick: key events in, Actions out, the rules,
+ * published Frames, the spectator stream and snapshots. A bot mashes
+ * keys and restarts whenever it tops out.
+ *
+ * Once warmed up, the live heap blocks and the resident set must stay
+ * flat. Exits nonzero if either grows.
+ *
+ * With -S, spectators (say `fetris-term -w`) can look in while it runs,
+ * at up to TICK_RATE Frames a second of real time. Each one costs the
+ * server a heap block or two, so then only the resident set is held
+ * flat.
+ */
+
+#define TICKS_PER_HOUR (3600L * TICK_RATE)
+#define WARMUP_HOURS   1
+#define RSS_SLACK      256  // KiB the resident set may wander
+#define PUBLISH_EVERY  64   // Ticks between looks at the clock, with -S
+
+/* Bytes of this process in RAM */
+long residentBytes() {
+        FILE* f = fopen("/proc/self/statm", "r");
+        long size = 0, resident = 0;
+
+        check(f, "Couldn't read /proc/self/statm.");
+        check(fscanf(f, "%ld %ld", &size, &resident) == 2,
+              "Bad /proc/self/statm.");
+        fclose(f);
+
+        return resident * sysconf(_SC_PAGESIZE);
+ error:
+        if(f) {
+                fclose(f);
+        }
+        return -1;
+}
+
+/* Heap blocks handed out and not yet freed */
+long liveBlocks() {
+        return (long)(metricTotal(Allocations) - metricTotal(Frees));
+}
+
+/* Press or let go of a random key, now and then */
+void mash(input_t* in, rng_t* r, bool* held, double t) {
+        int k;
+
+        if(rngBelow(r, 8) == 0) {
+                // Only the moves. Pausing or restarting would stall play.
+                k = rngBelow(r, Shuffle + 1);
+                held[k] = !held[k];
+                inputPush(in, k, held[k], t);
+        }
+}
+
+int main(int argc, char** argv) {
+        input_t* in = NULL;
+        triple_t* frames = NULL;
+        game_t* g = NULL;
+        server_t* server = NULL;
+        snapshot_t snap;
+        frame_t shown;
+        frame_t* f;
+        Action as[MAX_POLL];
+        double stamps[MAX_POLL];
+        unsigned char msg[MAX_MESSAGE];
+        bool held[ACTIONS] = { false };
+        bool fresh;
+        double days = 1;
+        double start;
+        double published = 0;
+        char* spectate = NULL;
+        long rssSlack = RSS_SLACK;
+        long hours, hour, tick;
+        long rss, live, baseRss = 0, baseLive = 0;
+        unsigned long games = 0, bytes = 0;
+        uint64_t seed = 1;
+        int opt, i, n;
+        rng_t r;
+
+        while((opt = getopt(argc, argv, "d:s:r:S:")) != -1) {
+                switch(opt) {
+                case 'd':
+                        days = atof(optarg);
+                        break;
+                case 's':
+                        seed = strtoull(optarg, NULL, 10);
+                        break;
+                case 'r':
+                        rssSlack = atol(optarg);
+                        break;
+                case 'S':
+                        spectate = optarg;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-d days] [-s seed] "
+                                "[-r rss-slack-kib] [-S socket|port]\n",
+                                argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        hours = days * 24;
+        check(hours > WARMUP_HOURS, "Soak for more than %d hour(s).",
+              WARMUP_HOURS);
+
+        in = inputCreate(DEFAULT_DAS, DEFAULT_ARR);
+        check(in, "Couldn't create the input queue.");
+        frames = tripleCreate(sizeof(frame_t));
+        check(frames, "Couldn't create the Frame buffers.");
+        g = gameCreate(seed);
+        check(g, "Couldn't create a game.");
+        rngSeed(&r, seed ^ 0x50414b53);
+        gameFrame(g, &shown);
+
+        if(spectate) {
+                server = serverStart(spectate);
+                check(server, "Couldn't start the spectator server.");
+        }
+
+        log_info("Soaking for %ld simulated hours.", hours);
+        start = now();
+
+        for(hour = 1; hour <= hours; hour++) {
+                for(tick = 0; tick < TICKS_PER_HOUR; tick++) {
+                        double t = ((hour - 1) * TICKS_PER_HOUR + tick) /
+                                (double)TICK_RATE;
+
+                        mash(in, &r, held, t);
+                        n = inputPoll(in, t, as, stamps);
+
+                        for(i = 0; i < n; i++) {
+                                gameAct(g, as[i]);
+                        }
+
+                        gameTick(g);
+
+                        if(g->over) {
+                                gameAct(g, Restart);
+                                games++;
+                        }
+
+                        // What the sim thread and the window would do.
+                        f = tripleBack(frames);
+                        gameFrame(g, f);
+                        triplePublish(frames);
+                        f = tripleFront(frames, &fresh);
+                        bytes += streamDiff(&shown, f, msg);
+                        shown = *f;
+
+                        // Spectators get real time, not sim time.
+                        if(server && tick % PUBLISH_EVERY == 0 &&
+                           now() - published >= 1.0 / TICK_RATE) {
+                                serverPublish(server, f);
+                                published = now();
+                        }
+                }
+
+                snapshotTake(g, &snap);
+                check(snapshotRestore(g, &snap), "Snapshot didn't restore.");
+
+                rss = residentBytes();
+                live = liveBlocks();
+                check(rss >= 0, "Couldn't measure the resident set.");
+
+                if(hour == WARMUP_HOURS) {
+                        baseRss = rss;
+                        baseLive = live;
+                }
+
+                if(hour % 24 == 0 || hour == hours) {
+                        log_info("Hour %ld: %lu games, %lu stream bytes, "
+                                 "%ld KiB resident, %ld live blocks.",
+                                 hour, games, bytes, rss / 1024, live);
+                }
+
+                if(hour > WARMUP_HOURS) {
+                        check(server || live <= baseLive,
+                              "Hour %ld: %ld live blocks, up from %ld.",
+                              hour, live, baseLive);
+                        check(rss <= baseRss + rssSlack * 1024,
+                              "Hour %ld: %ld KiB resident, up from %ld.",
+                              hour, rss / 1024, baseRss / 1024);
+                }
+        }
+
+        log_info("Flat after %ld hours (%.1fs real).", hours, now() - start);
+
+        serverStop(server);
+        gameDestroy(g);
+        tripleDestroy(frames);
+        inputDestroy(in);
+
+        return EXIT_SUCCESS;
+ error:
+        serverStop(server);
+        gameDestroy(g);
+        tripleDestroy(frames);
+        inputDestroy(in);
+        return EXIT_FAILURE;
+}
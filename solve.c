@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "solver.h"
+#include "util.h"
+
+// --- //
+
+/* Solves puzzles exhaustively: every way to place the given pieces, in
+ * order, on the given Board, searched depth first across threads that
+ * steal work from each other. Either every solution is printed, or the
+ * search proves there are none. Solutions are up to transposition: ways
+ * of playing that meet at the same position partway through are only
+ * followed on from there once, so each reports one of them.
+ */
+
+// --- //
+
+/* Print how a solution went, piece by piece */
+void solutionPrint(const puzzle_t* p, const node_t* n, unsigned long i) {
+        int k;
+
+        printf("Solution %lu:\n", i);
+
+        for(k = 0; k < n->depth; k++) {
+                printf("  %2d. ", k + 1);
+                placementPrint(stdout, p->pieces[k], n->path[k]);
+                printf("\n");
+        }
+}
+
+int main(int argc, char** argv) {
+        solver_t* s = NULL;
+        puzzle_t p;
+        unsigned long limit = 0, i;
+        size_t megabytes = 256;
+        int workers = sysconf(_SC_NPROCESSORS_ONLN);
+        double start, t;
+        int opt, finished;
+
+        while((opt = getopt(argc, argv, "w:n:m:")) != -1) {
+                switch(opt) {
+                case 'w':
+                        workers = atoi(optarg);
+                        break;
+                case 'n':
+                        limit = strtoul(optarg, NULL, 10);
+                        break;
+                case 'm':
+                        megabytes = strtoul(optarg, NULL, 10);
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-w workers] "
+                                "[-n solutions] [-m megabytes] puzzle\n",
+                                argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if(workers > MAX_SOLVERS) { workers = MAX_SOLVERS; }
+        if(workers < 1) { workers = 1; }
+
+        check(logStart(), "Couldn't start logging.");
+        check(optind == argc - 1, "One puzzle, please.");
+        check(puzzleLoad(argv[optind], &p), "Couldn't load the puzzle.");
+
+        s = solverCreate(&p, workers, megabytes);
+        check(s, "Couldn't prepare to solve.");
+
+        start = now();
+        finished = solverRun(s, limit);
+        t = now() - start;
+
+        for(i = 0; i < s->solved; i++) {
+                solutionPrint(&p, &s->solutions[i], i + 1);
+        }
+
+        // Nothing can be claimed about what wasn't searched.
+        if(!finished) {
+                printf("Search incomplete: %lu solutions found before it "
+                       "gave up.\n", s->solved);
+        } else if(s->solved == 0) {
+                printf("No solutions exist.\n");
+        } else if(limit && s->solved >= limit) {
+                printf("Stopped at %lu solutions.\n", s->solved);
+        } else {
+                printf("%lu solutions, and no more.\n", s->solved);
+        }
+
+        log_info("%lu positions, %lu placements, %lu duplicates, %lu "
+                 "bounded, %lu steals in %.3fs on %d threads.",
+                 s->stats.nodes, s->stats.placements, s->stats.duplicates,
+                 s->stats.bounded, s->stats.steals, t, workers);
+
+        if(s->stats.unremembered) {
+                log_warn("%lu positions found the seen set full; try more "
+                         "than -m %zu.", s->stats.unremembered, megabytes);
+        }
+
+        solverDestroy(s);
+        logStop();
+
+        return finished ? EXIT_SUCCESS : EXIT_FAILURE;
+ error:
+        solverDestroy(s);
+        logStop();
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,432 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "solver.h"
+#include "util.h"
+
+// --- //
+
+/* A second, unrelated FNV basis. Its hash picks the slot, and the first
+ * is what's kept there, so two positions are only confused if both
+ * hashes agree.
+ */
+#define SLOT_OFFSET 0x84222325cbf29ce4ULL
+
+// --- //
+
+/* Has this position been met before, by anyone? Remembers it if not.
+ * Lines and matches count towards some goals, so they're part of the
+ * position.
+ */
+bool seenBefore(solver_t* s, worker_t* w, const node_t* n) {
+        uint8_t key[BOARD_CELLS + 3];
+        uint64_t h, expected, slot;
+        int len = 0, i;
+
+        // Only the rows in use; the rest are all None.
+        for(i = 0; i < BOARD_CELLS; i++) {
+                key[i] = n->board[i];
+                len = n->board[i] != None ? i / BOARD_WIDTH + 1 : len;
+        }
+
+        len *= BOARD_WIDTH;
+        key[len++] = n->depth;
+        key[len++] = s->puzzle->goal == GoalLines ? n->lines : 0;
+        key[len++] = s->puzzle->goal == GoalMatches ? n->matches : 0;
+
+        h = fnv1a(FNV_OFFSET, key, len) | 1;
+        slot = fnv1a(SLOT_OFFSET, key, len);
+
+        for(i = 0; i < SEEN_PROBES; i++) {
+                expected = 0;
+
+                if(atomic_compare_exchange_strong(
+                           &s->seen[(slot + i) & s->seenMask], &expected, h)) {
+                        return false;
+                } else if(expected == h) {
+                        return true;
+                }
+        }
+
+        // No room. Searching it again is slower, but still right.
+        w->stats.unremembered++;
+
+        return false;
+}
+
+/* Can a position not possibly reach the goal with the pieces left?
+ * Clearing a row takes 10 cells and a run of Fruit at least 3, and a
+ * cell can be in two runs at most, one each way. Without enough of any
+ * one Fruit for a run, only rows can clear, and each takes one cell from
+ * every column. Emptying the Board then takes a multiple of 10 cells
+ * and no column taller than the rows to be cleared, unless cells can be
+ * lost by locking above the top.
+ */
+bool hopeless(const puzzle_t* p, const node_t* n) {
+        int counts[Orange + 1] = { 0 };
+        int columns[BOARD_WIDTH] = { 0 };
+        int remaining = p->count - n->depth;
+        int filled = 0, height = 0, most = 0;
+        int total, i, k;
+        bool whole;
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                if(n->board[i] != None) {
+                        counts[n->board[i]]++;
+                        columns[i % BOARD_WIDTH]++;
+                        filled++;
+                        height = i / BOARD_WIDTH + 1;
+                }
+        }
+
+        for(i = n->depth; i < p->count; i++) {
+                for(k = 0; k < 4; k++) {
+                        counts[p->fruits[i][k]]++;
+                }
+        }
+
+        // The most runs there could ever be.
+        for(i = Grape; i <= Orange; i++) {
+                most += counts[i] >= 3 ? 2 * counts[i] / 3 : 0;
+        }
+
+        total = filled + 4 * remaining;
+        whole = height + 4 * remaining <= BOARD_HEIGHT - 4;
+
+        switch(p->goal) {
+        case GoalLines:
+                return n->lines + total / BOARD_WIDTH < p->target;
+        case GoalMatches:
+                return n->matches + most < p->target;
+        case GoalChain:
+                return total < (most > 0 ? 3 : BOARD_WIDTH) * p->target;
+        case GoalClear:
+                if(most > 0 || !whole) {
+                        return total < 3;
+                } else if(total % BOARD_WIDTH != 0) {
+                        return true;
+                }
+
+                for(i = 0; i < BOARD_WIDTH; i++) {
+                        if(columns[i] > total / BOARD_WIDTH) {
+                                return true;
+                        }
+                }
+
+                return false;
+        }
+
+        return false;
+}
+
+/* Has the piece just placed, setting off `c`, solved the puzzle? */
+bool solvedBy(const puzzle_t* p, const node_t* n, cascade_t c) {
+        int i;
+
+        switch(p->goal) {
+        case GoalLines:
+                return n->lines >= p->target;
+        case GoalMatches:
+                return n->matches >= p->target;
+        case GoalChain:
+                return c.chain >= p->target;
+        case GoalClear:
+                for(i = 0; i < BOARD_CELLS; i++) {
+                        if(n->board[i] != None) {
+                                return false;
+                        }
+                }
+
+                return true;
+        }
+
+        return false;
+}
+
+/* Keep a solution, unless we already have all that were asked for */
+void solutionFound(solver_t* s, const node_t* n) {
+        node_t* more;
+
+        pthread_mutex_lock(&s->found);
+
+        if(s->limit && s->solved >= s->limit) {
+                pthread_mutex_unlock(&s->found);
+                return;
+        }
+
+        if(s->solved == s->room) {
+                more = realloc(s->solutions,
+                               2 * (s->room + 8) * sizeof(node_t));
+
+                if(!more) {
+                        log_err("No room for more solutions.");
+                        atomic_store(&s->failed, true);
+                        atomic_store(&s->stop, true);
+                        pthread_mutex_unlock(&s->found);
+                        return;
+                }
+
+                s->solutions = more;
+                s->room = 2 * (s->room + 8);
+        }
+
+        s->solutions[s->solved++] = *n;
+
+        if(s->limit && s->solved >= s->limit) {
+                atomic_store(&s->stop, true);
+        }
+
+        pthread_mutex_unlock(&s->found);
+}
+
+/* Add a position to the top of a deque */
+int dequePush(deque_t* d, const node_t* n) {
+        node_t* more;
+
+        pthread_mutex_lock(&d->lock);
+
+        // Reuse what thieves have taken from the bottom before growing.
+        if(d->count == d->size && d->first > 0) {
+                memmove(d->nodes, d->nodes + d->first,
+                        (d->count - d->first) * sizeof(node_t));
+                d->count -= d->first;
+                d->first = 0;
+        }
+
+        if(d->count == d->size) {
+                more = realloc(d->nodes, 2 * (d->size + 64) * sizeof(node_t));
+                check_mem(more);
+                d->nodes = more;
+                d->size = 2 * (d->size + 64);
+        }
+
+        d->nodes[d->count++] = *n;
+        pthread_mutex_unlock(&d->lock);
+
+        return 1;
+ error:
+        pthread_mutex_unlock(&d->lock);
+        return 0;
+}
+
+/* Take a position from the top of a deque, or with `bottom`, from the
+ * bottom. Yields 0 if there were none.
+ */
+int dequeTake(deque_t* d, node_t* n, bool bottom) {
+        int got = 0;
+
+        pthread_mutex_lock(&d->lock);
+
+        if(d->count > d->first) {
+                *n = bottom ? d->nodes[d->first++] : d->nodes[--d->count];
+                got = 1;
+
+                if(d->count == d->first) {
+                        d->first = 0;
+                        d->count = 0;
+                }
+        }
+
+        pthread_mutex_unlock(&d->lock);
+
+        return got;
+}
+
+/* Take the oldest position from someone else's deque */
+int steal(worker_t* w, node_t* n) {
+        solver_t* s = w->solver;
+        int i;
+
+        for(i = 1; i < s->count; i++) {
+                if(dequeTake(&s->workers[(w->id + i) % s->count].deque, n,
+                             true)) {
+                        w->stats.steals++;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+/* Try every placement of the next piece from `n`. Positions worth going
+ * on with are pushed for later, and only then is `n` counted done, so
+ * `pending` can't touch 0 while there's still work about.
+ */
+void expand(worker_t* w, const node_t* n) {
+        solver_t* s = w->solver;
+        const puzzle_t* p = s->puzzle;
+        int piece = p->pieces[n->depth];
+        const Fruit* fs = p->fruits[n->depth];
+        node_t child;
+        cascade_t c;
+        bool solved;
+        int count, i;
+
+        count = puzzlePlacements((Fruit*)n->board, piece, fs, w->placements);
+        w->stats.nodes++;
+        w->stats.placements += count;
+
+        for(i = 0; i < count && !atomic_load(&s->stop); i++) {
+                memcpy(child.board, n->board, sizeof(child.board));
+                c = puzzlePlace(child.board, piece, fs, w->placements[i]);
+                memcpy(child.path, n->path, n->depth * sizeof(placement_t));
+                child.path[n->depth] = w->placements[i];
+                child.depth = n->depth + 1;
+                child.lines = n->lines + c.lines;
+                child.matches = n->matches + c.matches;
+                solved = solvedBy(p, &child, c);
+
+                // Solutions are never skipped as duplicates: ending up
+                // the same way by another route is another solution.
+                // Nothing is searched from them, or from the last piece.
+                if(solved) {
+                        solutionFound(s, &child);
+                } else if(child.depth == p->count) {
+                        continue;
+                } else if(seenBefore(s, w, &child)) {
+                        w->stats.duplicates++;
+                } else if(hopeless(p, &child)) {
+                        w->stats.bounded++;
+                } else {
+                        atomic_fetch_add(&s->pending, 1);
+
+                        if(!dequePush(&w->deque, &child)) {
+                                atomic_fetch_sub(&s->pending, 1);
+                                atomic_store(&s->failed, true);
+                                atomic_store(&s->stop, true);
+                        }
+                }
+        }
+
+        atomic_fetch_sub(&s->pending, 1);
+}
+
+/* Search depth first from our own deque, and steal once it runs dry */
+void* workerRun(void* arg) {
+        worker_t* w = arg;
+        solver_t* s = w->solver;
+        node_t n;
+
+        while(!atomic_load(&s->stop)) {
+                if(dequeTake(&w->deque, &n, false) || steal(w, &n)) {
+                        expand(w, &n);
+                } else if(atomic_load(&s->pending) == 0) {
+                        break;
+                } else {
+                        sched_yield();
+                }
+        }
+
+        return NULL;
+}
+
+/* Prepare to solve `p` */
+solver_t* solverCreate(const puzzle_t* p, int workers, size_t megabytes) {
+        solver_t* s = NULL;
+        size_t slots = 1024;
+        int i;
+
+        check(workers > 0 && workers <= MAX_SOLVERS,
+              "Between 1 and %d workers.", MAX_SOLVERS);
+
+        while(slots * 2 * sizeof(uint64_t) <= megabytes << 20) {
+                slots *= 2;
+        }
+
+        s = calloc(1, sizeof(solver_t));
+        check_mem(s);
+        pthread_mutex_init(&s->found, NULL);
+        s->puzzle = p;
+        s->count = workers;
+        s->seenMask = slots - 1;
+        s->seen = calloc(slots, sizeof(uint64_t));
+        s->workers = calloc(workers, sizeof(worker_t));
+        check_mem(s->seen && s->workers);
+        atomic_init(&s->pending, 0);
+        atomic_init(&s->stop, false);
+        atomic_init(&s->failed, false);
+
+        for(i = 0; i < workers; i++) {
+                s->workers[i].solver = s;
+                s->workers[i].id = i;
+                pthread_mutex_init(&s->workers[i].deque.lock, NULL);
+                s->workers[i].placements =
+                        malloc(MAX_PLACEMENTS * sizeof(placement_t));
+                check_mem(s->workers[i].placements);
+        }
+
+        return s;
+ error:
+        solverDestroy(s);
+        return NULL;
+}
+
+/* Search for solutions */
+int solverRun(solver_t* s, unsigned long limit) {
+        solverstats_t* t = &s->stats;
+        solverstats_t* w;
+        node_t root = { .depth = 0 };
+        int started = 0, i;
+
+        s->limit = limit;
+        memcpy(root.board, s->puzzle->board, sizeof(root.board));
+
+        if(hopeless(s->puzzle, &root)) {
+                t->bounded = 1;
+                return 1;
+        }
+
+        atomic_store(&s->pending, 1);
+        check(dequePush(&s->workers[0].deque, &root), "Couldn't start.");
+
+        for(i = 0; i < s->count; i++, started++) {
+                check(pthread_create(&s->workers[i].thread, NULL, workerRun,
+                                     &s->workers[i]) == 0,
+                      "Couldn't start worker %d.", i);
+        }
+
+        for(i = 0; i < s->count; i++) {
+                pthread_join(s->workers[i].thread, NULL);
+                w = &s->workers[i].stats;
+                t->nodes += w->nodes;
+                t->placements += w->placements;
+                t->duplicates += w->duplicates;
+                t->bounded += w->bounded;
+                t->steals += w->steals;
+                t->unremembered += w->unremembered;
+        }
+
+        return !atomic_load(&s->failed);
+ error:
+        atomic_store(&s->failed, true);
+        atomic_store(&s->stop, true);
+
+        for(i = 0; i < started; i++) {
+                pthread_join(s->workers[i].thread, NULL);
+        }
+
+        return 0;
+}
+
+/* Deallocate */
+void solverDestroy(solver_t* s) {
+        int i;
+
+        if(!s) {
+                return;
+        }
+
+        for(i = 0; s->workers && i < s->count; i++) {
+                pthread_mutex_destroy(&s->workers[i].deque.lock);
+                free(s->workers[i].deque.nodes);
+                free(s->workers[i].placements);
+        }
+
+        pthread_mutex_destroy(&s->found);
+        free(s->workers);
+        free(s->seen);
+        free(s->solutions);
+        free(s);
+}
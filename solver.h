@@ -0,0 +1,97 @@
+#ifndef __solver_h__
+#define __solver_h__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "puzzle.h"
+
+// --- //
+
+#define MAX_SOLVERS 64
+#define SEEN_PROBES 32  // Slots tried before a position goes unremembered
+
+/* A position partway through a puzzle, and how it was reached */
+typedef struct node_t {
+        Fruit board[BOARD_CELLS];
+        int depth;    // Pieces placed
+        int lines;
+        int matches;
+        placement_t path[MAX_PUZZLE_PIECES];
+} node_t;
+
+/* One worker's positions still to search. The owner pushes and pops at
+ * the top, depth first; thieves take from the bottom, where the
+ * shallowest and so biggest pieces of work are.
+ */
+typedef struct deque_t {
+        pthread_mutex_t lock;
+        node_t* nodes;
+        int first;  // Oldest not yet taken
+        int count;  // One past the newest
+        int size;
+} deque_t;
+
+/* How one worker's search went. Summed once everyone's done */
+typedef struct solverstats_t {
+        unsigned long nodes;       // Positions expanded
+        unsigned long placements;  // ...and the pieces tried on them
+        unsigned long duplicates;  // Positions already seen elsewhere
+        unsigned long bounded;     // ...or that couldn't possibly succeed
+        unsigned long steals;
+        unsigned long unremembered;  // Found no room in the seen set
+} solverstats_t;
+
+struct solver_t;
+
+typedef struct worker_t {
+        struct solver_t* solver;
+        int id;
+        deque_t deque;
+        placement_t* placements;  // Room for MAX_PLACEMENTS
+        solverstats_t stats;
+        pthread_t thread;
+} worker_t;
+
+/* A search over every way to place a puzzle's pieces. Positions met
+ * before, by any worker, are skipped through a shared set of their
+ * hashes, so pieces that land the same way however they're turned or
+ * shuffled, or different orders of play that meet again, are searched
+ * only once.
+ */
+typedef struct solver_t {
+        const puzzle_t* puzzle;
+        _Atomic uint64_t* seen;  // Position hashes. 0 is an empty slot.
+        uint64_t seenMask;
+        worker_t* workers;
+        int count;
+        atomic_long pending;     // Positions pushed but not yet expanded
+        atomic_bool stop;
+        atomic_bool failed;      // Gave up before searching everything
+        unsigned long limit;     // Solutions to stop at. 0 for all.
+        pthread_mutex_t found;
+        node_t* solutions;       // Each the position that solved it
+        unsigned long solved;
+        unsigned long room;
+        solverstats_t stats;     // Everyone's, once they're done
+} solver_t;
+
+// --- //
+
+/* Prepare to solve `p` on `workers` threads, remembering positions in
+ * about `megabytes` of memory. Yields NULL on failure.
+ */
+solver_t* solverCreate(const puzzle_t* p, int workers, size_t megabytes);
+
+/* Search until every solution is found, or `limit` of them (0 for no
+ * limit). Yields 0 if the search couldn't be finished, for want of
+ * threads or memory; the solutions found until then are kept.
+ */
+int solverRun(solver_t* s, unsigned long limit);
+
+/* Deallocate, solutions and all */
+void solverDestroy(solver_t* s);
+
+#endif
@@ -0,0 +1,159 @@
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "spool.h"
+
+// --- //
+
+#define SPOOL_PERIOD 10       // Milliseconds the writer sleeps
+#define SPOOL_WAIT   1000000  // Nanoseconds between tries for room
+
+// --- //
+
+/* Let the writer know there's work */
+void spoolWake(spool_t* s) {
+        uint64_t one = 1;
+        ssize_t n = write(s->wakeFd, &one, sizeof(one));
+
+        (void)n;
+}
+
+/* Queue one write, waiting for room if the disk is far behind */
+void spoolPush(spool_t* s, const spooled_t* w) {
+        struct timespec wait = { 0, SPOOL_WAIT };
+
+        while(!ringPush(s->queue, w)) {
+                if(s->stalls++ == 0) {
+                        log_warn("The disk is behind; waiting for it.");
+                }
+
+                spoolWake(s);
+                nanosleep(&wait, NULL);
+        }
+
+        spoolWake(s);
+}
+
+/* Queue bytes to append to `file` */
+void spoolWrite(spool_t* s, FILE* file, const void* data, size_t length,
+                bool flush) {
+        spooled_t w = { .file = file };
+        size_t n;
+
+        do {
+                n = length < SPOOL_BYTES ? length : SPOOL_BYTES;
+                w.length = n;
+                w.flush = flush && n == length;
+                memcpy(w.data, data, n);
+                spoolPush(s, &w);
+                data = (const unsigned char*)data + n;
+                length -= n;
+        } while(length > 0);
+}
+
+/* Queue a snapshot to save to `path` */
+void spoolSave(spool_t* s, const char* path, const snapshot_t* snap) {
+        spooled_t w = { .path = path, .length = sizeof(snapshot_t) };
+
+        memcpy(w.data, snap, sizeof(snapshot_t));
+        spoolPush(s, &w);
+}
+
+/* Carry out one queued write */
+int spoolDo(spooled_t* w) {
+        snapshot_t snap;
+
+        if(w->path) {
+                memcpy(&snap, w->data, sizeof(snap));
+                return snapshotSave(w->path, &snap);
+        }
+
+        check(fwrite(w->data, 1, w->length, w->file) == w->length &&
+              (!w->flush || fflush(w->file) == 0), "Couldn't write.");
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* Write whatever's queued, until told to quit */
+void* spoolLoop(void* arg) {
+        spool_t* s = arg;
+        struct pollfd p = { s->wakeFd, POLLIN, 0 };
+        spooled_t w;
+        uint64_t pokes;
+        unsigned long failed = 0;
+        bool quit;
+        ssize_t n;
+
+        do {
+                // Everything queued before quit was set gets written.
+                quit = atomic_load(&s->quit);
+
+                while(ringPop(s->queue, &w)) {
+                        failed += !spoolDo(&w);
+                }
+
+                if(!quit) {
+                        poll(&p, 1, SPOOL_PERIOD);
+                        n = read(s->wakeFd, &pokes, sizeof(pokes));
+                        (void)n;
+                }
+        } while(!quit);
+
+        if(failed) {
+                log_err("%lu writes failed.", failed);
+        }
+
+        logLeave();
+
+        return NULL;
+}
+
+/* Start a writer thread */
+spool_t* spoolStart() {
+        spool_t* s = calloc(1, sizeof(spool_t));
+
+        check_mem(s);
+        s->wakeFd = -1;
+        atomic_init(&s->quit, false);
+        s->queue = ringCreate(sizeof(spooled_t), SPOOL_SLOTS);
+        check(s->queue, "Couldn't create the spool's queue.");
+        s->wakeFd = eventfd(0, EFD_NONBLOCK);
+        check(s->wakeFd >= 0, "Couldn't create eventfd.");
+        check(pthread_create(&s->thread, NULL, spoolLoop, s) == 0,
+              "Couldn't start the spool's thread.");
+        s->started = true;
+
+        return s;
+ error:
+        spoolStop(s);
+        return NULL;
+}
+
+/* Finish every queued write, then stop */
+void spoolStop(spool_t* s) {
+        if(s) {
+                if(s->started) {
+                        atomic_store(&s->quit, true);
+                        spoolWake(s);
+                        pthread_join(s->thread, NULL);
+                }
+
+                if(s->stalls) {
+                        log_warn("Waited on the disk %lu times.", s->stalls);
+                }
+
+                if(s->wakeFd >= 0) {
+                        close(s->wakeFd);
+                }
+
+                ringDestroy(s->queue);
+                free(s);
+        }
+}
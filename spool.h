@@ -0,0 +1,62 @@
+#ifndef __spool_h__
+#define __spool_h__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ring.h"
+#include "snapshot.h"
+
+// --- //
+
+#define SPOOL_SLOTS 1024              // Writes waiting for the disk
+#define SPOOL_BYTES sizeof(snapshot_t)  // ...of at most this much each
+
+/* One write for the spool's thread: bytes to append to `file`, or with
+ * `path`, a snapshot to save there in place of the last.
+ */
+typedef struct spooled_t {
+        FILE* file;
+        const char* path;
+        uint16_t length;
+        bool flush;       // Flush `file` once written
+        unsigned char data[SPOOL_BYTES];
+} spooled_t;
+
+/* Writes files on a thread of its own, so whoever hands it the bytes
+ * never waits on the disk. Writes happen in the order they're queued.
+ * Only one thread may queue them.
+ */
+typedef struct spool_t {
+        ring_t* queue;
+        pthread_t thread;
+        int wakeFd;
+        atomic_bool quit;
+        unsigned long stalls;  // Waits for room, with the disk far behind
+        bool started;
+} spool_t;
+
+// --- //
+
+/* Start a writer thread. Yields NULL on failure */
+spool_t* spoolStart();
+
+/* Queue `length` bytes to append to `file`, then flush it with `flush`.
+ * Only waits if SPOOL_SLOTS writes are already waiting, since dropping
+ * some would spoil the file.
+ */
+void spoolWrite(spool_t* s, FILE* file, const void* data, size_t length,
+                bool flush);
+
+/* Queue a snapshot to save to `path`, which must outlive the spool */
+void spoolSave(spool_t* s, const char* path, const snapshot_t* snap);
+
+/* Finish every queued write, then stop the thread and deallocate. The
+ * files are left to the caller.
+ */
+void spoolStop(spool_t* s);
+
+#endif
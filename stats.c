@@ -0,0 +1,190 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "snapshot.h"
+#include "tally.h"
+#include "util.h"
+
+// --- //
+
+/* Answers questions about piles of archives (`fetris -A`) without
+ * replaying anything. Every archive is mapped, the snapshots of all of
+ * them are split evenly across threads, and each thread tallies its
+ * share on its own. The tallies are only summed once every thread is
+ * done, so the threads never share a thing but the page cache.
+ */
+
+#define MAX_SHARDS 64
+
+/* One thread's share of the snapshots, numbered across all archives */
+typedef struct shard_t {
+        archive_t** archives;
+        int count;
+        size_t first;
+        size_t last;  // One past
+        tally_t tally;
+        pthread_t thread;
+} shard_t;
+
+// --- //
+
+/* Tally a shard's snapshots, archive by archive */
+void* shardRun(void* arg) {
+        shard_t* sh = arg;
+        archive_t* a;
+        snapshot_t* s;
+        size_t base = 0, lo, hi, i;
+        bool prevOK;
+        int n;
+
+        for(n = 0; n < sh->count; base += sh->archives[n]->count, n++) {
+                a = sh->archives[n];
+
+                if(sh->last <= base || sh->first >= base + a->count) {
+                        continue;
+                }
+
+                lo = sh->first > base ? sh->first - base : 0;
+                hi = sh->last - base < a->count ? sh->last - base : a->count;
+
+                // The snapshot before ours is someone else's, but we
+                // still need to compare against it.
+                prevOK = lo > 0 && snapshotValid(&a->snaps[lo - 1]);
+
+                for(i = lo; i < hi; i++) {
+                        s = &a->snaps[i];
+
+                        if(!snapshotValid(s)) {
+                                sh->tally.corrupt++;
+                                prevOK = false;
+                                continue;
+                        }
+
+                        tallyStep(&sh->tally, prevOK ? s - 1 : NULL, s);
+                        prevOK = true;
+                }
+        }
+
+        return NULL;
+}
+
+/* Turn a list like "heights,chains" into TALLY_* bits. 0 if any name
+ * is unknown.
+ */
+unsigned parseWants(char* list) {
+        unsigned wants = 0, bit;
+        char* name;
+
+        for(name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+                bit = tallyNamed(name);
+                check(bit, "No aggregation called %s.", name);
+                wants |= bit;
+        }
+
+        return wants;
+ error:
+        return 0;
+}
+
+int main(int argc, char** argv) {
+        archive_t** archives = NULL;
+        shard_t* shards = NULL;
+        tally_t total;
+        unsigned wants = TALLY_ALL;
+        size_t snapshots = 0, share;
+        double start, t;
+        int workers = sysconf(_SC_NPROCESSORS_ONLN);
+        int count = 0, started = 0;
+        int opt,i;
+
+        while((opt = getopt(argc, argv, "a:w:")) != -1) {
+                switch(opt) {
+                case 'a':
+                        wants = parseWants(optarg);
+                        check(wants, "Nothing to tally.");
+                        break;
+                case 'w':
+                        workers = atoi(optarg);
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-a heights,clears,"
+                                "matches,chains,lengths,heat|all] "
+                                "[-w workers] archive ...\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        check(optind < argc, "No archives given.");
+        archives = calloc(argc - optind, sizeof(archive_t*));
+        check_mem(archives);
+
+        for(i = optind; i < argc; i++, count++) {
+                archives[count] = archiveOpen(argv[i]);
+                check(archives[count], "Couldn't open %s", argv[i]);
+                snapshots += archives[count]->count;
+        }
+
+        if(workers > MAX_SHARDS) { workers = MAX_SHARDS; }
+        if(workers < 1) { workers = 1; }
+
+        shards = calloc(workers, sizeof(shard_t));
+        check_mem(shards);
+        share = (snapshots + workers - 1) / workers;
+        start = now();
+
+        // Contiguous ranges, so each thread reads its own stretch of
+        // the files front to back.
+        for(i = 0; i < workers; i++, started++) {
+                shards[i].archives = archives;
+                shards[i].count = count;
+                shards[i].first = i * share < snapshots ? i * share :
+                        snapshots;
+                shards[i].last = shards[i].first + share < snapshots ?
+                        shards[i].first + share : snapshots;
+                shards[i].tally.wants = wants;
+                check(pthread_create(&shards[i].thread, NULL, shardRun,
+                                     &shards[i]) == 0,
+                      "Couldn't start a worker.");
+        }
+
+        memset(&total, 0, sizeof(total));
+        total.wants = wants;
+
+        for(i = 0; i < started; i++) {
+                pthread_join(shards[i].thread, NULL);
+                tallyMerge(&total, &shards[i].tally);
+        }
+
+        t = now() - start;
+        log_info("%lu snapshots (%.1f MB) in %.3fs: %.0f MB/s on %d "
+                 "threads.", (unsigned long)snapshots,
+                 snapshots * sizeof(snapshot_t) / 1e6, t,
+                 snapshots * sizeof(snapshot_t) / 1e6 / t, workers);
+
+        tallyPrint(stdout, &total);
+
+        for(i = 0; i < count; i++) {
+                archiveClose(archives[i]);
+        }
+
+        free(archives);
+        free(shards);
+
+        return EXIT_SUCCESS;
+ error:
+        for(i = 0; i < started; i++) {
+                pthread_join(shards[i].thread, NULL);
+        }
+
+        for(i = 0; i < count; i++) {
+                archiveClose(archives[i]);
+        }
+
+        free(archives);
+        free(shards);
+        return EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+#include <string.h>
+
+#include "logger.h"
+#include "stream.h"
+
+// --- //
+
+/* Fill in a header and the piece that follows it */
+unsigned char* putPiece(frame_t* f, unsigned char* buf, uint8_t type) {
+        stream_header_t h = { type, 0, 0, f->tick };
+        stream_piece_t p;
+        int i;
+
+        h.flags = (f->over ? STREAM_OVER : 0) |
+                (f->running ? 0 : STREAM_PAUSED);
+
+        p.name = f->name;
+        p.curr = f->curr;
+        p.x = f->x;
+        p.y = f->y;
+
+        for(i = 0; i < 4; i++) {
+                p.fs[i] = f->fs[i];
+        }
+
+        for(i = 0; i < 8; i++) {
+                p.cells[i] = f->cells[i];
+        }
+
+        memcpy(buf, &h, sizeof(h));
+        memcpy(buf + sizeof(h), &p, sizeof(p));
+
+        return buf + sizeof(h) + sizeof(p);
+}
+
+/* Go back and record the payload length */
+size_t finish(unsigned char* buf, unsigned char* end) {
+        uint16_t length = end - buf - sizeof(stream_header_t);
+
+        memcpy(buf + offsetof(stream_header_t, length),
+               &length, sizeof(length));
+
+        return end - buf;
+}
+
+/* Encode all of a Frame into `buf`. Yields the message length */
+size_t streamFull(frame_t* f, unsigned char* buf) {
+        unsigned char* b = putPiece(f, buf, STREAM_FULL);
+        int i;
+
+        for(i = 0; i < BOARD_CELLS; i++) {
+                *b++ = f->board[i];
+        }
+
+        return finish(buf, b);
+}
+
+/* Encode what changed from `prev` to `f` into `buf`. Falls back to a
+ * FULL when that's smaller. Yields the message length.
+ */
+size_t streamDiff(frame_t* prev, frame_t* f, unsigned char* buf) {
+        unsigned char* b = putPiece(f, buf, STREAM_DIFF);
+        unsigned char* count = b++;
+        int i;
+
+        *count = 0;
+
+        // Most ticks only the piece moves, so skip the Board entirely.
+        if(f->boardSerial != prev->boardSerial) {
+                for(i = 0; i < BOARD_CELLS; i++) {
+                        if(f->board[i] == prev->board[i]) {
+                                continue;
+                        }
+
+                        if(*count == MAX_DIFF_CELLS) {
+                                return streamFull(f, buf);
+                        }
+
+                        *b++ = i;
+                        *b++ = f->board[i];
+                        (*count)++;
+                }
+        }
+
+        return finish(buf, b);
+}
+
+/* How long the message at the front of `buf` is, if `len` bytes hold
+ * all of it. Yields 0 if more bytes are needed, -1 if it's garbage.
+ */
+int streamLength(unsigned char* buf, size_t len) {
+        stream_header_t h;
+        size_t total;
+
+        if(len < sizeof(h)) {
+                return 0;
+        }
+
+        memcpy(&h, buf, sizeof(h));
+        total = sizeof(h) + h.length;
+
+        if((h.type != STREAM_FULL && h.type != STREAM_DIFF) ||
+           total > MAX_MESSAGE) {
+                return -1;
+        }
+
+        return len < total ? 0 : (int)total;
+}
+
+/* Apply one complete message to a mirror of the game. A DIFF needs
+ * the mirror to have seen a FULL first. Yields 0 on garbage.
+ */
+int streamApply(frame_t* mirror, unsigned char* msg) {
+        stream_header_t h;
+        stream_piece_t p;
+        unsigned char* b = msg + sizeof(h) + sizeof(p);
+        int i,n;
+
+        memcpy(&h, msg, sizeof(h));
+        memcpy(&p, msg + sizeof(h), sizeof(p));
+
+        mirror->name = p.name;
+        mirror->curr = p.curr;
+        mirror->x = p.x;
+        mirror->y = p.y;
+
+        for(i = 0; i < 4; i++) {
+                mirror->fs[i] = p.fs[i];
+        }
+
+        for(i = 0; i < 8; i++) {
+                mirror->cells[i] = p.cells[i];
+        }
+
+        mirror->tick = h.tick;
+        mirror->over = h.flags & STREAM_OVER;
+        mirror->running = !(h.flags & STREAM_PAUSED);
+
+        if(h.type == STREAM_FULL) {
+                check(h.length == sizeof(p) + BOARD_CELLS, "Bad FULL length.");
+
+                for(i = 0; i < BOARD_CELLS; i++) {
+                        mirror->board[i] = b[i];
+                }
+
+                mirror->boardSerial++;
+        } else {
+                n = *b++;
+                check(h.length == sizeof(p) + 1 + 2 * n, "Bad DIFF length.");
+
+                for(i = 0; i < n; i++, b += 2) {
+                        check(b[0] < BOARD_CELLS, "Bad DIFF cell.");
+                        mirror->board[b[0]] = b[1];
+                }
+
+                if(n > 0) {
+                        mirror->boardSerial++;
+                }
+        }
+
+        return 1;
+ error:
+        return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef __stream_h__
+#define __stream_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+// --- //
+
+/* The spectator wire format. Every message is a header followed by
+ * `length` bytes of payload. All fields are single bytes or
+ * little-endian.
+ *
+ *   FULL: header, piece, the whole Board (one Fruit per byte)
+ *   DIFF: header, piece, a count, then (cell index, Fruit) pairs
+ */
+#define STREAM_FULL 'F'
+#define STREAM_DIFF 'D'
+
+// Header flags
+#define STREAM_OVER   1
+#define STREAM_PAUSED 2
+
+// A DIFF never gets bigger than this. Past it, a FULL is cheaper.
+#define MAX_DIFF_CELLS 96
+#define MAX_MESSAGE    256
+
+typedef struct stream_header_t {
+        uint8_t type;
+        uint8_t flags;
+        uint16_t length;  // Payload bytes
+        uint32_t tick;
+} stream_header_t;
+
+typedef struct stream_piece_t {
+        uint8_t name;
+        uint8_t curr;
+        int8_t x;
+        int8_t y;
+        uint8_t fs[4];
+        int8_t cells[8];
+} stream_piece_t;
+
+_Static_assert(sizeof(stream_header_t) == 8, "Header must be packed.");
+_Static_assert(sizeof(stream_piece_t) == 16, "Piece must be packed.");
+
+// --- //
+
+/* Encode all of a Frame into `buf`. Yields the message length */
+size_t streamFull(frame_t* f, unsigned char* buf);
+
+/* Encode what changed from `prev` to `f` into `buf`. Falls back to a
+ * FULL when that's smaller. Yields the message length.
+ */
+size_t streamDiff(frame_t* prev, frame_t* f, unsigned char* buf);
+
+/* How long the message at the front of `buf` is, if `len` bytes hold
+ * all of it. Yields 0 if more bytes are needed, -1 if it's garbage.
+ */
+int streamLength(unsigned char* buf, size_t len);
+
+/* Apply one complete message to a mirror of the game. A DIFF needs
+ * the mirror to have seen a FULL first. Yields 0 on garbage.
+ */
+int streamApply(frame_t* mirror, unsigned char* msg);
+
+#endif
@@ -0,0 +1,282 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "logger.h"
+#include "tally.h"
+
+// --- //
+
+#define BAR_WIDTH 40
+
+/* Aggregations by name, for the command line */
+typedef struct tally_name_t {
+        const char* name;
+        unsigned bit;
+} tally_name_t;
+
+const tally_name_t tallyNames[] = {
+        { "heights", TALLY_HEIGHTS },
+        { "clears",  TALLY_CLEARS },
+        { "matches", TALLY_MATCHES },
+        { "chains",  TALLY_CHAINS },
+        { "lengths", TALLY_LENGTHS },
+        { "heat",    TALLY_HEAT },
+        { "all",     TALLY_ALL },
+};
+
+// Heat map shading, coldest first.
+const char heatRamp[] = " .:-=+*#%@";
+
+// --- //
+
+/* Which aggregation bit a name like "heights" or "all" stands for. 0
+ * if none.
+ */
+unsigned tallyNamed(const char* name) {
+        size_t i;
+
+        for(i = 0; i < sizeof(tallyNames) / sizeof(tallyNames[0]); i++) {
+                if(!strcmp(name, tallyNames[i].name)) {
+                        return tallyNames[i].bit;
+                }
+        }
+
+        return 0;
+}
+
+/* Count `v` in one of `n` bins, the last taking everything past it */
+void tallyBin(uint64_t* bins, int n, uint64_t v) {
+        bins[v < (uint64_t)n ? v : (uint64_t)n - 1]++;
+}
+
+/* How many rows high the stack on a Board is */
+int stackHeight(const uint8_t* board) {
+        int i;
+
+        for(i = BOARD_CELLS - 1; i >= 0; i--) {
+                if(board[i] != None) {
+                        return i / BOARD_WIDTH + 1;
+                }
+        }
+
+        return 0;
+}
+
+/* Count what happened between two snapshots from the same archive, one
+ * straight after the other. `prev` is NULL for an archive's first.
+ */
+void tallyStep(tally_t* t, const snapshot_t* prev, const snapshot_t* s) {
+        uint32_t lines, matches;
+        int i,piece;
+
+        t->snapshots++;
+
+        if(!prev) {
+                return;
+        }
+
+        // A restart. Whatever came before it is over.
+        if(s->tick < prev->tick || s->pieces < prev->pieces) {
+                t->games++;
+                tallyBin(t->lengths, LENGTH_BINS, prev->pieces / LENGTH_WIDTH);
+                return;
+        }
+
+        // Anything else is a resume, or records went missing.
+        piece = pieceNamed(prev->name);
+
+        if(s->pieces != prev->pieces + 1 || piece < 0) {
+                return;
+        }
+
+        // The piece that was falling in `prev` has landed.
+        lines = s->lines - prev->lines;
+        matches = s->matches - prev->matches;
+        t->locks++;
+
+        if(t->wants & TALLY_HEIGHTS) {
+                tallyBin(t->heights, HEIGHT_BINS, stackHeight(s->board));
+        }
+
+        if(t->wants & TALLY_CLEARS) {
+                tallyBin(t->clears, CLEAR_BINS, lines);
+        }
+
+        if(t->wants & TALLY_MATCHES) {
+                tallyBin(t->matches, MATCH_BINS, matches);
+        }
+
+        if(t->wants & TALLY_CHAINS) {
+                tallyBin(t->chains[piece], CHAIN_BINS, s->chain);
+        }
+
+        // The new cells are the piece's, unless a clear moved things.
+        if(t->wants & TALLY_HEAT) {
+                if(lines || matches) {
+                        t->hidden++;
+                        return;
+                }
+
+                for(i = 0; i < BOARD_CELLS; i++) {
+                        if(prev->board[i] == None && s->board[i] != None) {
+                                t->heat[piece][i]++;
+                        }
+                }
+        }
+}
+
+/* Add `from`'s counts into `into` */
+void tallyMerge(tally_t* into, const tally_t* from) {
+        const uint64_t* a = &from->snapshots;
+        uint64_t* b = &into->snapshots;
+        size_t i;
+
+        // Everything from `snapshots` on is a count.
+        for(i = 0; i < (sizeof(tally_t) - offsetof(tally_t, snapshots)) /
+                    sizeof(uint64_t); i++) {
+                b[i] += a[i];
+        }
+}
+
+/* Print one histogram's non-empty bins, with bars. Bin `i` covers
+ * `width` values from i * width; the last covers the rest too.
+ */
+void printBins(FILE* f, const char* title, const uint64_t* bins, int n,
+               int width) {
+        uint64_t total = 0, most = 0;
+        char label[32];
+        int i;
+
+        for(i = 0; i < n; i++) {
+                total += bins[i];
+                most = bins[i] > most ? bins[i] : most;
+        }
+
+        fprintf(f, "\n%s\n", title);
+
+        for(i = 0; i < n && total; i++) {
+                if(!bins[i]) {
+                        continue;
+                }
+
+                if(i == n - 1) {
+                        snprintf(label, sizeof(label), "%d+", i * width);
+                } else if(width > 1) {
+                        snprintf(label, sizeof(label), "%d-%d", i * width,
+                                 (i + 1) * width - 1);
+                } else {
+                        snprintf(label, sizeof(label), "%d", i);
+                }
+
+                fprintf(f, "%9s %12lu %6.2f%% %.*s\n", label,
+                        (unsigned long)bins[i], 100.0 * bins[i] / total,
+                        (int)(BAR_WIDTH * bins[i] / most),
+                        "########################################");
+        }
+}
+
+/* Print chain lengths as a table, one row per piece */
+void printChains(FILE* f, const tally_t* t) {
+        uint64_t total;
+        int p,c,widest = 1;
+
+        for(p = 0; p < PIECES; p++) {
+                for(c = 0; c < CHAIN_BINS; c++) {
+                        widest = t->chains[p][c] && c + 1 > widest ?
+                                c + 1 : widest;
+                }
+        }
+
+        fprintf(f, "\nchain length by piece, as %% of its locks\n"
+                "piece        locks");
+
+        for(c = 0; c < widest; c++) {
+                fprintf(f, c == CHAIN_BINS - 1 ? " %6d+" : " %7d", c);
+        }
+
+        fprintf(f, "\n");
+
+        for(p = 0; p < PIECES; p++) {
+                for(c = 0, total = 0; c < CHAIN_BINS; c++) {
+                        total += t->chains[p][c];
+                }
+
+                fprintf(f, "%5c %12lu", pieceNames[p], (unsigned long)total);
+
+                for(c = 0; c < widest; c++) {
+                        fprintf(f, " %7.3f", total ?
+                                100.0 * t->chains[p][c] / total : 0.0);
+                }
+
+                fprintf(f, "\n");
+        }
+}
+
+/* Print where each piece's cells came to rest, top row first, shaded
+ * by how often against that piece's busiest cell
+ */
+void printHeat(FILE* f, const tally_t* t) {
+        const int shades = sizeof(heatRamp) - 2;
+        uint64_t most;
+        int p,x,y;
+
+        fprintf(f, "\nwhere pieces land (%lu locks hidden by clears)\n",
+                (unsigned long)t->hidden);
+
+        for(p = 0; p < PIECES; p++) {
+                for(x = 0, most = 0; x < BOARD_CELLS; x++) {
+                        most = t->heat[p][x] > most ? t->heat[p][x] : most;
+                }
+
+                fprintf(f, "%c\n", pieceNames[p]);
+
+                for(y = BOARD_HEIGHT - 1; y >= 0; y--) {
+                        fprintf(f, "  |");
+
+                        for(x = 0; x < BOARD_WIDTH; x++) {
+                                fputc(!most ? ' ' : heatRamp[
+                                        (shades * t->heat[p][x + y *
+                                                  BOARD_WIDTH] + most - 1) /
+                                        most], f);
+                        }
+
+                        fprintf(f, "|\n");
+                }
+        }
+}
+
+/* Print the aggregations that were asked for */
+void tallyPrint(FILE* f, const tally_t* t) {
+        fprintf(f, "%lu snapshots, %lu corrupt, %lu locks, %lu games "
+                "ended\n", (unsigned long)t->snapshots,
+                (unsigned long)t->corrupt, (unsigned long)t->locks,
+                (unsigned long)t->games);
+
+        if(t->wants & TALLY_HEIGHTS) {
+                printBins(f, "stack height after each lock", t->heights,
+                          HEIGHT_BINS, 1);
+        }
+
+        if(t->wants & TALLY_CLEARS) {
+                printBins(f, "rows cleared by each lock", t->clears,
+                          CLEAR_BINS, 1);
+        }
+
+        if(t->wants & TALLY_MATCHES) {
+                printBins(f, "fruit runs cleared by each lock", t->matches,
+                          MATCH_BINS, 1);
+        }
+
+        if(t->wants & TALLY_CHAINS) {
+                printChains(f, t);
+        }
+
+        if(t->wants & TALLY_LENGTHS) {
+                printBins(f, "pieces per game", t->lengths, LENGTH_BINS,
+                          LENGTH_WIDTH);
+        }
+
+        if(t->wants & TALLY_HEAT) {
+                printHeat(f, t);
+        }
+}
@@ -0,0 +1,66 @@
+#ifndef __tally_h__
+#define __tally_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "block.h"
+#include "snapshot.h"
+
+// --- //
+
+// Aggregations, to be picked by bit.
+#define TALLY_HEIGHTS 1   // Stack height after each lock
+#define TALLY_CLEARS  2   // Rows cleared by each lock
+#define TALLY_MATCHES 4   // Fruit runs cleared by each lock
+#define TALLY_CHAINS  8   // Chain length, by the piece that set it off
+#define TALLY_LENGTHS 16  // Pieces per game
+#define TALLY_HEAT    32  // Where each piece's cells come to rest
+#define TALLY_ALL     63
+
+#define HEIGHT_BINS   (BOARD_HEIGHT + 1)
+#define CLEAR_BINS    8   // The last bin holds everything past it
+#define MATCH_BINS    16
+#define CHAIN_BINS    16
+#define LENGTH_BINS   40
+#define LENGTH_WIDTH  25  // Pieces per game-length bin
+
+/* Counts gathered from a run of snapshots. Each thread fills its own,
+ * and they're summed once everyone's done, so nothing is ever shared
+ * while counting.
+ */
+typedef struct tally_t {
+        unsigned wants;         // TALLY_* bits
+        uint64_t snapshots;     // Looked at
+        uint64_t corrupt;       // ...that failed their checks
+        uint64_t locks;         // Pieces seen landing
+        uint64_t games;         // Seen ending, by a restart after them
+        uint64_t hidden;        // Locks whose cells a clear moved
+        uint64_t heights[HEIGHT_BINS];
+        uint64_t clears[CLEAR_BINS];
+        uint64_t matches[MATCH_BINS];
+        uint64_t chains[PIECES][CHAIN_BINS];
+        uint64_t lengths[LENGTH_BINS];
+        uint64_t heat[PIECES][BOARD_CELLS];
+} tally_t;
+
+// --- //
+
+/* Which aggregation bit a name like "heights" or "all" stands for. 0
+ * if none.
+ */
+unsigned tallyNamed(const char* name);
+
+/* Count what happened between two snapshots from the same archive, one
+ * straight after the other. `prev` is NULL for an archive's first.
+ */
+void tallyStep(tally_t* t, const snapshot_t* prev, const snapshot_t* s);
+
+/* Add `from`'s counts into `into` */
+void tallyMerge(tally_t* into, const tally_t* from);
+
+/* Print the aggregations that were asked for */
+void tallyPrint(FILE* f, const tally_t* t);
+
+#endif
@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "ansi.h"
+#include "logger.h"
+#include "sim.h"
+#include "stream.h"
+#include "util.h"
+
+// --- //
+
+/* Fetris in a terminal, for when there's no window: over SSH, or to
+ * look in on a headless run. Plays a game of its own, or with -w
+ * mirrors a spectator stream from `fetris -S` or `fetris-soak -S`.
+ *
+ * Only cells that changed are sent, and never more than DRAW_RATE
+ * times a second. A slow link just skips Frames; the game itself runs
+ * on the sim thread and never waits for the screen.
+ */
+
+#define DRAW_RATE 30
+
+int wakeFd = -1;  // Poked by the sim thread whenever it publishes
+
+/* A spectator stream being mirrored */
+typedef struct mirror_t {
+        int fd;
+        unsigned char buf[4096];
+        size_t len;
+        frame_t frame;
+        bool synced;  // Seen a FULL yet?
+} mirror_t;
+
+// --- //
+
+/* Let the main loop know there's a new Frame */
+void wake() {
+        uint64_t one = 1;
+        ssize_t n = write(wakeFd, &one, sizeof(one));
+
+        (void)n;
+}
+
+/* Take in whatever arrived. Yields 0 once the server hangs up */
+int mirrorRead(mirror_t* m) {
+        stream_header_t h;
+        ssize_t n;
+        int len;
+
+        while((n = read(m->fd, m->buf + m->len, sizeof(m->buf) - m->len)) > 0) {
+                m->len += n;
+
+                while((len = streamLength(m->buf, m->len)) > 0) {
+                        memcpy(&h, m->buf, sizeof(h));
+                        m->synced = m->synced || h.type == STREAM_FULL;
+
+                        if(m->synced) {
+                                check(streamApply(&m->frame, m->buf),
+                                      "Bad message from the server.");
+                        }
+
+                        memmove(m->buf, m->buf + len, m->len - len);
+                        m->len -= len;
+                }
+
+                check(len == 0, "Garbage from the server.");
+        }
+
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+ error:
+        return 0;
+}
+
+int main(int argc, char** argv) {
+        struct pollfd fds[2];
+        screen_t* screen = NULL;
+        game_t* game = NULL;
+        sim_t* sim = NULL;
+        mirror_t mirror = { .fd = -1 };
+        frame_t* frame;
+        char* where = NULL;
+        double das = DEFAULT_DAS;
+        double arr = DEFAULT_ARR;
+        double drawn = 0;
+        bool dirty = true;
+        bool quit = false;
+        bool fresh;
+        uint64_t pokes;
+        int keys[MAX_KEYS];
+        int i,n,opt,wait;
+
+        while((opt = getopt(argc, argv, "w:d:a:")) != -1) {
+                switch(opt) {
+                case 'w':
+                        where = optarg;
+                        break;
+                case 'd':
+                        das = atof(optarg) / 1000;
+                        break;
+                case 'a':
+                        arr = atof(optarg) / 1000;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-d das_ms] [-a arr_ms] "
+                                "[-w socket|port]\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        // Lines on stderr would land in the middle of the Board.
+        logSetLevel(LOG_WARN);
+        check(logStart(), "Couldn't start logging.");
+
+        if(where) {
+                mirror.fd = connectTo(where);
+                check(mirror.fd >= 0, "Couldn't watch %s.", where);
+                fds[1].fd = mirror.fd;
+        } else {
+                wakeFd = eventfd(0, EFD_NONBLOCK);
+                check(wakeFd >= 0, "Couldn't create eventfd.");
+                game = gameCreate((uint64_t)(1e9 * now()));
+                check(game, "Couldn't create a game.");
+                sim = simCreate(game, das, arr);
+                check(sim, "Couldn't create the simulation.");
+                sim->notify = wake;
+                check(simStart(sim), "Couldn't start the simulation.");
+                fds[1].fd = wakeFd;
+        }
+
+        screen = screenCreate(STDIN_FILENO, STDOUT_FILENO);
+        check(screen, "Couldn't take over the terminal.");
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = fds[1].events = POLLIN;
+
+        while(!quit) {
+                // Hold back a redraw that would come too soon.
+                wait = !dirty ? -1 :
+                        (int)(1000 * (drawn + 1.0 / DRAW_RATE - now()));
+                fds[0].revents = fds[1].revents = 0;
+                n = poll(fds, 2, wait < 0 && dirty ? 0 : wait);
+                check(n >= 0 || errno == EINTR, "Couldn't poll.");
+
+                if(n > 0 && fds[0].revents) {
+                        n = screenKeys(screen, keys);
+                        quit = n < 0;
+
+                        for(i = 0; i < n; i++) {
+                                if(keys[i] == KEY_QUIT) {
+                                        quit = true;
+                                } else if(keys[i] == KEY_REDRAW) {
+                                        screenClear(screen);
+                                        dirty = true;
+                                } else if(sim) {
+                                        // Terminals only say when a key
+                                        // is pressed. Their own repeat
+                                        // stands in for DAS.
+                                        simKey(sim, keys[i], true);
+                                        simKey(sim, keys[i], false);
+                                }
+                        }
+                }
+
+                if(fds[1].revents) {
+                        if(sim) {
+                                n = read(wakeFd, &pokes, sizeof(pokes));
+                                (void)n;
+                        } else if(!mirrorRead(&mirror)) {
+                                log_warn("The game went away.");
+                                quit = true;
+                        }
+
+                        dirty = true;
+                }
+
+                if(dirty && now() - drawn >= 1.0 / DRAW_RATE) {
+                        frame = sim ? simFrame(sim, &fresh) : &mirror.frame;
+
+                        if(sim || mirror.synced) {
+                                check(screenDraw(screen, frame),
+                                      "Lost the terminal.");
+                        }
+
+                        drawn = now();
+                        dirty = false;
+                }
+        }
+
+        screenDestroy(screen);
+        simStop(sim);
+        gameDestroy(game);
+        if(mirror.fd >= 0) { close(mirror.fd); }
+        if(wakeFd >= 0) { close(wakeFd); }
+        logStop();
+
+        return EXIT_SUCCESS;
+ error:
+        screenDestroy(screen);
+        simStop(sim);
+        gameDestroy(game);
+        if(mirror.fd >= 0) { close(mirror.fd); }
+        if(wakeFd >= 0) { close(wakeFd); }
+        logStop();
+        return EXIT_FAILURE;
+}
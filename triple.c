@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "triple.h"
+
+// --- //
+
+#define FRESH 4
+#define SLOT_ALIGN 64  // Keep slots off each other's cache lines.
+
+/* Create a triple buffer of three `size`-byte slots */
+triple_t* tripleCreate(size_t size) {
+        triple_t* t = calloc(1, sizeof(triple_t));
+        size_t padded = (size + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+        int i;
+
+        check_mem(t);
+
+        for(i = 0; i < 3; i++) {
+                t->slots[i] = aligned_alloc(SLOT_ALIGN, padded);
+                check_mem(t->slots[i]);
+                memset(t->slots[i], 0, padded);
+        }
+
+        t->back  = 0;
+        t->front = 1;
+        atomic_init(&t->middle, 2);
+
+        return t;
+ error:
+        tripleDestroy(t);
+        return NULL;
+}
+
+/* The slot the producer should fill next. Its contents are stale */
+void* tripleBack(triple_t* t) {
+        return t->slots[t->back];
+}
+
+/* Hand the back slot over to the consumer */
+void triplePublish(triple_t* t) {
+        int old = atomic_exchange_explicit(&t->middle, t->back | FRESH,
+                                           memory_order_acq_rel);
+
+        t->back = old & ~FRESH;
+}
+
+/* The latest published slot. `fresh` says whether it's new to us */
+void* tripleFront(triple_t* t, bool* fresh) {
+        int old;
+
+        *fresh = atomic_load_explicit(&t->middle, memory_order_relaxed) & FRESH;
+
+        if(*fresh) {
+                old = atomic_exchange_explicit(&t->middle, t->front,
+                                               memory_order_acq_rel);
+                t->front = old & ~FRESH;
+        }
+
+        return t->slots[t->front];
+}
+
+/* Deallocate a triple buffer */
+void tripleDestroy(triple_t* t) {
+        int i;
+
+        if(t) {
+                for(i = 0; i < 3; i++) {
+                        free(t->slots[i]);
+                }
+                free(t);
+        }
+}
@@ -0,0 +1,37 @@
+#ifndef __triple_h__
+#define __triple_h__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// --- //
+
+/* A lock-free triple buffer between exactly one producer and one
+ * consumer. The producer fills the back slot and publishes it. The
+ * consumer only ever sees the latest complete slot, and neither side
+ * waits on the other.
+ */
+typedef struct triple_t {
+        void* slots[3];
+        int back;            // Producer-owned
+        int front;           // Consumer-owned
+        _Atomic int middle;  // Slot index, plus FRESH if unseen
+} triple_t;
+
+/* Create a triple buffer of three `size`-byte slots */
+triple_t* tripleCreate(size_t size);
+
+/* The slot the producer should fill next. Its contents are stale */
+void* tripleBack(triple_t* t);
+
+/* Hand the back slot over to the consumer */
+void triplePublish(triple_t* t);
+
+/* The latest published slot. `fresh` says whether it's new to us */
+void* tripleFront(triple_t* t, bool* fresh);
+
+/* Deallocate a triple buffer */
+void tripleDestroy(triple_t* t);
+
+#endif
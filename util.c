@@ -1,7 +1,16 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "logger.h"
 #include "util.h"
-#include "cog/dbg.h"
 
 // --- //
 
@@ -28,3 +37,125 @@ GLfloat* append(GLfloat* l1, int l1s, GLfloat* l2, int l2s) {
  error:
         return NULL;
 }
+
+/* Is this all digits, i.e. a port number rather than a path? */
+bool isPort(const char* where) {
+        for(; *where; where++) {
+                if(*where < '0' || *where > '9') {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/* Connect to a spectator server at `where`, as isPort() reads it.
+ * The socket is non-blocking.
+ */
+int connectTo(const char* where) {
+        struct sockaddr_un un = { .sun_family = AF_UNIX };
+        struct sockaddr_in in = { .sin_family = AF_INET };
+        int fd = -1;
+
+        if(isPort(where)) {
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                check(fd >= 0, "Couldn't create socket.");
+                in.sin_port = htons(atoi(where));
+                in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                check(connect(fd, (struct sockaddr*)&in, sizeof(in)) == 0,
+                      "Couldn't connect to port %s.", where);
+        } else {
+                check(strlen(where) < sizeof(un.sun_path), "Path too long.");
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                check(fd >= 0, "Couldn't create socket.");
+                strcpy(un.sun_path, where);
+                check(connect(fd, (struct sockaddr*)&un, sizeof(un)) == 0,
+                      "Couldn't connect to %s.", where);
+        }
+
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        return fd;
+ error:
+        if(fd >= 0) { close(fd); }
+        return -1;
+}
+
+/* Seconds on a monotonic clock. Only differences are meaningful */
+double now() {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Slicing-by-8: table k is table 0 advanced k more zero bytes.
+uint32_t crcTable[8][256];
+pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+/* Fill in crcTable. Runs once */
+void crcInit() {
+        uint32_t c;
+        int i,j,k;
+
+        for(i = 0; i < 256; i++) {
+                for(c = i, j = 0; j < 8; j++) {
+                        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                }
+                crcTable[0][i] = c;
+        }
+
+        for(k = 1; k < 8; k++) {
+                for(i = 0; i < 256; i++) {
+                        c = crcTable[k-1][i];
+                        crcTable[k][i] = crcTable[0][c & 0xff] ^ (c >> 8);
+                }
+        }
+}
+
+/* The CRC-32 (IEEE) of `len` bytes. Eight at a time, so checking a
+ * mapped archive keeps up with the disk.
+ */
+uint32_t crc32(const void* data, size_t len) {
+        const unsigned char* bytes = data;
+        uint32_t crc = 0xffffffff;
+        uint32_t lo, hi;
+        size_t i = 0;
+
+        pthread_once(&crcOnce, crcInit);
+
+        // Little-endian words, as everything here is.
+        for(; i + 8 <= len; i += 8) {
+                memcpy(&lo, bytes + i, 4);
+                memcpy(&hi, bytes + i + 4, 4);
+                lo ^= crc;
+                crc = crcTable[7][lo & 0xff] ^
+                        crcTable[6][(lo >> 8) & 0xff] ^
+                        crcTable[5][(lo >> 16) & 0xff] ^
+                        crcTable[4][lo >> 24] ^
+                        crcTable[3][hi & 0xff] ^
+                        crcTable[2][(hi >> 8) & 0xff] ^
+                        crcTable[1][(hi >> 16) & 0xff] ^
+                        crcTable[0][hi >> 24];
+        }
+
+        for(; i < len; i++) {
+                crc = crcTable[0][(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        }
+
+        return ~crc;
+}
+
+/* Fold `len` bytes into a running FNV-1a hash. Start from FNV_OFFSET */
+uint64_t fnv1a(uint64_t h, const void* data, size_t len) {
+        const unsigned char* bytes = data;
+        size_t i;
+
+        for(i = 0; i < len; i++) {
+                h ^= bytes[i];
+                h *= 0x100000001b3ULL;
+        }
+
+        return h;
+}
@@ -2,8 +2,30 @@
 #define __util_h__
 
 #include <GL/glew.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
 
 /* Append one GLfloat Array to another */
 GLfloat* append(GLfloat* l1, int l1s, GLfloat* l2, int l2s);
 
+/* Is this all digits, i.e. a port number rather than a path? */
+bool isPort(const char* where);
+
+/* Connect to a spectator server at `where`, as isPort() reads it.
+ * The socket is non-blocking.
+ */
+int connectTo(const char* where);
+
+/* Seconds on a monotonic clock. Only differences are meaningful */
+double now();
+
+/* The CRC-32 (IEEE) of `len` bytes */
+uint32_t crc32(const void* data, size_t len);
+
+/* Fold `len` bytes into a running FNV-1a hash. Start from FNV_OFFSET */
+uint64_t fnv1a(uint64_t h, const void* data, size_t len);
+
 #endif
@@ -0,0 +1,298 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ansi.h"
+#include "link.h"
+#include "logger.h"
+#include "rollback.h"
+#include "util.h"
+
+// --- //
+
+/* Two-player Fetris in a terminal, against someone on another port of
+ * the same machine. Both sides play the whole match in lockstep from
+ * the same seed and only ever send their inputs. The other side's are
+ * guessed until they arrive, and a wrong guess is put right by playing
+ * the last few ticks again, so neither player waits on the network.
+ *
+ * The lower port is player one and picks the seed. -l, -j and -x make
+ * the loopback behave like a worse network, to see rollback at work.
+ */
+
+#define DRAW_RATE     30
+#define DEFAULT_DELAY 2     // Ticks our own input is held back
+#define MAX_CATCHUP   8     // Most ticks played at once after a hitch
+#define YIELD_EVERY   10    // Ticks between those given up to the peer
+#define BOT_PERIOD    0.15  // Seconds between the bot's moves
+#define LINGER        2.0   // Seconds to show the result, and let the
+                            // peer hear the last of our inputs
+
+// --- //
+
+/* Wait for the peer's first packet, for the seed it picked. Yields 0
+ * if we're told to quit first.
+ */
+int awaitSeed(link_t* l, screen_t* s, uint64_t* seed) {
+        struct pollfd fds[2] = { { .fd = l->fd, .events = POLLIN },
+                                 { .fd = s->in, .events = POLLIN } };
+        unsigned char buf[MAX_DATAGRAM];
+        int keys[MAX_KEYS];
+        packet_t p;
+        ssize_t len;
+        int i,n;
+
+        while(true) {
+                n = poll(fds, s->in >= 0 ? 2 : 1, -1);
+                check(n >= 0 || errno == EINTR, "Couldn't poll.");
+
+                while((len = linkRecv(l, buf, sizeof(buf))) > 0) {
+                        if(packetRead(buf, len, &p)) {
+                                *seed = p.seed;
+                                return 1;
+                        }
+                }
+
+                if(n > 0 && fds[1].revents) {
+                        n = screenKeys(s, keys);
+
+                        for(i = 0; i < n; i++) {
+                                check(keys[i] != KEY_QUIT, "Gave up waiting.");
+                        }
+
+                        check(n >= 0, "Gave up waiting.");
+                }
+        }
+ error:
+        return 0;
+}
+
+/* Draw both Boards, ours on the left */
+int drawBoth(rollback_t* r, screen_t* ours, screen_t* theirs) {
+        frame_t f;
+
+        gameFrame(&r->match.games[r->local], &f);
+        check(screenDraw(ours, &f), "Lost the terminal.");
+        gameFrame(&r->match.games[!r->local], &f);
+        check(screenDraw(theirs, &f), "Lost the terminal.");
+
+        return 1;
+ error:
+        return 0;
+}
+
+/* How to run it */
+void usage(char* name) {
+        fprintf(stderr, "Usage: %s -p port -c peer_port [-b] "
+                "[-i delay_ticks] [-l latency_ms] [-j jitter_ms] "
+                "[-x loss_percent]\n", name);
+}
+
+int main(int argc, char** argv) {
+        struct pollfd fds[2];
+        screen_t* ours = NULL;
+        screen_t* theirs = NULL;
+        link_t* link = NULL;
+        rollback_t* r = NULL;
+        unsigned char buf[MAX_DATAGRAM];
+        packet_t packet;
+        uint64_t seed;
+        double next, drawn = 0, botDue = 0, ended = 0;
+        double latency = 0, jitter = 0, loss = 0;
+        double began, slowest = 0;
+        bool bot = false;
+        bool dirty = true;
+        bool quit = false;
+        ssize_t len;
+        rng_t moves;
+        int keys[MAX_KEYS];
+        unsigned long yieldAt = 0;
+        int port = 0, peer = 0, delay = DEFAULT_DELAY;
+        int i,n,opt,wait,ticks;
+
+        while((opt = getopt(argc, argv, "p:c:bi:l:j:x:")) != -1) {
+                switch(opt) {
+                case 'p':
+                        port = atoi(optarg);
+                        break;
+                case 'c':
+                        peer = atoi(optarg);
+                        break;
+                case 'b':
+                        bot = true;
+                        break;
+                case 'i':
+                        delay = atoi(optarg);
+                        break;
+                case 'l':
+                        latency = atof(optarg) / 1000;
+                        break;
+                case 'j':
+                        jitter = atof(optarg) / 1000;
+                        break;
+                case 'x':
+                        loss = atof(optarg) / 100;
+                        break;
+                default:
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if(port <= 0 || peer <= 0 || port == peer) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        // Lines on stderr would land in the middle of the Boards.
+        logSetLevel(LOG_WARN);
+        check(logStart(), "Couldn't start logging.");
+
+        link = linkOpen(port, peer);
+        check(link, "Couldn't open the link.");
+        link->latency = latency;
+        link->jitter = jitter;
+        link->loss = loss;
+
+        // A bot with nobody at the keys needn't read any.
+        ours = screenCreate(bot && !isatty(STDIN_FILENO) ? -1 : STDIN_FILENO,
+                            STDOUT_FILENO);
+        check(ours, "Couldn't take over the terminal.");
+        theirs = screenBeside(ours);
+        check(theirs, "Couldn't draw the other Board.");
+
+        // Player one picks the seed, and player two hears it.
+        if(port < peer) {
+                seed = (uint64_t)(1e9 * now());
+        } else {
+                check(awaitSeed(link, ours, &seed), "No match.");
+        }
+
+        r = rollbackCreate(seed, port < peer ? 0 : 1, delay);
+        check(r, "Couldn't start the match.");
+        rngSeed(&moves, seed + port);
+
+        fds[0].fd = ours->in;
+        fds[1].fd = link->fd;
+        fds[0].events = fds[1].events = POLLIN;
+        next = now();
+
+        while(!quit) {
+                // Sleep until a tick, a redraw or a held datagram is due.
+                wait = (int)(1000 * (next - now()));
+                n = linkPump(link) * 1000;
+                wait = n >= 0 && n < wait ? n : wait;
+                n = (int)(1000 * (drawn + 1.0 / DRAW_RATE - now()));
+                wait = dirty && n < wait ? n : wait;
+                fds[0].revents = fds[1].revents = 0;
+                n = poll(fds, 2, wait > 0 ? wait : 0);
+                check(n >= 0 || errno == EINTR, "Couldn't poll.");
+
+                if(n > 0 && fds[0].revents) {
+                        n = screenKeys(ours, keys);
+                        quit = n < 0;
+
+                        for(i = 0; i < n; i++) {
+                                if(keys[i] == KEY_QUIT) {
+                                        quit = true;
+                                } else if(keys[i] == KEY_REDRAW) {
+                                        screenClear(ours);
+                                        screenClear(theirs);
+                                        dirty = true;
+                                } else {
+                                        rollbackPress(r, keys[i]);
+                                }
+                        }
+                }
+
+                while((len = linkRecv(link, buf, sizeof(buf))) > 0) {
+                        rollbackReceive(r, buf, len);
+                }
+
+                if(bot && now() >= botDue) {
+                        rollbackPress(r, rngBelow(&moves, Shuffle + 1));
+                        botDue = now() + BOT_PERIOD;
+                }
+
+                // Catch up on the ticks that are due, but only so far.
+                for(ticks = 0; now() >= next && ticks < MAX_CATCHUP; ticks++) {
+                        began = now();
+
+                        dirty = true;
+
+                        // Give the peer a tick to catch up, now and then.
+                        if(rollbackAhead(r) > 1 && r->tick >= yieldAt &&
+                           !r->match.over) {
+                                yieldAt = r->tick + YIELD_EVERY;
+                                r->yields++;
+                                next += 1.0 / TICK_RATE;
+                                ticks++;
+                                break;
+                        }
+
+                        // Held up, or over. Try again next tick.
+                        if(!rollbackAdvance(r)) {
+                                next = now() + 1.0 / TICK_RATE;
+                                ticks++;
+                                break;
+                        }
+
+                        slowest = now() - began > slowest ?
+                                now() - began : slowest;
+                        next += 1.0 / TICK_RATE;
+                }
+
+                if(ticks == MAX_CATCHUP) {
+                        next = now();
+                }
+
+                // Once a tick, even when held up, or neither side would
+                // ever hear from the other again.
+                if(ticks) {
+                        linkSend(link, &packet, rollbackPacket(r, &packet));
+                }
+
+                // Over once nothing the peer sends can change it.
+                if(rollbackOver(r) && !ended) {
+                        ended = now();
+                        dirty = true;
+                }
+
+                quit |= ended && now() - ended > LINGER;
+
+                if(dirty && now() - drawn >= 1.0 / DRAW_RATE) {
+                        check(drawBoth(r, ours, theirs), "Lost the terminal.");
+                        drawn = now();
+                        dirty = false;
+                }
+        }
+
+        screenDestroy(theirs);
+        screenDestroy(ours);
+
+        printf("Player %d %s at tick %lu.\n"
+               "%lu rollbacks replayed %lu ticks, at most %lu at once. "
+               "Slowest tick %.2fms.\n"
+               "%lu ticks stalled, %lu yielded, %lu desyncs, %lu of %lu "
+               "datagrams dropped.\n", r->local + 1,
+               !r->match.over ? "quit" : r->match.winner < 0 ? "drew" :
+               r->match.winner == r->local ? "won" : "lost", r->tick,
+               r->rollbacks, r->resimulated, r->deepest, 1000 * slowest,
+               r->stalls, r->yields, r->desyncs, link->dropped,
+               link->sent + link->dropped);
+
+        rollbackDestroy(r);
+        linkClose(link);
+        logStop();
+
+        return EXIT_SUCCESS;
+ error:
+        screenDestroy(theirs);
+        screenDestroy(ours);
+        rollbackDestroy(r);
+        linkClose(link);
+        logStop();
+        return EXIT_FAILURE;
+}
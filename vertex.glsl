@@ -1,21 +1,37 @@
 #version 330 core
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 colour;
+// Corner of the Cell mesh (or a Grid line) in Grid Space, plus a Palette
+// index.
+layout (location = 0) in uvec4 vertex;
 
-uniform mat4 view;
-uniform mat4 proj;
+// Per instance: where the Cell sits in Grid Space, which Board it's on,
+// and a Palette index added to the vertex's.
+layout (location = 1) in uvec4 cell;
+
+layout (std140) uniform Palette {
+        vec4 colours[8];
+};
+
+// Projection * view, rebuilt only when the camera moves.
+uniform mat4 camera;
+
+// Grid Space -> World Space.
+uniform float cellSize;
+uniform vec3  origin;
+
+// Where each Board sits in World Space. MAX_BOARDS in fetris.c.
+uniform vec3 boards[16];
+
+// Used to scale and centre the entire game.
+uniform float scale;
+uniform vec3  offset;
 
 out vec4 vColour;
 
 void main() {
-        // Used to scale the entire game.
-        mat4 scale = mat4(2.0/450, 	0.0, 		0.0,     0.0,
-			  0.0,  	2.0/450, 	0.0,     0.0,
-			  0.0, 		0.0, 		2.0/450, 0.0,
-			  0.0, 		0.0, 		0.0,     1.0 );
-
-        gl_Position = proj * view * scale * (vec4(position, 1.0) +
-                                             vec4(-200, -360, 0, 0));
-        vColour = vec4(colour,1.0);
+        vec3 position = origin + boards[cell.z] +
+                cellSize * vec3(vertex.xyz + uvec3(cell.xy, 0u));
+
+        gl_Position = camera * vec4(scale * (position + offset), 1.0);
+        vColour = colours[vertex.w + cell.w];
 }
@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "stream.h"
+#include "util.h"
+
+// --- //
+
+/* A test spectator. Mirrors the game from the stream, checks every
+ * message, and reports throughput. With -n it opens many connections
+ * at once to load the server.
+ */
+
+/* One connection and its copy of the game */
+typedef struct watcher_t {
+        int fd;
+        unsigned char buf[4096];
+        size_t len;
+        frame_t mirror;
+        bool synced;  // Seen a FULL yet?
+} watcher_t;
+
+unsigned long messages = 0;
+unsigned long fulls = 0;
+unsigned long bytes = 0;
+unsigned long errors = 0;
+
+// --- //
+
+/* Draw the mirrored game */
+void drawBoard(frame_t* f) {
+        printf("\033[H\033[2J");
+        frameDump(stdout, f);
+}
+
+/* Take in whatever arrived. Yields 0 once the server hangs up */
+int watcherRead(watcher_t* w, bool draw) {
+        stream_header_t h;
+        ssize_t n;
+        int len;
+
+        while((n = read(w->fd, w->buf + w->len, sizeof(w->buf) - w->len)) > 0) {
+                w->len += n;
+                bytes += n;
+
+                while((len = streamLength(w->buf, w->len)) > 0) {
+                        memcpy(&h, w->buf, sizeof(h));
+
+                        if(h.type == STREAM_FULL) {
+                                w->synced = true;
+                                fulls++;
+                        }
+
+                        if(!w->synced || !streamApply(&w->mirror, w->buf)) {
+                                errors++;
+                        }
+
+                        messages++;
+                        memmove(w->buf, w->buf + len, w->len - len);
+                        w->len -= len;
+
+                        if(draw) {
+                                drawBoard(&w->mirror);
+                        }
+                }
+
+                check(len == 0, "Garbage from the server.");
+        }
+
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+ error:
+        errors++;
+        return 0;
+}
+
+int main(int argc, char** argv) {
+        struct epoll_event ev = { .events = EPOLLIN };
+        struct epoll_event events[256];
+        watcher_t* ws = NULL;
+        double start, last, t;
+        double seconds = 0;
+        bool quiet = false;
+        int count = 1;
+        int live = 0;
+        int epollFd;
+        int i,n,opt;
+
+        while((opt = getopt(argc, argv, "n:qt:")) != -1) {
+                switch(opt) {
+                case 'n':
+                        count = atoi(optarg);
+                        break;
+                case 'q':
+                        quiet = true;
+                        break;
+                case 't':
+                        seconds = atof(optarg);
+                        break;
+                default:
+                        goto usage;
+                }
+        }
+
+        if(optind != argc - 1 || count < 1) {
+                goto usage;
+        }
+
+        epollFd = epoll_create1(0);
+        check(epollFd >= 0, "Couldn't create epoll instance.");
+        ws = calloc(count, sizeof(watcher_t));
+        check_mem(ws);
+
+        for(i = 0; i < count; i++, live++) {
+                ws[i].fd = connectTo(argv[optind]);
+                check(ws[i].fd >= 0, "Only got %d connections.", i);
+                ev.data.ptr = &ws[i];
+                check(epoll_ctl(epollFd, EPOLL_CTL_ADD, ws[i].fd, &ev) == 0,
+                      "Couldn't watch connection.");
+        }
+
+        // Only one board fits on screen.
+        quiet = quiet || count > 1;
+        start = last = now();
+
+        while(live > 0 && (seconds == 0 || now() - start < seconds)) {
+                n = epoll_wait(epollFd, events, 256, 1000);
+
+                for(i = 0; i < n; i++) {
+                        watcher_t* w = events[i].data.ptr;
+
+                        if(!watcherRead(w, !quiet)) {
+                                epoll_ctl(epollFd, EPOLL_CTL_DEL, w->fd, NULL);
+                                close(w->fd);
+                                live--;
+                        }
+                }
+
+                t = now();
+
+                if(quiet && t - last >= 1) {
+                        printf("%d watching, %.0f msgs/s, %.0f KB/s, "
+                               "%lu FULLs, %lu errors\n",
+                               live, messages / (t - start),
+                               bytes / (t - start) / 1024, fulls, errors);
+                        last = t;
+                }
+        }
+
+        for(i = 0; i < count; i++) {
+                close(ws[i].fd);
+        }
+        free(ws);
+
+        return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+ usage:
+        fprintf(stderr, "Usage: %s [-n connections] [-q] [-t seconds] "
+                "socket|port\n", argv[0]);
+ error:
+        free(ws);
+        return EXIT_FAILURE;
+}